@@ -25,8 +25,14 @@
 #include "3dsystem/3dinsert.h"
 #include "3dsystem/phd_math.h"
 #include "3dsystem/scalespr.h"
+#include "modding/cpu_utils.h"
 #include "specific/hwr.h"
 #include "global/vars.h"
+#include <limits.h>
+
+#ifdef FEATURE_RENDER_IMPROVED
+#include "modding/frame_interp.h"
+#endif // FEATURE_RENDER_IMPROVED
 
 // related to POLYTYPE enum
 static void (__cdecl *PolyDrawRoutines[])(__int16 *) = {
@@ -270,6 +276,9 @@ void __cdecl phd_LookAt(int xsrc, int ysrc, int zsrc, int xtar, int ytar, int zt
 	PHD_3DPOS viewPos;
 	VECTOR_ANGLES angles;
 
+#ifdef FEATURE_RENDER_IMPROVED
+	FrameInterpSetLookAt(xsrc, ysrc, zsrc, xtar, ytar, ztar, roll);
+#endif // FEATURE_RENDER_IMPROVED
 	phd_GetVectorAngles(xtar - xsrc, ytar - ysrc, ztar - zsrc, &angles);
 	viewPos.x = xsrc;
 	viewPos.y = ysrc;
@@ -588,6 +597,200 @@ void __cdecl S_InsertInvBgnd(__int16 *ptrObj) {
 	// Main S_InsertInvBgnd() logic is similar to S_InsertBackground();
 }
 
+#ifdef FEATURE_RENDER_IMPROVED
+bool SimdVertexEnabled = true;
+
+typedef struct VertexBatch_t {
+	int zv[4];
+	float xv[4];
+	float yv[4];
+	float xs[4];
+	float ys[4];
+	float rhw[4];
+	BYTE clip[4];
+} VERTEX_BATCH;
+
+static bool IsSimdVertexAvailable() {
+	return ( SimdVertexEnabled && IsSse2Available() );
+}
+
+// The batch multiply uses 16 bit coefficients. Rotation matrices always fit,
+// but a scaled matrix may not, so it must be transformed in the scalar way.
+static bool IsSimdMatrix(const PHD_MATRIX *m) {
+	return ( m->_00 == (__int16)m->_00 && m->_01 == (__int16)m->_01 && m->_02 == (__int16)m->_02 &&
+			 m->_10 == (__int16)m->_10 && m->_11 == (__int16)m->_11 && m->_12 == (__int16)m->_12 &&
+			 m->_20 == (__int16)m->_20 && m->_21 == (__int16)m->_21 && m->_22 == (__int16)m->_22 );
+}
+
+// Matrix row multiply for 4 vertices. The math is done in 32 bit integers
+// exactly like in the scalar code, so the view coordinates are bit exact.
+SIMD_SSE2 static inline __m128i TransformRow4(__m128i xy, __m128i z, int m0, int m1, int m2, int m3) {
+	__m128i mxy = _mm_set1_epi32((UINT16)m0 | ((DWORD)(UINT16)m1 << 16));
+	__m128i mz = _mm_set1_epi32((UINT16)m2);
+	return _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(xy, mxy), _mm_madd_epi16(z, mz)), _mm_set1_epi32(m3));
+}
+
+// Transforms and projects up to 4 vertices. Missing lanes repeat the first vertex.
+// Near/far Z decisions are left to the caller, so it stays the same as the scalar code.
+SIMD_SSE2 static void ProjectVertexBatch(const __int16 *ptrObj, int stride, int count, bool clampFar, VERTEX_BATCH *batch) {
+	const __int16 *p0 = ptrObj;
+	const __int16 *p1 = ( count > 1 ) ? ptrObj + stride*1 : p0;
+	const __int16 *p2 = ( count > 2 ) ? ptrObj + stride*2 : p0;
+	const __int16 *p3 = ( count > 3 ) ? ptrObj + stride*3 : p0;
+	const PHD_MATRIX *m = PhdMatrixPtr;
+
+	__m128i xy = _mm_setr_epi16(p0[0], p0[1], p1[0], p1[1], p2[0], p2[1], p3[0], p3[1]);
+	__m128i z  = _mm_setr_epi16(p0[2], 0, p1[2], 0, p2[2], 0, p3[2], 0);
+	__m128i xi = TransformRow4(xy, z, m->_00, m->_01, m->_02, m->_03);
+	__m128i yi = TransformRow4(xy, z, m->_10, m->_11, m->_12, m->_13);
+	__m128i zi = TransformRow4(xy, z, m->_20, m->_21, m->_22, m->_23);
+
+	_mm_storeu_si128((__m128i *)batch->zv, zi);
+	__m128 xv = _mm_cvtepi32_ps(xi);
+	__m128 yv = _mm_cvtepi32_ps(yi);
+	_mm_storeu_ps(batch->xv, xv);
+	_mm_storeu_ps(batch->yv, yv);
+
+	// the perspective divide is done in double precision as in the scalar code
+	__m128d persp[2], xs[2], ys[2], rhw[2];
+	__m128i hi = _mm_shuffle_epi32(xi, _MM_SHUFFLE(1,0,3,2));
+	__m128d xd[2] = {_mm_cvtepi32_pd(xi), _mm_cvtepi32_pd(hi)};
+	hi = _mm_shuffle_epi32(yi, _MM_SHUFFLE(1,0,3,2));
+	__m128d yd[2] = {_mm_cvtepi32_pd(yi), _mm_cvtepi32_pd(hi)};
+	hi = _mm_shuffle_epi32(zi, _MM_SHUFFLE(1,0,3,2));
+	__m128d zd[2] = {_mm_cvtepi32_pd(zi), _mm_cvtepi32_pd(hi)};
+
+	for( int i=0; i<2; ++i ) {
+		if( clampFar ) {
+			zd[i] = _mm_min_pd(zd[i], _mm_set1_pd(FltFarZ));
+		}
+		persp[i] = _mm_div_pd(_mm_set1_pd(FltPersp), zd[i]);
+		xs[i] = _mm_add_pd(_mm_mul_pd(persp[i], xd[i]), _mm_set1_pd(FltWinCenterX));
+		ys[i] = _mm_add_pd(_mm_mul_pd(persp[i], yd[i]), _mm_set1_pd(FltWinCenterY));
+		rhw[i] = _mm_mul_pd(persp[i], _mm_set1_pd(FltRhwOPersp));
+	}
+	__m128 xsf = _mm_movelh_ps(_mm_cvtpd_ps(xs[0]), _mm_cvtpd_ps(xs[1]));
+	__m128 ysf = _mm_movelh_ps(_mm_cvtpd_ps(ys[0]), _mm_cvtpd_ps(ys[1]));
+	_mm_storeu_ps(batch->xs, xsf);
+	_mm_storeu_ps(batch->ys, ysf);
+	_mm_storeu_ps(batch->rhw, _mm_movelh_ps(_mm_cvtpd_ps(rhw[0]), _mm_cvtpd_ps(rhw[1])));
+
+	// screen clip codes are taken from the stored float values, like in the scalar code
+	__m128 left = _mm_cmplt_ps(xsf, _mm_set1_ps(FltWinLeft));
+	__m128 right = _mm_andnot_ps(left, _mm_cmpgt_ps(xsf, _mm_set1_ps(FltWinRight)));
+	__m128 top = _mm_cmplt_ps(ysf, _mm_set1_ps(FltWinTop));
+	__m128 bottom = _mm_andnot_ps(top, _mm_cmpgt_ps(ysf, _mm_set1_ps(FltWinBottom)));
+	__m128i clip = _mm_and_si128(_mm_castps_si128(left), _mm_set1_epi32(0x01));
+	clip = _mm_or_si128(clip, _mm_and_si128(_mm_castps_si128(right), _mm_set1_epi32(0x02)));
+	clip = _mm_or_si128(clip, _mm_and_si128(_mm_castps_si128(top), _mm_set1_epi32(0x04)));
+	clip = _mm_or_si128(clip, _mm_and_si128(_mm_castps_si128(bottom), _mm_set1_epi32(0x08)));
+	clip = _mm_packs_epi32(clip, clip);
+	clip = _mm_packus_epi16(clip, clip);
+	*(DWORD *)batch->clip = _mm_cvtsi128_si32(clip);
+}
+
+static BYTE CalcObjectVerticesSimd(const __int16 *ptrObj, int vtxCount, double baseZ) {
+	VERTEX_BATCH batch;
+	BYTE totalClip = 0xFF;
+	double zv;
+
+	for( int i = 0; i < vtxCount; i += 4, ptrObj += 3*4 ) {
+		int count = MIN(vtxCount - i, 4);
+		ProjectVertexBatch(ptrObj, 3, count, true, &batch);
+		for( int j = 0; j < count; ++j ) {
+			PHD_VBUF *vbuf = &PhdVBuf[i+j];
+			vbuf->xv = batch.xv[j];
+			vbuf->yv = batch.yv[j];
+			zv = (double)batch.zv[j];
+			if( zv < FltNearZ ) {
+				vbuf->zv = zv;
+				vbuf->clip = 0x80;
+			} else {
+				vbuf->zv = ( zv >= FltFarZ ) ? FltFarZ : zv + baseZ;
+				vbuf->xs = batch.xs[j];
+				vbuf->ys = batch.ys[j];
+				vbuf->rhw = batch.rhw[j];
+				vbuf->clip = batch.clip[j];
+			}
+			totalClip &= (BYTE)vbuf->clip;
+		}
+	}
+	return totalClip;
+}
+
+static void CalcRoomVerticesSimd(const __int16 *ptrObj, int vtxCount, double baseZ, BYTE farClip) {
+	VERTEX_BATCH batch;
+	double zv;
+	int depth;
+
+	for( int i = 0; i < vtxCount; i += 4 ) {
+		int count = MIN(vtxCount - i, 4);
+		ProjectVertexBatch(ptrObj, 6, count, false, &batch);
+		for( int j = 0; j < count; ++j, ptrObj += 6 ) {
+			PHD_VBUF *vbuf = &PhdVBuf[i+j];
+			vbuf->xv = batch.xv[j];
+			vbuf->yv = batch.yv[j];
+			vbuf->g = ptrObj[5];
+			if( IsWaterEffect != 0 )
+				vbuf->g += ShadesTable[(WibbleOffset + (BYTE)RandomTable[(vtxCount - i - j) % WIBBLE_SIZE]) % WIBBLE_SIZE];
+
+			zv = (double)batch.zv[j];
+			if( zv < FltNearZ ) {
+				vbuf->clip = 0xFF80;
+				vbuf->zv = zv;
+			} else {
+				depth = batch.zv[j] >> W2V_SHIFT;
+#ifdef FEATURE_VIEW_IMPROVED
+				if( depth >= PhdViewDistance ) {
+					vbuf->rhw = batch.rhw[j];
+					vbuf->zv = zv + baseZ;
+#else // !FEATURE_VIEW_IMPROVED
+				if( depth >= DEPTHQ_END ) { // fog end
+					vbuf->rhw = 0.0; // NOTE: zero RHW is an invalid value, but the original game sets it.
+					vbuf->zv = FltFarZ;
+#endif // FEATURE_VIEW_IMPROVED
+					vbuf->g = 0x1FFF;
+					vbuf->clip = farClip;
+				} else {
+#ifdef FEATURE_VIEW_IMPROVED
+					vbuf->g += CalculateFogShade(depth);
+#else // !FEATURE_VIEW_IMPROVED
+					if( depth > DEPTHQ_START ) { // fog begin
+						vbuf->g += depth - DEPTHQ_START;
+					}
+#endif // FEATURE_VIEW_IMPROVED
+					vbuf->rhw = batch.rhw[j];
+					vbuf->clip = 0;
+					vbuf->zv = zv + baseZ;
+				}
+
+				vbuf->xs = batch.xs[j];
+				vbuf->ys = batch.ys[j];
+				if( IsWibbleEffect && ptrObj[4] >= 0 ) {
+					// wibble moves the vertex, so the batch clip codes can't be used here
+					vbuf->xs += WibbleTable[(WibbleOffset + (BYTE)vbuf->ys) % WIBBLE_SIZE];
+					vbuf->ys += WibbleTable[(WibbleOffset + (BYTE)vbuf->xs) % WIBBLE_SIZE];
+
+					if( vbuf->xs < FltWinLeft )
+						vbuf->clip |= 0x01;
+					else if( vbuf->xs > FltWinRight )
+						vbuf->clip |= 0x02;
+
+					if( vbuf->ys < FltWinTop )
+						vbuf->clip |= 0x04;
+					else if( vbuf->ys > FltWinBottom )
+						vbuf->clip |= 0x08;
+				} else {
+					vbuf->clip |= batch.clip[j];
+				}
+				vbuf->clip |= ~(BYTE)(vbuf->zv / 0x155555.p0) << 8;
+			}
+			CLAMP(vbuf->g, 0, 0x1FFF);
+		}
+	}
+}
+#endif // FEATURE_RENDER_IMPROVED
+
 __int16 *__cdecl calc_object_vertices(__int16 *ptrObj) {
 	double xv, yv, zv, persp, baseZ;
 	int vtxCount;
@@ -603,6 +806,14 @@ __int16 *__cdecl calc_object_vertices(__int16 *ptrObj) {
 		printf("vtxCount=%d", vtxCount);
 	}
 
+#ifdef FEATURE_RENDER_IMPROVED
+	if( vtxCount > 0 && IsSimdVertexAvailable() && IsSimdMatrix(PhdMatrixPtr) ) {
+		totalClip = CalcObjectVerticesSimd(ptrObj, vtxCount, baseZ);
+		ptrObj += 3 * vtxCount;
+		return ( totalClip == 0 ) ? ptrObj : NULL;
+	}
+#endif // FEATURE_RENDER_IMPROVED
+
 	for( int i = 0; i < vtxCount; ++i ) {
 		xv = (double)(PhdMatrixPtr->_00 * ptrObj[0] +
 					  PhdMatrixPtr->_01 * ptrObj[1] +
@@ -708,6 +919,13 @@ __int16 *__cdecl calc_roomvert(__int16 *ptrObj, BYTE farClip) {
 	baseZ = SavedAppSettings.ZBuffer ? 0.0 : (double)(MidSort << 22);
 	vtxCount = *(ptrObj++);
 
+#ifdef FEATURE_RENDER_IMPROVED
+	if( vtxCount > 0 && IsSimdVertexAvailable() && IsSimdMatrix(PhdMatrixPtr) ) {
+		CalcRoomVerticesSimd(ptrObj, vtxCount, baseZ, farClip);
+		return ptrObj + 6 * vtxCount;
+	}
+#endif // FEATURE_RENDER_IMPROVED
+
 	for( int i = 0; i < vtxCount; ++i ) {
 		xv = (double)(PhdMatrixPtr->_00 * ptrObj[0] +
 					  PhdMatrixPtr->_01 * ptrObj[1] +
@@ -819,11 +1037,66 @@ void __cdecl phd_InitPolyList() {
 		HWR_VertexPtr = HWR_VertexBuffer;
 }
 
+#ifdef FEATURE_RENDER_IMPROVED
+bool PolySortRadixEnabled = false;
+
+static SORT_ITEM PolySortScratch[ARRAY_SIZE(SortBuffer)];
+
+// Stable LSD radix sort by the depth key in descending order (the farthest first).
+// NOTE: the keys are not unique, since the index added to the depth may make two
+// keys equal. The quicksort is not stable, so such polys may go in other order.
+static void RadixSortPolyList(SORT_ITEM *buffer, DWORD count) {
+	DWORD histogram[4][256];
+	SORT_ITEM *src = buffer;
+	SORT_ITEM *dst = PolySortScratch;
+	SORT_ITEM *tmp;
+
+	memset(histogram, 0, sizeof(histogram));
+	for( DWORD i=0; i<count; ++i ) {
+		DWORD key = (DWORD)src[i]._1 ^ 0x80000000; // signed to unsigned order
+		++histogram[0][BYTE0(key)];
+		++histogram[1][BYTE1(key)];
+		++histogram[2][BYTE2(key)];
+		++histogram[3][BYTE3(key)];
+	}
+
+	for( int pass=0; pass<4; ++pass ) {
+		DWORD *offsets = histogram[pass];
+		int shift = pass * 8;
+		// all keys have the same byte here, so this pass changes nothing
+		if( offsets[(((DWORD)src[0]._1 ^ 0x80000000) >> shift) & 0xFF] == count ) {
+			continue;
+		}
+		DWORD offset = 0;
+		for( int j=255; j>=0; --j ) {
+			DWORD n = offsets[j];
+			offsets[j] = offset;
+			offset += n;
+		}
+		for( DWORD i=0; i<count; ++i ) {
+			DWORD key = (DWORD)src[i]._1 ^ 0x80000000;
+			dst[offsets[(key >> shift) & 0xFF]++] = src[i];
+		}
+		SWAP(src, dst, tmp);
+	}
+
+	if( src != buffer ) {
+		memcpy(buffer, src, sizeof(SORT_ITEM) * count);
+	}
+}
+#endif // FEATURE_RENDER_IMPROVED
+
 void __cdecl phd_SortPolyList() {
 	if( SurfaceCount ) {
 		for( DWORD i=0; i<SurfaceCount; ++i ) {
 			SortBuffer[i]._1 += i;
 		}
+#ifdef FEATURE_RENDER_IMPROVED
+		if( PolySortRadixEnabled ) {
+			RadixSortPolyList(SortBuffer, SurfaceCount);
+			return;
+		}
+#endif // FEATURE_RENDER_IMPROVED
 		do_quickysorty(0, SurfaceCount-1);
 	}
 }
@@ -849,10 +1122,119 @@ void __cdecl do_quickysorty(int left, int right) {
 		do_quickysorty(i, right);
 }
 
+#ifdef FEATURE_RENDER_IMPROVED
+// Software renderer may split the surface into horizontal bands, one per CPU core.
+// Every band draws the whole sorted list clipped by its rows into its own XBuffer,
+// so the picture is the same as the picture drawn by a single thread.
+#define RASTER_BANDS_MAX	(8)
+#define RASTER_BAND_ROWS	(120) // the minimal band height
+
+typedef struct RasterBand_t {
+	HANDLE hThread;
+	HANDLE hStart;
+	HANDLE hDone;
+	BYTE *surface;
+	int y0;
+	int y1;
+	int xBuffer[ARRAY_SIZE(XBuffer)];
+} RASTER_BAND;
+
+bool BandRasterEnabled = true;
+static RASTER_BAND *RasterBands[RASTER_BANDS_MAX]; // the first band is drawn by the game thread
+static DWORD RasterBandCount = 0;
+static bool RasterBandsInitialized = false;
+static volatile bool RasterBandsExit = false;
+
+static DWORD WINAPI RasterBandTask(CONST LPVOID lpParam) {
+	RASTER_BAND *band = (RASTER_BAND *)lpParam;
+	while( WaitForSingleObject(band->hStart, INFINITE) == WAIT_OBJECT_0 && !RasterBandsExit ) {
+		PrintPolyListBand(band->surface, band->xBuffer, band->y0, band->y1);
+		SetEvent(band->hDone);
+	}
+	ExitThread(0);
+}
+
+static DWORD InitRasterBands() {
+	SYSTEM_INFO info;
+
+	if( RasterBandsInitialized ) {
+		return RasterBandCount;
+	}
+	RasterBandsInitialized = true;
+	RasterBandsExit = false;
+	RasterBandCount = 1;
+
+	GetSystemInfo(&info);
+	DWORD count = MIN(info.dwNumberOfProcessors, RASTER_BANDS_MAX);
+	for( DWORD i = 1; i < count; ++i ) {
+		RASTER_BAND *band = new RASTER_BAND;
+		if( band == NULL ) break;
+		memset(band, 0, sizeof(RASTER_BAND));
+		band->hStart = CreateEvent(NULL, FALSE, FALSE, NULL);
+		band->hDone = CreateEvent(NULL, FALSE, FALSE, NULL);
+		if( band->hStart != NULL && band->hDone != NULL ) {
+			band->hThread = CreateThread(NULL, 0, &RasterBandTask, band, 0, NULL);
+		}
+		if( band->hThread == NULL ) {
+			if( band->hStart != NULL ) CloseHandle(band->hStart);
+			if( band->hDone != NULL ) CloseHandle(band->hDone);
+			delete band;
+			break;
+		}
+		RasterBands[RasterBandCount++] = band;
+	}
+	return RasterBandCount;
+}
+
+void FreeRasterBands() {
+	RasterBandsExit = true;
+	for( DWORD i = 1; i < RasterBandCount; ++i ) {
+		RASTER_BAND *band = RasterBands[i];
+		SetEvent(band->hStart);
+		WaitForSingleObject(band->hThread, INFINITE);
+		CloseHandle(band->hThread);
+		CloseHandle(band->hStart);
+		CloseHandle(band->hDone);
+		delete band;
+		RasterBands[i] = NULL;
+	}
+	RasterBandCount = 0;
+	RasterBandsInitialized = false;
+}
+
+static bool PrintPolyListBands(BYTE *surfacePtr) {
+	HANDLE doneEvents[RASTER_BANDS_MAX];
+	int rows = PhdWinMinY + PhdWinHeight;
+	DWORD count = MIN(InitRasterBands(), (DWORD)rows / RASTER_BAND_ROWS);
+	if( count < 2 ) {
+		return false;
+	}
+
+	int bandHeight = rows / count;
+	for( DWORD i = 1; i < count; ++i ) {
+		RASTER_BAND *band = RasterBands[i];
+		band->surface = surfacePtr;
+		band->y0 = bandHeight * i;
+		band->y1 = ( i < count - 1 ) ? bandHeight * (i + 1) : INT_MAX;
+		doneEvents[i - 1] = band->hDone;
+		SetEvent(band->hStart);
+	}
+	PrintPolyListBand(surfacePtr, XBuffer, 0, bandHeight);
+	WaitForMultipleObjects(count - 1, doneEvents, TRUE, INFINITE);
+	return true;
+}
+#endif // FEATURE_RENDER_IMPROVED
+
 void __cdecl phd_PrintPolyList(BYTE *surfacePtr) {
 	__int16 polyType, *bufPtr;
 	PrintSurfacePtr = surfacePtr;
 
+#ifdef FEATURE_RENDER_IMPROVED
+	if( BandRasterEnabled && PrintPolyListBands(surfacePtr) ) {
+		return;
+	}
+#endif // FEATURE_RENDER_IMPROVED
+
 	for( DWORD i=0; i<SurfaceCount; ++i ) {
 		bufPtr = (__int16 *)SortBuffer[i]._0;
 		polyType = *(bufPtr++); // poly has type as routine index in first word
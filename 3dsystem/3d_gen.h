@@ -31,6 +31,9 @@
 void ClearMeshReflectState();
 void SetMeshReflectState(int objID, int meshIdx);
 #endif // FEATURE_VIDEOFX_IMPROVED
+#ifdef FEATURE_RENDER_IMPROVED
+void FreeRasterBands();
+#endif // FEATURE_RENDER_IMPROVED
 
 void phd_GenerateW2V(PHD_3DPOS *viewPos); // 0x00401000
 void __cdecl phd_LookAt(int xsrc, int ysrc, int zsrc, int xtar, int ytar, int ztar, __int16 roll); // 0x004011D0
@@ -21,7 +21,10 @@
 
 #include "global/precompiled.h"
 #include "3dsystem/3d_out.h"
+#include "3dsystem/scalespr.h"
+#include "modding/cpu_utils.h"
 #include "global/vars.h"
+#include <limits.h>
 
 #pragma pack(push, 1)
 
@@ -91,10 +94,11 @@ typedef struct {
 
 #pragma pack(pop)
 
-void __cdecl draw_poly_line(__int16 *bufPtr) {
+// The line is clipped by the window, and its pixels are drawn within [bandY0, bandY1) rows only
+static void DrawLine(BYTE *surface, __int16 *bufPtr, int bandY0, int bandY1) {
 	int i, j;
-	int x0, y0, x1, y1;
-	int xSize, ySize, xAdd, yAdd, colAdd, rowAdd;
+	int x0, y0, x1, y1, y;
+	int xSize, ySize, xAdd, yAdd, colAdd, rowAdd, colAddY, rowAddY;
 	int swapBuf, part, partTotal;
 	BYTE colorIdx;
 	BYTE *drawPtr;
@@ -141,13 +145,14 @@ void __cdecl draw_poly_line(__int16 *bufPtr) {
 		y1 = PhdWinMaxY;
 	}
 
-	drawPtr = PrintSurfacePtr + (PhdScreenWidth * y0 + x0);
+	drawPtr = surface + (PhdScreenWidth * y0 + x0);
 
 	xSize = x1 - x0;
 	ySize = y1 - y0;
 
 	if( (xSize|ySize) == 0 ) {
-		*drawPtr = colorIdx;
+		if( y0 >= bandY0 && y0 < bandY1 )
+			*drawPtr = colorIdx;
 		return;
 	}
 
@@ -170,27 +175,39 @@ void __cdecl draw_poly_line(__int16 *bufPtr) {
 		j = ySize + 1;
 		colAdd = xAdd;
 		rowAdd = yAdd;
+		colAddY = 0;
+		rowAddY = ( yAdd < 0 ) ? -1 : 1;
 	} else {
 		i = ySize + 1;
 		j = xSize + 1;
 		colAdd = yAdd;
 		rowAdd = xAdd;
+		colAddY = ( yAdd < 0 ) ? -1 : 1;
+		rowAddY = 0;
 	}
 
 	partTotal = 0;
 	part = PHD_ONE * j / i;
+	y = y0;
 
 	while( i-- ) {
 		partTotal += part;
-		*drawPtr = colorIdx;
+		if( y >= bandY0 && y < bandY1 )
+			*drawPtr = colorIdx;
 		drawPtr += colAdd;
+		y += colAddY;
 		if( partTotal >= PHD_ONE ) {
 			drawPtr += rowAdd;
+			y += rowAddY;
 			partTotal -= PHD_ONE;
 		}
 	}
 }
 
+void __cdecl draw_poly_line(__int16 *bufPtr) {
+	DrawLine(PrintSurfacePtr, bufPtr, 0, INT_MAX);
+}
+
 void __cdecl draw_poly_flat(__int16 *bufPtr) {
 	if( xgen_x(bufPtr + 1) )
 		flatA(XGen_y0, XGen_y1, *bufPtr);
@@ -216,7 +233,7 @@ void __cdecl draw_poly_wgtmap(__int16 *bufPtr) {
 		wgtmapA(XGen_y0, XGen_y1, TexturePageBuffer8[*bufPtr]);
 }
 
-BOOL __cdecl xgen_x(__int16 *bufPtr) {
+static BOOL XGenX(int *xBuffer, __int16 *bufPtr, int *yTop, int *yBottom) {
 	int ptCount;
 	XGEN_X *pt1, *pt2;
 	int yMin, yMax;
@@ -243,7 +260,7 @@ BOOL __cdecl xgen_x(__int16 *bufPtr) {
 			xSize = x2 - x1;
 			ySize = y2 - y1;
 
-			xPtr = (XBUF_X *)XBuffer + y1;
+			xPtr = (XBUF_X *)xBuffer + y1;
 			xAdd = PHD_ONE * xSize / ySize;
 			x = x1 * PHD_ONE + (PHD_ONE - 1);
 
@@ -256,7 +273,7 @@ BOOL __cdecl xgen_x(__int16 *bufPtr) {
 			xSize = x1 - x2;
 			ySize = y1 - y2;
 
-			xPtr = (XBUF_X *)XBuffer + y2;
+			xPtr = (XBUF_X *)xBuffer + y2;
 			xAdd = PHD_ONE * xSize / ySize;
 			x = x2 * PHD_ONE + 1;
 
@@ -269,12 +286,16 @@ BOOL __cdecl xgen_x(__int16 *bufPtr) {
 	if( yMin == yMax )
 		return FALSE;
 
-	XGen_y0 = yMin;
-	XGen_y1 = yMax;
+	*yTop = yMin;
+	*yBottom = yMax;
 	return TRUE;
 }
 
-BOOL __cdecl xgen_xg(__int16 *bufPtr) {
+BOOL __cdecl xgen_x(__int16 *bufPtr) {
+	return XGenX(XBuffer, bufPtr, &XGen_y0, &XGen_y1);
+}
+
+static BOOL XGenXG(int *xBuffer, __int16 *bufPtr, int *yTop, int *yBottom) {
 	int ptCount;
 	XGEN_XG *pt1, *pt2;
 	int yMin, yMax;
@@ -304,7 +325,7 @@ BOOL __cdecl xgen_xg(__int16 *bufPtr) {
 			ySize = y2 - y1;
 			gSize = g2 - g1;
 
-			xgPtr = (XBUF_XG *)XBuffer + y1;
+			xgPtr = (XBUF_XG *)xBuffer + y1;
 			xAdd = PHD_ONE * xSize / ySize;
 			gAdd = PHD_HALF * gSize / ySize;
 			x = x1 * PHD_ONE + (PHD_ONE - 1);
@@ -322,7 +343,7 @@ BOOL __cdecl xgen_xg(__int16 *bufPtr) {
 			ySize = y1 - y2;
 			gSize = g1 - g2;
 
-			xgPtr = (XBUF_XG *)XBuffer + y2;
+			xgPtr = (XBUF_XG *)xBuffer + y2;
 			xAdd = PHD_ONE * xSize / ySize;
 			gAdd = PHD_HALF * gSize / ySize;
 			x = x2 * PHD_ONE + 1;
@@ -339,12 +360,16 @@ BOOL __cdecl xgen_xg(__int16 *bufPtr) {
 	if( yMin == yMax )
 		return FALSE;
 
-	XGen_y0 = yMin;
-	XGen_y1 = yMax;
+	*yTop = yMin;
+	*yBottom = yMax;
 	return TRUE;
 }
 
-BOOL __cdecl xgen_xguv(__int16 *bufPtr) {
+BOOL __cdecl xgen_xg(__int16 *bufPtr) {
+	return XGenXG(XBuffer, bufPtr, &XGen_y0, &XGen_y1);
+}
+
+static BOOL XGenXGUV(int *xBuffer, __int16 *bufPtr, int *yTop, int *yBottom) {
 	int ptCount;
 	XGEN_XGUV *pt1, *pt2;
 	int yMin, yMax;
@@ -380,7 +405,7 @@ BOOL __cdecl xgen_xguv(__int16 *bufPtr) {
 			uSize = u2 - u1;
 			vSize = v2 - v1;
 
-			xguvPtr = (XBUF_XGUV *)XBuffer + y1;
+			xguvPtr = (XBUF_XGUV *)xBuffer + y1;
 			xAdd = PHD_ONE * xSize / ySize;
 			gAdd = PHD_HALF * gSize / ySize;
 			uAdd = PHD_HALF * uSize / ySize;
@@ -406,7 +431,7 @@ BOOL __cdecl xgen_xguv(__int16 *bufPtr) {
 			uSize = u1 - u2;
 			vSize = v1 - v2;
 
-			xguvPtr = (XBUF_XGUV *)XBuffer + y2;
+			xguvPtr = (XBUF_XGUV *)xBuffer + y2;
 			xAdd = PHD_ONE * xSize / ySize;
 			gAdd = PHD_HALF * gSize / ySize;
 			uAdd = PHD_HALF * uSize / ySize;
@@ -429,12 +454,16 @@ BOOL __cdecl xgen_xguv(__int16 *bufPtr) {
 	if( yMin == yMax )
 		return FALSE;
 
-	XGen_y0 = yMin;
-	XGen_y1 = yMax;
+	*yTop = yMin;
+	*yBottom = yMax;
 	return TRUE;
 }
 
-BOOL __cdecl xgen_xguvpersp_fp(__int16 *bufPtr) {
+BOOL __cdecl xgen_xguv(__int16 *bufPtr) {
+	return XGenXGUV(XBuffer, bufPtr, &XGen_y0, &XGen_y1);
+}
+
+static BOOL XGenXGUVPersp(int *xBuffer, __int16 *bufPtr, int *yTop, int *yBottom) {
 	int ptCount;
 	XGEN_XGUVP *pt1, *pt2;
 	int yMin, yMax;
@@ -476,7 +505,7 @@ BOOL __cdecl xgen_xguvpersp_fp(__int16 *bufPtr) {
 			vSize = v2 - v1;
 			rhwSize = rhw2 - rhw1;
 
-			xguvPtr = (XBUF_XGUVP *)XBuffer + y1;
+			xguvPtr = (XBUF_XGUVP *)xBuffer + y1;
 			xAdd = PHD_ONE * xSize / ySize;
 			gAdd = PHD_HALF * gSize / ySize;
 			uAdd = uSize / (float)ySize;
@@ -506,7 +535,7 @@ BOOL __cdecl xgen_xguvpersp_fp(__int16 *bufPtr) {
 			vSize = v1 - v2;
 			rhwSize = rhw1 - rhw2;
 
-			xguvPtr = (XBUF_XGUVP *)XBuffer + y2;
+			xguvPtr = (XBUF_XGUVP *)xBuffer + y2;
 			xAdd = PHD_ONE * xSize / ySize;
 			gAdd = PHD_HALF * gSize / ySize;
 			uAdd = (float)uSize / (float)ySize;
@@ -532,13 +561,124 @@ BOOL __cdecl xgen_xguvpersp_fp(__int16 *bufPtr) {
 	if( yMin == yMax )
 		return FALSE;
 
-	XGen_y0 = yMin;
-	XGen_y1 = yMax;
+	*yTop = yMin;
+	*yBottom = yMax;
 	return TRUE;
 }
 
-void __cdecl gtmap_persp32_fp(int y0, int y1, BYTE *texPage) {
-	int batchSize, batchCounter;
+BOOL __cdecl xgen_xguvpersp_fp(__int16 *bufPtr) {
+	return XGenXGUVPersp(XBuffer, bufPtr, &XGen_y0, &XGen_y1);
+}
+
+// Draws a run of texels with constant steps. This is the reference span kernel.
+// If dup is set every texel is drawn twice, if wgt is set the zero texel is transparent.
+static inline void PerspRun(BYTE *linePtr, const BYTE *texPage, int count, bool dup, bool wgt,
+							int *g, int *u, int *v, int gAdd, int uAdd, int vAdd)
+{
+	BYTE colorIdx;
+	int gg = *g, uu = *u, vv = *v;
+
+	for( ; count > 0; --count ) {
+		colorIdx = texPage[BYTE2(vv)*256 + BYTE2(uu)];
+		if( !wgt || colorIdx != 0 ) {
+			colorIdx = DepthQTable[BYTE2(gg)].index[colorIdx];
+			linePtr[0] = colorIdx;
+			if( dup ) linePtr[1] = colorIdx;
+		}
+		linePtr += dup ? 2 : 1;
+		gg += gAdd;
+		uu += uAdd;
+		vv += vAdd;
+	}
+	*g = gg; *u = uu; *v = vv;
+}
+
+#ifdef FEATURE_RENDER_IMPROVED
+bool SimdSpanEnabled = true;
+
+// Vectorised PerspRun(). It steps 16 texels at once and produces the same pixels.
+SIMD_SSE2 static void PerspRunSimd(BYTE *linePtr, const BYTE *texPage, int count, bool dup, bool wgt,
+								   int *g, int *u, int *v, int gAdd, int uAdd, int vAdd)
+{
+	const BYTE *depthQ = (const BYTE *)DepthQTable;
+	DWORD texIdx[16], qtIdx[16];
+	BYTE texel[16], color[16];
+	const __m128i maskHi = _mm_set1_epi32(0xFF00);
+	const __m128i maskLo = _mm_set1_epi32(0x00FF);
+	// the lanes are stepped in 32 bit integers, so they wrap exactly like the scalar code
+	__m128i vecG = _mm_setr_epi32(*g, (DWORD)*g + gAdd, (DWORD)*g + gAdd*2U, (DWORD)*g + gAdd*3U);
+	__m128i vecU = _mm_setr_epi32(*u, (DWORD)*u + uAdd, (DWORD)*u + uAdd*2U, (DWORD)*u + uAdd*3U);
+	__m128i vecV = _mm_setr_epi32(*v, (DWORD)*v + vAdd, (DWORD)*v + vAdd*2U, (DWORD)*v + vAdd*3U);
+	const __m128i stepG = _mm_set1_epi32(gAdd*4U);
+	const __m128i stepU = _mm_set1_epi32(uAdd*4U);
+	const __m128i stepV = _mm_set1_epi32(vAdd*4U);
+
+	for( int blocks = count / 16; blocks > 0; --blocks ) {
+		for( int i = 0; i < 16; i += 4 ) {
+			__m128i tex = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(vecV, 8), maskHi),
+									   _mm_and_si128(_mm_srli_epi32(vecU, 16), maskLo));
+			_mm_storeu_si128((__m128i *)&texIdx[i], tex);
+			_mm_storeu_si128((__m128i *)&qtIdx[i], _mm_and_si128(_mm_srli_epi32(vecG, 8), maskHi));
+			vecG = _mm_add_epi32(vecG, stepG);
+			vecU = _mm_add_epi32(vecU, stepU);
+			vecV = _mm_add_epi32(vecV, stepV);
+		}
+		// SSE2 has no gather, so texels and depth-queue indices are fetched one by one
+		for( int i = 0; i < 16; ++i ) {
+			texel[i] = texPage[texIdx[i]];
+			color[i] = depthQ[qtIdx[i] + texel[i]];
+		}
+		__m128i pixels = _mm_loadu_si128((__m128i *)color);
+		__m128i skip = _mm_setzero_si128();
+		if( wgt ) {
+			// the colour key is transparent, so the old surface pixels are kept there
+			skip = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i *)texel), skip);
+		}
+		if( dup ) {
+			__m128i lo = _mm_unpacklo_epi8(pixels, pixels);
+			__m128i hi = _mm_unpackhi_epi8(pixels, pixels);
+			if( wgt ) {
+				__m128i skipLo = _mm_unpacklo_epi8(skip, skip);
+				__m128i skipHi = _mm_unpackhi_epi8(skip, skip);
+				lo = _mm_or_si128(_mm_and_si128(skipLo, _mm_loadu_si128((__m128i *)linePtr)), _mm_andnot_si128(skipLo, lo));
+				hi = _mm_or_si128(_mm_and_si128(skipHi, _mm_loadu_si128((__m128i *)(linePtr + 16))), _mm_andnot_si128(skipHi, hi));
+			}
+			_mm_storeu_si128((__m128i *)linePtr, lo);
+			_mm_storeu_si128((__m128i *)(linePtr + 16), hi);
+			linePtr += 32;
+		} else {
+			if( wgt ) {
+				pixels = _mm_or_si128(_mm_and_si128(skip, _mm_loadu_si128((__m128i *)linePtr)), _mm_andnot_si128(skip, pixels));
+			}
+			_mm_storeu_si128((__m128i *)linePtr, pixels);
+			linePtr += 16;
+		}
+	}
+	*g = _mm_cvtsi128_si32(vecG);
+	*u = _mm_cvtsi128_si32(vecU);
+	*v = _mm_cvtsi128_si32(vecV);
+	PerspRun(linePtr, texPage, count % 16, dup, wgt, g, u, v, gAdd, uAdd, vAdd);
+}
+
+static bool IsSimdSpanAvailable() {
+	return ( SimdSpanEnabled && IsSse2Available() );
+}
+#endif // FEATURE_RENDER_IMPROVED
+
+static inline void DrawPerspRun(BYTE *linePtr, const BYTE *texPage, int count, bool dup, bool wgt,
+								int *g, int *u, int *v, int gAdd, int uAdd, int vAdd)
+{
+#ifdef FEATURE_RENDER_IMPROVED
+	if( IsSimdSpanAvailable() ) {
+		PerspRunSimd(linePtr, texPage, count, dup, wgt, g, u, v, gAdd, uAdd, vAdd);
+		return;
+	}
+#endif // FEATURE_RENDER_IMPROVED
+	PerspRun(linePtr, texPage, count, dup, wgt, g, u, v, gAdd, uAdd, vAdd);
+}
+
+static void GTMapPerspSpans(int *xBuffer, BYTE *surface, int y0, int y1, BYTE *texPage) {
+	int batchSize;
 	int x, xSize, ySize;
 	int g, u0, u1, v0, v1, gAdd, u0Add, v0Add;
 	double u, v, rhw, uAdd, vAdd, rhwAdd;
@@ -550,8 +690,8 @@ void __cdecl gtmap_persp32_fp(int y0, int y1, BYTE *texPage) {
 	if( ySize <= 0 )
 		return;
 
-	xbuf = (XBUF_XGUVP *)XBuffer + y0;
-	drawPtr = PrintSurfacePtr + y0 * PhdScreenWidth;
+	xbuf = (XBUF_XGUVP *)xBuffer + y0;
+	drawPtr = surface + y0 * PhdScreenWidth;
 
 	for( ; ySize > 0; --ySize, ++xbuf, drawPtr += PhdScreenWidth ) {
 		x = xbuf->x0 / PHD_ONE;
@@ -589,26 +729,11 @@ void __cdecl gtmap_persp32_fp(int y0, int y1, BYTE *texPage) {
 				v0Add = (v1 - v0) / batchSize;
 
 				if( (ABS(u0Add) + ABS(v0Add)) < (PHD_ONE / 2) ) {
-					batchCounter = batchSize / 2;
-					do {
-						colorIdx = texPage[BYTE2(v0)*256 + BYTE2(u0)];
-						colorIdx = DepthQTable[BYTE2(g)].index[colorIdx];
-						*(linePtr++) = colorIdx;
-						*(linePtr++) = colorIdx;
-						g += gAdd * 2;
-						u0 += u0Add * 2;
-						v0 += v0Add * 2;
-					} while( --batchCounter );
+					DrawPerspRun(linePtr, texPage, batchSize / 2, true, false, &g, &u0, &v0, gAdd * 2, u0Add * 2, v0Add * 2);
 				} else {
-					batchCounter = batchSize;
-					do {
-						colorIdx = texPage[BYTE2(v0)*256 + BYTE2(u0)];
-						*(linePtr++) = DepthQTable[BYTE2(g)].index[colorIdx];
-						g += gAdd;
-						u0 += u0Add;
-						v0 += v0Add;
-					} while( --batchCounter );
+					DrawPerspRun(linePtr, texPage, batchSize, false, false, &g, &u0, &v0, gAdd, u0Add, v0Add);
 				}
+				linePtr += batchSize;
 
 				u0 = u1;
 				v0 = v1;
@@ -626,26 +751,11 @@ void __cdecl gtmap_persp32_fp(int y0, int y1, BYTE *texPage) {
 			xSize -= batchSize;
 
 			if( (ABS(u0Add) + ABS(v0Add)) < (PHD_ONE / 2) ) {
-				batchCounter = batchSize / 2;
-				do {
-					colorIdx = texPage[BYTE2(v0)*256 + BYTE2(u0)];
-					colorIdx = DepthQTable[BYTE2(g)].index[colorIdx];
-					*(linePtr++) = colorIdx;
-					*(linePtr++) = colorIdx;
-					g += gAdd * 2;
-					u0 += u0Add * 2;
-					v0 += v0Add * 2;
-				} while( --batchCounter );
+				DrawPerspRun(linePtr, texPage, batchSize / 2, true, false, &g, &u0, &v0, gAdd * 2, u0Add * 2, v0Add * 2);
 			} else {
-				batchCounter = batchSize;
-				do {
-					colorIdx = texPage[BYTE2(v0)*256 + BYTE2(u0)];
-					*(linePtr++) = DepthQTable[BYTE2(g)].index[colorIdx];
-					g += gAdd;
-					u0 += u0Add;
-					v0 += v0Add;
-				} while( --batchCounter );
+				DrawPerspRun(linePtr, texPage, batchSize, false, false, &g, &u0, &v0, gAdd, u0Add, v0Add);
 			}
+			linePtr += batchSize;
 		}
 
 		if( xSize != 0 ) { // xSize == 1
@@ -655,8 +765,12 @@ void __cdecl gtmap_persp32_fp(int y0, int y1, BYTE *texPage) {
 	}
 }
 
-void __cdecl wgtmap_persp32_fp(int y0, int y1, BYTE *texPage) {
-	int batchSize, batchCounter;
+void __cdecl gtmap_persp32_fp(int y0, int y1, BYTE *texPage) {
+	GTMapPerspSpans(XBuffer, PrintSurfacePtr, y0, y1, texPage);
+}
+
+static void WGTMapPerspSpans(int *xBuffer, BYTE *surface, int y0, int y1, BYTE *texPage) {
+	int batchSize;
 	int x, xSize, ySize;
 	int g, u0, u1, v0, v1, gAdd, u0Add, v0Add;
 	double u, v, rhw, uAdd, vAdd, rhwAdd;
@@ -668,8 +782,8 @@ void __cdecl wgtmap_persp32_fp(int y0, int y1, BYTE *texPage) {
 	if( ySize <= 0 )
 		return;
 
-	xbuf = (XBUF_XGUVP *)XBuffer + y0;
-	drawPtr = PrintSurfacePtr + y0 * PhdScreenWidth;
+	xbuf = (XBUF_XGUVP *)xBuffer + y0;
+	drawPtr = surface + y0 * PhdScreenWidth;
 
 	for( ; ySize > 0; --ySize, ++xbuf, drawPtr += PhdScreenWidth ) {
 		x = xbuf->x0 / PHD_ONE;
@@ -707,32 +821,11 @@ void __cdecl wgtmap_persp32_fp(int y0, int y1, BYTE *texPage) {
 				v0Add = (v1 - v0) / batchSize;
 
 				if( (ABS(u0Add) + ABS(v0Add)) < (PHD_ONE / 2) ) {
-					batchCounter = batchSize / 2;
-					do {
-						colorIdx = texPage[BYTE2(v0)*256 + BYTE2(u0)];
-						if( colorIdx != 0 ) {
-							colorIdx = DepthQTable[BYTE2(g)].index[colorIdx];
-							linePtr[0] = colorIdx;
-							linePtr[1] = colorIdx;
-						}
-						linePtr += 2;
-						g += gAdd * 2;
-						u0 += u0Add * 2;
-						v0 += v0Add * 2;
-					} while( --batchCounter );
+					DrawPerspRun(linePtr, texPage, batchSize / 2, true, true, &g, &u0, &v0, gAdd * 2, u0Add * 2, v0Add * 2);
 				} else {
-					batchCounter = batchSize;
-					do {
-						colorIdx = texPage[BYTE2(v0)*256 + BYTE2(u0)];
-						if( colorIdx != 0 ) {
-							*linePtr = DepthQTable[BYTE2(g)].index[colorIdx];
-						}
-						linePtr++;
-						g += gAdd;
-						u0 += u0Add;
-						v0 += v0Add;
-					} while( --batchCounter );
+					DrawPerspRun(linePtr, texPage, batchSize, false, true, &g, &u0, &v0, gAdd, u0Add, v0Add);
 				}
+				linePtr += batchSize;
 
 				u0 = u1;
 				v0 = v1;
@@ -750,32 +843,11 @@ void __cdecl wgtmap_persp32_fp(int y0, int y1, BYTE *texPage) {
 			xSize -= batchSize;
 
 			if( (ABS(u0Add) + ABS(v0Add)) < (PHD_ONE / 2) ) {
-				batchCounter = batchSize / 2;
-				do {
-					colorIdx = texPage[BYTE2(v0)*256 + BYTE2(u0)];
-					if( colorIdx != 0 ) {
-						colorIdx = DepthQTable[BYTE2(g)].index[colorIdx];
-						linePtr[0] = colorIdx;
-						linePtr[1] = colorIdx;
-					}
-					linePtr += 2;
-					g += gAdd * 2;
-					u0 += u0Add * 2;
-					v0 += v0Add * 2;
-				} while( --batchCounter );
+				DrawPerspRun(linePtr, texPage, batchSize / 2, true, true, &g, &u0, &v0, gAdd * 2, u0Add * 2, v0Add * 2);
 			} else {
-				batchCounter = batchSize;
-				do {
-					colorIdx = texPage[BYTE2(v0)*256 + BYTE2(u0)];
-					if( colorIdx != 0 ) {
-						*linePtr = DepthQTable[BYTE2(g)].index[colorIdx];
-					}
-					linePtr++;
-					g += gAdd;
-					u0 += u0Add;
-					v0 += v0Add;
-				} while( --batchCounter );
+				DrawPerspRun(linePtr, texPage, batchSize, false, true, &g, &u0, &v0, gAdd, u0Add, v0Add);
 			}
+			linePtr += batchSize;
 		}
 
 		if( xSize != 0 ) { // xSize == 1
@@ -787,6 +859,10 @@ void __cdecl wgtmap_persp32_fp(int y0, int y1, BYTE *texPage) {
 	}
 }
 
+void __cdecl wgtmap_persp32_fp(int y0, int y1, BYTE *texPage) {
+	WGTMapPerspSpans(XBuffer, PrintSurfacePtr, y0, y1, texPage);
+}
+
 void __cdecl draw_poly_gtmap_persp(__int16 *bufPtr) {
 	if( xgen_xguvpersp_fp(bufPtr + 1) )
 		gtmap_persp32_fp(XGen_y0, XGen_y1, TexturePageBuffer8[*bufPtr]);
@@ -797,7 +873,7 @@ void __cdecl draw_poly_wgtmap_persp(__int16 *bufPtr) {
 		wgtmap_persp32_fp(XGen_y0, XGen_y1, TexturePageBuffer8[*bufPtr]);
 }
 
-void __fastcall flatA(int y0, int y1, BYTE colorIdx) {
+static void FlatSpans(int *xBuffer, BYTE *surface, int y0, int y1, BYTE colorIdx) {
 	int x, xSize, ySize;
 	BYTE *drawPtr;
 	XBUF_X *xbuf;
@@ -806,8 +882,8 @@ void __fastcall flatA(int y0, int y1, BYTE colorIdx) {
 	if( ySize <= 0 )
 		return;
 
-	xbuf = (XBUF_X *)XBuffer + y0;
-	drawPtr = PrintSurfacePtr + y0 * PhdScreenWidth;
+	xbuf = (XBUF_X *)xBuffer + y0;
+	drawPtr = surface + y0 * PhdScreenWidth;
 
 	for( ; ySize > 0; --ySize, ++xbuf, drawPtr += PhdScreenWidth ) {
 		x = xbuf->x0 / PHD_ONE;
@@ -818,7 +894,11 @@ void __fastcall flatA(int y0, int y1, BYTE colorIdx) {
 	}
 }
 
-void __fastcall transA(int y0, int y1, BYTE depthQ) {
+void __fastcall flatA(int y0, int y1, BYTE colorIdx) {
+	FlatSpans(XBuffer, PrintSurfacePtr, y0, y1, colorIdx);
+}
+
+static void TransSpans(int *xBuffer, BYTE *surface, int y0, int y1, BYTE depthQ) {
 	int x, xSize, ySize;
 	BYTE *drawPtr, *linePtr;
 	XBUF_X *xbuf;
@@ -828,8 +908,8 @@ void __fastcall transA(int y0, int y1, BYTE depthQ) {
 	if( ySize <= 0 || depthQ >= 32 ) // NOTE: depthQ check was ( > 32) in the original code
 		return;
 
-	xbuf = (XBUF_X *)XBuffer + y0;
-	drawPtr = PrintSurfacePtr + y0 * PhdScreenWidth;
+	xbuf = (XBUF_X *)xBuffer + y0;
+	drawPtr = surface + y0 * PhdScreenWidth;
 	qt = DepthQTable + depthQ;
 
 	for( ; ySize > 0; --ySize, ++xbuf, drawPtr += PhdScreenWidth ) {
@@ -846,7 +926,11 @@ void __fastcall transA(int y0, int y1, BYTE depthQ) {
 	}
 }
 
-void __fastcall gourA(int y0, int y1, BYTE colorIdx) {
+void __fastcall transA(int y0, int y1, BYTE depthQ) {
+	TransSpans(XBuffer, PrintSurfacePtr, y0, y1, depthQ);
+}
+
+static void GourSpans(int *xBuffer, BYTE *surface, int y0, int y1, BYTE colorIdx) {
 	int x, xSize, ySize;
 	int g, gAdd;
 	BYTE *drawPtr, *linePtr;
@@ -857,8 +941,8 @@ void __fastcall gourA(int y0, int y1, BYTE colorIdx) {
 	if( ySize <= 0 )
 		return;
 
-	xbuf = (XBUF_XG *)XBuffer + y0;
-	drawPtr = PrintSurfacePtr + y0 * PhdScreenWidth;
+	xbuf = (XBUF_XG *)xBuffer + y0;
+	drawPtr = surface + y0 * PhdScreenWidth;
 	gt = GouraudTable + colorIdx;
 
 	for( ; ySize > 0; --ySize, ++xbuf, drawPtr += PhdScreenWidth ) {
@@ -878,7 +962,11 @@ void __fastcall gourA(int y0, int y1, BYTE colorIdx) {
 	}
 }
 
-void __fastcall gtmapA(int y0, int y1, BYTE *texPage) {
+void __fastcall gourA(int y0, int y1, BYTE colorIdx) {
+	GourSpans(XBuffer, PrintSurfacePtr, y0, y1, colorIdx);
+}
+
+static void GTMapSpans(int *xBuffer, BYTE *surface, int y0, int y1, BYTE *texPage) {
 	int x, xSize, ySize;
 	int g, u, v, gAdd, uAdd, vAdd;
 	BYTE *drawPtr, *linePtr;
@@ -889,8 +977,8 @@ void __fastcall gtmapA(int y0, int y1, BYTE *texPage) {
 	if( ySize <= 0 )
 		return;
 
-	xbuf = (XBUF_XGUV *)XBuffer + y0;
-	drawPtr = PrintSurfacePtr + y0 * PhdScreenWidth;
+	xbuf = (XBUF_XGUV *)xBuffer + y0;
+	drawPtr = surface + y0 * PhdScreenWidth;
 
 	for( ; ySize > 0; --ySize, ++xbuf, drawPtr += PhdScreenWidth ) {
 		x = xbuf->x0 / PHD_ONE;
@@ -916,7 +1004,11 @@ void __fastcall gtmapA(int y0, int y1, BYTE *texPage) {
 	}
 }
 
-void __fastcall wgtmapA(int y0, int y1, BYTE *texPage) {
+void __fastcall gtmapA(int y0, int y1, BYTE *texPage) {
+	GTMapSpans(XBuffer, PrintSurfacePtr, y0, y1, texPage);
+}
+
+static void WGTMapSpans(int *xBuffer, BYTE *surface, int y0, int y1, BYTE *texPage) {
 	int x, xSize, ySize;
 	int g, u, v, gAdd, uAdd, vAdd;
 	BYTE *drawPtr, *linePtr;
@@ -927,8 +1019,8 @@ void __fastcall wgtmapA(int y0, int y1, BYTE *texPage) {
 	if( ySize <= 0 )
 		return;
 
-	xbuf = (XBUF_XGUV *)XBuffer + y0;
-	drawPtr = PrintSurfacePtr + y0 * PhdScreenWidth;
+	xbuf = (XBUF_XGUV *)xBuffer + y0;
+	drawPtr = surface + y0 * PhdScreenWidth;
 
 	for( ; ySize > 0; --ySize, ++xbuf, drawPtr += PhdScreenWidth ) {
 		x = xbuf->x0 / PHD_ONE;
@@ -957,6 +1049,93 @@ void __fastcall wgtmapA(int y0, int y1, BYTE *texPage) {
 	}
 }
 
+void __fastcall wgtmapA(int y0, int y1, BYTE *texPage) {
+	WGTMapSpans(XBuffer, PrintSurfacePtr, y0, y1, texPage);
+}
+
+#ifdef FEATURE_RENDER_IMPROVED
+// Checks if xgen polygon rows [yMin, yMax) cross the band rows. If they don't,
+// the polygon is skipped by the band, exactly like it would be clipped out.
+static bool IsPolyInBand(__int16 *bufPtr, int ptSize, int bandY0, int bandY1) {
+	int ptCount = *bufPtr++;
+	int yMin = (UINT16)bufPtr[1];
+	int yMax = yMin;
+	for( int i = 1; i < ptCount; ++i ) {
+		int y = (UINT16)bufPtr[i * ptSize + 1];
+		CLAMPG(yMin, y);
+		CLAMPL(yMax, y);
+	}
+	return ( yMax > bandY0 && yMin < bandY1 );
+}
+
+static bool ClipBand(int *y0, int *y1, int bandY0, int bandY1) {
+	CLAMPL(*y0, bandY0);
+	CLAMPG(*y1, bandY1);
+	return ( *y0 < *y1 );
+}
+
+void PrintPolyListBand(BYTE *surface, int *xBuffer, int bandY0, int bandY1) {
+	int y0, y1;
+	__int16 polyType, *bufPtr;
+
+	// the same sorted list is drawn by every band, so the painter's order is kept
+	for( DWORD i=0; i<SurfaceCount; ++i ) {
+		bufPtr = (__int16 *)SortBuffer[i]._0;
+		polyType = *(bufPtr++);
+		switch( polyType ) {
+			case POLY_GTmap :
+			case POLY_WGTmap :
+				if( IsPolyInBand(bufPtr + 1, sizeof(XGEN_XGUV) / sizeof(UINT16), bandY0, bandY1) &&
+					XGenXGUV(xBuffer, bufPtr + 1, &y0, &y1) && ClipBand(&y0, &y1, bandY0, bandY1) )
+				{
+					if( polyType == POLY_GTmap )
+						GTMapSpans(xBuffer, surface, y0, y1, TexturePageBuffer8[*bufPtr]);
+					else
+						WGTMapSpans(xBuffer, surface, y0, y1, TexturePageBuffer8[*bufPtr]);
+				}
+				break;
+			case POLY_GTmap_persp :
+			case POLY_WGTmap_persp :
+				if( IsPolyInBand(bufPtr + 1, sizeof(XGEN_XGUVP) / sizeof(UINT16), bandY0, bandY1) &&
+					XGenXGUVPersp(xBuffer, bufPtr + 1, &y0, &y1) && ClipBand(&y0, &y1, bandY0, bandY1) )
+				{
+					if( polyType == POLY_GTmap_persp )
+						GTMapPerspSpans(xBuffer, surface, y0, y1, TexturePageBuffer8[*bufPtr]);
+					else
+						WGTMapPerspSpans(xBuffer, surface, y0, y1, TexturePageBuffer8[*bufPtr]);
+				}
+				break;
+			case POLY_line :
+				DrawLine(surface, bufPtr, bandY0, bandY1);
+				break;
+			case POLY_flat :
+			case POLY_trans :
+				if( IsPolyInBand(bufPtr + 1, sizeof(XGEN_X) / sizeof(UINT16), bandY0, bandY1) &&
+					XGenX(xBuffer, bufPtr + 1, &y0, &y1) && ClipBand(&y0, &y1, bandY0, bandY1) )
+				{
+					if( polyType == POLY_flat )
+						FlatSpans(xBuffer, surface, y0, y1, *bufPtr);
+					else
+						TransSpans(xBuffer, surface, y0, y1, *bufPtr);
+				}
+				break;
+			case POLY_gouraud :
+				if( IsPolyInBand(bufPtr + 1, sizeof(XGEN_XG) / sizeof(UINT16), bandY0, bandY1) &&
+					XGenXG(xBuffer, bufPtr + 1, &y0, &y1) && ClipBand(&y0, &y1, bandY0, bandY1) )
+				{
+					GourSpans(xBuffer, surface, y0, y1, *bufPtr);
+				}
+				break;
+			case POLY_sprite :
+				DrawScaledSprite(surface, bufPtr, bandY0, bandY1);
+				break;
+			default :
+				break;
+		}
+	}
+}
+#endif // FEATURE_RENDER_IMPROVED
+
 /*
  * Inject function
  */
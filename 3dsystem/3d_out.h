@@ -27,6 +27,10 @@
 /*
  * Function list
  */
+#ifdef FEATURE_RENDER_IMPROVED
+void PrintPolyListBand(BYTE *surface, int *xBuffer, int bandY0, int bandY1);
+#endif // FEATURE_RENDER_IMPROVED
+
 void __cdecl draw_poly_line(__int16 *bufPtr); // 0x00402960
 void __cdecl draw_poly_flat(__int16 *bufPtr); // 0x00402B00
 void __cdecl draw_poly_trans(__int16 *bufPtr); // 0x00402B40
@@ -34,6 +34,20 @@ extern HWR_TEXHANDLE GetEnvmapTextureHandle();
 bool CustomWaterColorEnabled = false;
 #endif // FEATURE_VIDEOFX_IMPROVED
 
+#ifdef FEATURE_RENDER_IMPROVED
+#include "modding/texture_atlas.h"
+
+extern void HWR_DrawPolyFan(HWR_TEXHANDLE texSource, bool colorKey, D3DTLVERTEX *vtxPtr, DWORD vtxCount);
+
+static HWR_TEXHANDLE GetTexPageHandle(UINT16 tpage) {
+#ifdef FEATURE_VIDEOFX_IMPROVED
+	return ( tpage == (UINT16)~0 ) ? GetEnvmapTextureHandle() : HWR_PageHandles[tpage];
+#else // !FEATURE_VIDEOFX_IMPROVED
+	return HWR_PageHandles[tpage];
+#endif // !FEATURE_VIDEOFX_IMPROVED
+}
+#endif // FEATURE_RENDER_IMPROVED
+
 static VERTEX_INFO VBuffer[40]; // NOTE: original size was 20
 static D3DTLVERTEX VBufferD3D[32];
 static D3DCOLOR GlobalTint = 0; // NOTE: not presented in the original code
@@ -1434,6 +1448,9 @@ void __cdecl InsertGT3_ZBuffered(PHD_VBUF *vtx0, PHD_VBUF *vtx1, PHD_VBUF *vtx2,
 			VBufferD3D[2].tu = (double)uv2->u / (double)PHD_ONE;
 			VBufferD3D[2].tv = (double)uv2->v / (double)PHD_ONE;
 
+#ifdef FEATURE_RENDER_IMPROVED
+			HWR_DrawPolyFan(GetTexPageHandle(texture->tpage), texture->drawtype != DRAW_Opaque, VBufferD3D, 3);
+#else // !FEATURE_RENDER_IMPROVED
 #ifdef FEATURE_VIDEOFX_IMPROVED
 			HWR_TexSource(texture->tpage == (UINT16)~0 ? GetEnvmapTextureHandle() : HWR_PageHandles[texture->tpage]);
 #else // !FEATURE_VIDEOFX_IMPROVED
@@ -1442,6 +1459,7 @@ void __cdecl InsertGT3_ZBuffered(PHD_VBUF *vtx0, PHD_VBUF *vtx1, PHD_VBUF *vtx2,
 			HWR_EnableColorKey(texture->drawtype != DRAW_Opaque);
 
 			D3DDev->DrawPrimitive(D3DPT_TRIANGLELIST, D3D_TLVERTEX, VBufferD3D, 3, D3DDP_DONOTUPDATEEXTENTS|D3DDP_DONOTCLIP);
+#endif // FEATURE_RENDER_IMPROVED
 			return;
 		}
 
@@ -1540,7 +1558,11 @@ void __cdecl DrawClippedPoly_Textured(int vtxCount) {
 		VBufferD3D[i].tv = tv;
 	}
 
+#ifdef FEATURE_RENDER_IMPROVED
+	HWR_DrawPolyFan(CurrentTexSource, ColorKeyState, VBufferD3D, vtxCount);
+#else // !FEATURE_RENDER_IMPROVED
 	D3DDev->DrawPrimitive(D3DPT_TRIANGLEFAN, D3D_TLVERTEX, VBufferD3D, vtxCount, D3DDP_DONOTUPDATEEXTENTS|D3DDP_DONOTCLIP);
+#endif // FEATURE_RENDER_IMPROVED
 }
 
 void __cdecl InsertGT4_ZBuffered(PHD_VBUF *vtx0, PHD_VBUF *vtx1, PHD_VBUF *vtx2, PHD_VBUF *vtx3, PHD_TEXTURE *texture) {
@@ -1585,6 +1607,9 @@ void __cdecl InsertGT4_ZBuffered(PHD_VBUF *vtx0, PHD_VBUF *vtx1, PHD_VBUF *vtx2,
 		VBufferD3D[3].tu = (double)texture->uv[3].u / (double)PHD_ONE;
 		VBufferD3D[3].tv = (double)texture->uv[3].v / (double)PHD_ONE;
 
+#ifdef FEATURE_RENDER_IMPROVED
+		HWR_DrawPolyFan(GetTexPageHandle(texture->tpage), texture->drawtype != DRAW_Opaque, VBufferD3D, 4);
+#else // !FEATURE_RENDER_IMPROVED
 #ifdef FEATURE_VIDEOFX_IMPROVED
 		HWR_TexSource(texture->tpage == (UINT16)~0 ? GetEnvmapTextureHandle() : HWR_PageHandles[texture->tpage]);
 #else // !FEATURE_VIDEOFX_IMPROVED
@@ -1593,6 +1618,7 @@ void __cdecl InsertGT4_ZBuffered(PHD_VBUF *vtx0, PHD_VBUF *vtx1, PHD_VBUF *vtx2,
 		HWR_EnableColorKey(texture->drawtype != DRAW_Opaque);
 
 		D3DDev->DrawPrimitive(D3DPT_TRIANGLEFAN, D3D_TLVERTEX, VBufferD3D, 4, D3DDP_DONOTUPDATEEXTENTS|D3DDP_DONOTCLIP);
+#endif // FEATURE_RENDER_IMPROVED
 	}
 	else if( (clipOR < 0 && visible_zclip(vtx0, vtx1, vtx2)) ||
 			 (clipOR > 0 && VBUF_VISIBLE(*vtx0, *vtx1, *vtx2)) )
@@ -1790,7 +1816,11 @@ void __cdecl DrawPoly_Gouraud(int vtxCount, int red, int green, int blue) {
 		VBufferD3D[i].color = color;
 	}
 
+#ifdef FEATURE_RENDER_IMPROVED
+	HWR_DrawPolyFan(CurrentTexSource, ColorKeyState, VBufferD3D, vtxCount);
+#else // !FEATURE_RENDER_IMPROVED
 	D3DDev->DrawPrimitive(D3DPT_TRIANGLEFAN, D3D_TLVERTEX, VBufferD3D, vtxCount, D3DDP_DONOTUPDATEEXTENTS|D3DDP_DONOTCLIP);
+#endif // FEATURE_RENDER_IMPROVED
 }
 
 __int16 *__cdecl InsertObjectG3_ZBuffered(__int16 *ptrObj, int number, SORTTYPE sortType) {
@@ -2609,11 +2639,20 @@ void __cdecl InsertSprite_Sorted(int z, int x0, int y0, int x1, int y1, int spri
 	uOffset = LOBYTE(PhdSpriteInfo[spriteIdx].offset) * 256;
 	vOffset = HIBYTE(PhdSpriteInfo[spriteIdx].offset) * 256;
 
+#ifdef FEATURE_RENDER_IMPROVED
+	int texPage = PhdSpriteInfo[spriteIdx].texPage;
+	u0 = rhw * AtlasMapU(texPage, uOffset - UvAdd + PhdSpriteInfo[spriteIdx].width);
+	v0 = rhw * AtlasMapV(texPage, vOffset + UvAdd);
+
+	u1 = rhw * AtlasMapU(texPage, uOffset + UvAdd);
+	v1 = rhw * AtlasMapV(texPage, vOffset - UvAdd + PhdSpriteInfo[spriteIdx].height);
+#else // !FEATURE_RENDER_IMPROVED
 	u0 = rhw * (double)(uOffset - UvAdd + PhdSpriteInfo[spriteIdx].width);
 	v0 = rhw * (double)(vOffset + UvAdd);
 
 	u1 = rhw * (double)(uOffset + UvAdd);
 	v1 = rhw * (double)(vOffset - UvAdd + PhdSpriteInfo[spriteIdx].height);
+#endif // !FEATURE_RENDER_IMPROVED
 
 	VBuffer[0].x = (float)x0;
 	VBuffer[0].y = (float)y0;
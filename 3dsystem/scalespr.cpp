@@ -23,6 +23,7 @@
 #include "3dsystem/scalespr.h"
 #include "specific/output.h"
 #include "global/vars.h"
+#include <limits.h>
 
 #ifdef FEATURE_VIEW_IMPROVED
 extern int CalculateFogShade(int depth);
@@ -220,8 +221,9 @@ void __cdecl S_DrawScreenSprite(int sx, int sy, int sz, int scaleH, int scaleV,
 	}
 }
 
-void __cdecl draw_scaled_spriteC(__int16 *ptrObj) {
-	int i, j;
+// The sprite is clipped by the window, and it is drawn within [bandY0, bandY1) surface rows only
+void DrawScaledSprite(BYTE *surface, __int16 *ptrObj, int bandY0, int bandY1) {
+	int i, j, iEnd;
 	int x1, y1, x2, y2, width, height;
 	int u, uBase, vBase, uAdd, vAdd;
 	__int16 sprIdx, shade;
@@ -267,12 +269,20 @@ void __cdecl draw_scaled_spriteC(__int16 *ptrObj) {
 	height = y2 - y1;
 
 	srcBase = (BYTE *)TexturePageBuffer8[sprite->texPage] + sprite->offset;
-	dst = PrintSurfacePtr + (PhdWinMinY + y1) * PhdScreenWidth + (PhdWinMinX + x1);
+	dst = surface + (PhdWinMinY + y1) * PhdScreenWidth + (PhdWinMinX + x1);
 	dstAdd = PhdScreenWidth - width;
 
 	isDepthQ = (GameVid_IsWindowedVga || depthQ != &DepthQTable[15]); // NOTE: index was 16 in the original code, this was wrong
 
-	for( i = 0; i < height; ++i ) {
+	// skip the rows above the band, the texture coordinates are stepped exactly as for the drawn rows
+	i = MAX(0, bandY0 - (PhdWinMinY + y1));
+	iEnd = MIN(height, bandY1 - (PhdWinMinY + y1));
+	if( i >= iEnd )
+		return;
+	vBase += vAdd * i;
+	dst += PhdScreenWidth * i;
+
+	for( ; i < iEnd; ++i ) {
 		u = uBase;
 		src = srcBase + (vBase >> 16) * 256;
 		for( j = 0; j < width; ++j ) {
@@ -288,6 +298,10 @@ void __cdecl draw_scaled_spriteC(__int16 *ptrObj) {
 	}
 }
 
+void __cdecl draw_scaled_spriteC(__int16 *ptrObj) {
+	DrawScaledSprite(PrintSurfacePtr, ptrObj, 0, INT_MAX);
+}
+
 /*
  * Inject function
  */
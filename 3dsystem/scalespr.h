@@ -27,6 +27,7 @@
 /*
  * Function list
  */
+void DrawScaledSprite(BYTE *surface, __int16 *ptrObj, int bandY0, int bandY1);
 void __cdecl S_DrawSprite(DWORD flags, int x, int y, int z, __int16 spriteIdx, __int16 shade, __int16 scale); // 0x0040C030
 void __cdecl S_DrawPickup(int sx, int sy, int scale, __int16 spriteIdx, __int16 shade); // 0x0040C300
 __int16 *__cdecl ins_room_sprite(__int16 *ptrObj, int vtxCount); // 0x0040C390
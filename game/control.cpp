@@ -21,9 +21,333 @@
 
 #include "global/precompiled.h"
 #include "game/control.h"
+#include "game/draw.h"
+#include "modding/profiler.h"
 #include "global/vars.h"
 
+#ifdef FEATURE_LOADING_IMPROVED
+#include "modding/floor_table.h"
+#endif // FEATURE_LOADING_IMPROVED
 
+#define LOS_ROOMS	(20)
+
+// Sector boundaries on one axis of the line of sight, as they are walked by xLOS and zLOS
+typedef struct LosWalk_t {
+	int x, y, z; // the current boundary point
+	int dx, dy, dz; // the step to the next boundary point
+	int nx, nz; // the offset to the sector beyond the boundary
+	int count; // the boundaries before the target
+} LOS_WALK;
+
+// The rooms passed by the last axis walk, ObjectOnLOS searches them for the smashable items
+static __int16 LosRooms[LOS_ROOMS];
+static int LosRoomCount = 0;
+
+static FLOOR_INFO *GetRoomSector(ROOM_INFO *room, int x, int z) {
+	return &room->floor[((z - room->z) >> WALL_SHIFT) + ((x - room->x) >> WALL_SHIFT) * room->xSize];
+}
+
+// The sectors on the room edges are the walls or the doors, so the position
+// is clamped to the room, and the corner sectors are skipped
+static FLOOR_INFO *GetRoomSectorClamped(ROOM_INFO *room, int x, int z) {
+	int xFloor = (z - room->z) >> WALL_SHIFT;
+	int yFloor = (x - room->x) >> WALL_SHIFT;
+
+	if( xFloor <= 0 ) {
+		xFloor = 0;
+		CLAMP(yFloor, 1, room->ySize - 2);
+	} else if( xFloor >= room->xSize - 1 ) {
+		xFloor = room->xSize - 1;
+		CLAMP(yFloor, 1, room->ySize - 2);
+	} else {
+		CLAMP(yFloor, 0, room->ySize - 1);
+	}
+	return &room->floor[xFloor + yFloor * room->xSize];
+}
+
+FLOOR_INFO *__cdecl GetFloor(int x, int y, int z, __int16 *roomID) {
+	ROOM_INFO *room;
+	FLOOR_INFO *floor;
+	__int16 door;
+
+	for(;;) {
+		room = &RoomInfo[*roomID];
+		floor = GetRoomSectorClamped(room, x, z);
+#ifdef FEATURE_LOADING_IMPROVED
+		door = FloorTableGetDoor(*roomID, floor);
+#else // FEATURE_LOADING_IMPROVED
+		door = GetDoor(floor);
+#endif // FEATURE_LOADING_IMPROVED
+		if( door == NO_ROOM ) break;
+		*roomID = door;
+	}
+
+	if( y >= floor->floor << 8 ) {
+		while( floor->pitRoom != NO_ROOM ) {
+			*roomID = floor->pitRoom;
+			floor = GetRoomSector(&RoomInfo[*roomID], x, z);
+			if( y < floor->floor << 8 ) break;
+		}
+	} else if( y < floor->ceiling << 8 ) {
+		while( floor->skyRoom != NO_ROOM ) {
+			*roomID = floor->skyRoom;
+			floor = GetRoomSector(&RoomInfo[*roomID], x, z);
+			if( y >= floor->ceiling << 8 ) break;
+		}
+	}
+	return floor;
+}
+
+int __cdecl GetWaterHeight(int x, int y, int z, __int16 roomID) {
+	ROOM_INFO *room;
+	FLOOR_INFO *floor;
+	__int16 door;
+
+	for(;;) {
+		room = &RoomInfo[roomID];
+		floor = GetRoomSectorClamped(room, x, z);
+#ifdef FEATURE_LOADING_IMPROVED
+		door = FloorTableGetDoor(roomID, floor);
+#else // FEATURE_LOADING_IMPROVED
+		door = GetDoor(floor);
+#endif // FEATURE_LOADING_IMPROVED
+		if( door == NO_ROOM ) break;
+		roomID = door;
+	}
+
+	if( CHK_ANY(room->flags, ROOM_UNDERWATER) ) {
+		while( floor->skyRoom != NO_ROOM ) {
+			room = &RoomInfo[floor->skyRoom];
+			if( !CHK_ANY(room->flags, ROOM_UNDERWATER) ) break;
+			floor = GetRoomSector(room, x, z);
+		}
+		return floor->ceiling << 8;
+	}
+
+	while( floor->pitRoom != NO_ROOM ) {
+		room = &RoomInfo[floor->pitRoom];
+		if( CHK_ANY(room->flags, ROOM_UNDERWATER) ) {
+			return floor->floor << 8;
+		}
+		floor = GetRoomSector(room, x, z);
+	}
+	return NO_HEIGHT;
+}
+
+__int16 __cdecl GetDoor(FLOOR_INFO *floor) {
+	if( floor->index == 0 ) {
+		return NO_ROOM;
+	}
+	__int16 *data = &FloorData[floor->index];
+	__int16 type = *(data++);
+	// the door goes after the floor and ceiling slopes, if there are any.
+	// NOTE: the slopes are compared with the end bit, so the last entry stops the walk
+	if( type == FT_TILT ) {
+		++data;
+		type = *(data++);
+	}
+	if( type == FT_ROOF ) {
+		++data;
+		type = *(data++);
+	}
+	if( (type & FD_TYPE_MASK) == FT_DOOR ) {
+		return *data;
+	}
+	return NO_ROOM;
+}
+
+static void AddLosRoom(__int16 roomID) {
+	if( LosRooms[LosRoomCount - 1] != roomID && LosRoomCount < LOS_ROOMS ) {
+		LosRooms[LosRoomCount++] = roomID;
+	}
+}
+
+static int TestLosBoundary(int x, int y, int z, int nx, int nz, __int16 *roomID, __int16 *lastRoom) {
+	FLOOR_INFO *floor;
+
+	PROFILE_COUNT(PROF_LosBoundaries, 1);
+	floor = GetFloor(x, y, z, roomID);
+	AddLosRoom(*roomID);
+	if( y > GetHeight(floor, x, y, z) || y < GetCeiling(floor, x, y, z) ) {
+		return -1;
+	}
+	*lastRoom = *roomID;
+	floor = GetFloor(x + nx, y, z + nz, roomID);
+	AddLosRoom(*roomID);
+	if( y > GetHeight(floor, x + nx, y, z + nz) || y < GetCeiling(floor, x + nx, y, z + nz) ) {
+		return 0;
+	}
+	return 1;
+}
+
+static void InitLosWalk(LOS_WALK *walk, GAME_VECTOR *start, GAME_VECTOR *target, bool isAxisX) {
+	int from = isAxisX ? start->x : start->z;
+	int to = isAxisX ? target->x : target->z;
+	int delta = to - from;
+	int first, second, pos;
+
+	// the same fixed point math as the original, so the boundary points are the same
+	first = ((target->y - start->y) << WALL_SHIFT) / delta;
+	second = ((isAxisX ? target->z - start->z : target->x - start->x) << WALL_SHIFT) / delta;
+	if( delta < 0 ) {
+		pos = from & ~(WALL_L - 1);
+		walk->count = ( pos > to ) ? (pos - to - 1) / WALL_L + 1 : 0;
+	} else {
+		pos = from | (WALL_L - 1);
+		walk->count = ( pos < to ) ? (to - pos - 1) / WALL_L + 1 : 0;
+	}
+	int y = start->y + ((first * (pos - from)) >> WALL_SHIFT);
+	int other = (isAxisX ? start->z : start->x) + ((second * (pos - from)) >> WALL_SHIFT);
+	int step = WALL_L;
+	int side = 1;
+	if( delta < 0 ) {
+		first = -first;
+		second = -second;
+		step = -WALL_L;
+		side = -1;
+	}
+
+	walk->y = y;
+	walk->dy = first;
+	if( isAxisX ) {
+		walk->x = pos;
+		walk->z = other;
+		walk->dx = step;
+		walk->dz = second;
+		walk->nx = side;
+		walk->nz = 0;
+	} else {
+		walk->z = pos;
+		walk->x = other;
+		walk->dz = step;
+		walk->dx = second;
+		walk->nx = 0;
+		walk->nz = side;
+	}
+}
+
+static int WalkLosAxis(GAME_VECTOR *start, GAME_VECTOR *target, bool isAxisX) {
+	LOS_WALK walk;
+	__int16 roomID = start->roomNumber;
+	__int16 lastRoom = roomID;
+
+	if( (isAxisX ? target->x - start->x : target->z - start->z) == 0 ) {
+		return 1;
+	}
+	LosRooms[0] = start->roomNumber;
+	LosRoomCount = 1;
+
+	InitLosWalk(&walk, start, target, isAxisX);
+	for( ; walk.count > 0; --walk.count ) {
+		int result = TestLosBoundary(walk.x, walk.y, walk.z, walk.nx, walk.nz, &roomID, &lastRoom);
+		if( result != 1 ) {
+			target->x = walk.x;
+			target->y = walk.y;
+			target->z = walk.z;
+			target->roomNumber = ( result < 0 ) ? roomID : lastRoom;
+			return result;
+		}
+		walk.x += walk.dx;
+		walk.y += walk.dy;
+		walk.z += walk.dz;
+	}
+	target->roomNumber = roomID;
+	return 1;
+}
+
+int __cdecl LOS(GAME_VECTOR *start, GAME_VECTOR *target) {
+	int los1, los2;
+
+	PROFILE_COUNT(PROF_LosCalls, 1);
+	if( ABS(target->z - start->z) > ABS(target->x - start->x) ) {
+		los1 = xLOS(start, target);
+		los2 = zLOS(start, target);
+	} else {
+		los1 = zLOS(start, target);
+		los2 = xLOS(start, target);
+	}
+	if( los2 ) {
+		FLOOR_INFO *floor = GetFloor(target->x, target->y, target->z, &target->roomNumber);
+		if( ClipTarget(start, target, floor) && los1 == 1 && los2 == 1 ) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int __cdecl zLOS(GAME_VECTOR *start, GAME_VECTOR *target) {
+	return WalkLosAxis(start, target, false);
+}
+
+int __cdecl xLOS(GAME_VECTOR *start, GAME_VECTOR *target) {
+	return WalkLosAxis(start, target, true);
+}
+
+int __cdecl ClipTarget(GAME_VECTOR *start, GAME_VECTOR *target, FLOOR_INFO *floor) {
+	int dx = target->x - start->x;
+	int dy = target->y - start->y;
+	int dz = target->z - start->z;
+	int height;
+
+	height = GetHeight(floor, target->x, target->y, target->z);
+	if( target->y > height && start->y < height ) {
+		target->x = start->x + dx * (height - start->y) / dy;
+		target->y = height;
+		target->z = start->z + dz * (height - start->y) / dy;
+		return 0;
+	}
+	height = GetCeiling(floor, target->x, target->y, target->z);
+	if( target->y < height && start->y > height ) {
+		target->x = start->x + dx * (height - start->y) / dy;
+		target->y = height;
+		target->z = start->z + dz * (height - start->y) / dy;
+		return 0;
+	}
+	return 1;
+}
+
+int __cdecl ObjectOnLOS(GAME_VECTOR *start, GAME_VECTOR *target) {
+	int dx = target->x - start->x;
+	int dy = target->y - start->y;
+	int dz = target->z - start->z;
+
+	for( int i = 0; i < LosRoomCount; ++i ) {
+		for( __int16 itemID = RoomInfo[LosRooms[i]].itemNumber; itemID >= 0; itemID = Items[itemID].nextItem ) {
+			ITEM_INFO *item = &Items[itemID];
+			if( item->status == ITEM_DISABLED || (item->objectID != ID_WINDOW1 && item->objectID != ID_BELL) ) {
+				continue;
+			}
+			__int16 *bounds = GetBoundsAccurate(item);
+			// the extents are swapped only for the items turned exactly east or west
+			bool isTurned = ( item->pos.rotY == PHD_90 || item->pos.rotY == -PHD_90 );
+			__int16 *xExtent = isTurned ? &bounds[4] : &bounds[0];
+			__int16 *zExtent = isTurned ? &bounds[0] : &bounds[4];
+			// the ray is tested against both faces of the item box across its main axis
+			for( int j = 0; j < 2; ++j ) {
+				if( ABS(dz) > ABS(dx) ) {
+					int distance = item->pos.z + zExtent[j] - start->z;
+					if( (distance ^ dz) < 0 || ABS(distance) > ABS(dz) ) continue;
+					int x = dx * distance / dz;
+					if( x < item->pos.x + xExtent[0] - start->x || x > item->pos.x + xExtent[1] - start->x ) continue;
+					int y = dy * distance / dz;
+					if( y >= item->pos.y + bounds[2] - start->y && y <= item->pos.y + bounds[3] - start->y ) {
+						return itemID;
+					}
+				} else if( dx != 0 ) {
+					int distance = item->pos.x + xExtent[j] - start->x;
+					if( (distance ^ dx) < 0 || ABS(distance) > ABS(dx) ) continue;
+					int z = dz * distance / dx;
+					if( z < item->pos.z + zExtent[0] - start->z || z > item->pos.z + zExtent[1] - start->z ) continue;
+					int y = dy * distance / dx;
+					if( y >= item->pos.y + bounds[2] - start->y && y <= item->pos.y + bounds[3] - start->y ) {
+						return itemID;
+					}
+				}
+			}
+		}
+	}
+	return -1;
+}
 
 /*
  * Inject function
@@ -33,19 +357,19 @@ void Inject_Control() {
 //	INJECT(0x004146C0, AnimateItem);
 //	INJECT(0x00414A30, GetChange);
 //	INJECT(0x00414AE0, TranslateItem);
-//	INJECT(0x00414B40, GetFloor);
-//	INJECT(0x00414CE0, GetWaterHeight);
+	INJECT(0x00414B40, GetFloor);
+	INJECT(0x00414CE0, GetWaterHeight);
 //	INJECT(0x00414E50, GetHeight);
 //	INJECT(0x004150D0, RefreshCamera);
 //	INJECT(0x004151C0, TestTriggers);
 //	INJECT(0x004158A0, TriggerActive);
 //	INJECT(0x00415900, GetCeiling);
-//	INJECT(0x00415B60, GetDoor);
-//	INJECT(0x00415BB0, LOS);
-//	INJECT(0x00415C50, zLOS);
-//	INJECT(0x00415F40, xLOS);
-//	INJECT(0x00416230, ClipTarget);
-//	INJECT(0x00416310, ObjectOnLOS);
+	INJECT(0x00415B60, GetDoor);
+	INJECT(0x00415BB0, LOS);
+	INJECT(0x00415C50, zLOS);
+	INJECT(0x00415F40, xLOS);
+	INJECT(0x00416230, ClipTarget);
+	INJECT(0x00416310, ObjectOnLOS);
 //	INJECT(0x00416610, FlipMap);
 //	INJECT(0x004166D0, RemoveRoomFlipItems);
 //	INJECT(0x00416770, AddRoomFlipItems);
@@ -33,20 +33,22 @@
 // 0x00414A30:		GetChange
 // 0x00414AE0:		TranslateItem
 
-#define GetFloor ((FLOOR_INFO*(__cdecl*)(int, int, int, __int16*)) 0x00414B40)
-#define GetWaterHeight ((int(__cdecl*)(int, int, int, __int16)) 0x00414CE0)
+FLOOR_INFO *__cdecl GetFloor(int x, int y, int z, __int16 *roomID); // 0x00414B40
+int __cdecl GetWaterHeight(int x, int y, int z, __int16 roomID); // 0x00414CE0
 #define GetHeight ((int(__cdecl*)(FLOOR_INFO*, int, int, int)) 0x00414E50)
 
 // 0x004150D0:		RefreshCamera
 // 0x004151C0:		TestTriggers
 // 0x004158A0:		TriggerActive
-// 0x00415900:		GetCeiling
-// 0x00415B60:		GetDoor
-// 0x00415BB0:		LOS
-// 0x00415C50:		zLOS
-// 0x00415F40:		xLOS
-// 0x00416230:		ClipTarget
-// 0x00416310:		ObjectOnLOS
+#define GetCeiling ((int(__cdecl*)(FLOOR_INFO*, int, int, int)) 0x00415900)
+
+__int16 __cdecl GetDoor(FLOOR_INFO *floor); // 0x00415B60
+int __cdecl LOS(GAME_VECTOR *start, GAME_VECTOR *target); // 0x00415BB0
+int __cdecl zLOS(GAME_VECTOR *start, GAME_VECTOR *target); // 0x00415C50
+int __cdecl xLOS(GAME_VECTOR *start, GAME_VECTOR *target); // 0x00415F40
+int __cdecl ClipTarget(GAME_VECTOR *start, GAME_VECTOR *target, FLOOR_INFO *floor); // 0x00416230
+int __cdecl ObjectOnLOS(GAME_VECTOR *start, GAME_VECTOR *target); // 0x00416310
+
 // 0x00416610:		FlipMap
 // 0x004166D0:		RemoveRoomFlipItems
 // 0x00416770:		AddRoomFlipItems
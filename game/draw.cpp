@@ -26,8 +26,14 @@
 #include "game/hair.h"
 #include "specific/game.h"
 #include "specific/output.h"
+#include "modding/profiler.h"
 #include "global/vars.h"
 
+#ifdef FEATURE_RENDER_IMPROVED
+#include "modding/anim_cache.h"
+#include "modding/room_visibility.h"
+#endif // FEATURE_RENDER_IMPROVED
+
 #ifdef FEATURE_VIDEOFX_IMPROVED
 extern DWORD AlphaBlendMode;
 #endif // FEATURE_VIDEOFX_IMPROVED
@@ -35,6 +41,7 @@ extern DWORD AlphaBlendMode;
 void __cdecl DrawRooms(__int16 currentRoom) {
 	ROOM_INFO *room = &RoomInfo[currentRoom];
 
+	PROFILE_ENTER(PROF_DrawRooms);
 	PhdWinLeft = room->left = 0;
 	PhdWinTop = room->top = 0;
 	PhdWinRight = room->right = PhdWinMaxX;
@@ -60,7 +67,18 @@ void __cdecl DrawRooms(__int16 currentRoom) {
 	}
 
 	UnderwaterCamera = room->flags & ROOM_UNDERWATER;
+	PROFILE_COUNT(PROF_RoomWalkFrames, 1);
+#ifdef FEATURE_RENDER_IMPROVED
+	if( RoomVisibilityRestore(currentRoom) ) {
+		PROFILE_COUNT(PROF_RoomWalkReused, 1);
+	} else {
+		GetRoomBounds();
+		RoomVisibilityStore(currentRoom);
+	}
+#else // FEATURE_RENDER_IMPROVED
 	GetRoomBounds();
+#endif // FEATURE_RENDER_IMPROVED
+	PROFILE_COUNT(PROF_RoomWalkDrawn, DrawRoomsCount);
 	MidSort = 0;
 
 	if( OutsideCamera ) {
@@ -112,6 +130,155 @@ void __cdecl DrawRooms(__int16 currentRoom) {
 	for( int i = 0; i < DrawRoomsCount; ++i ) {
 		PrintObjects(DrawRoomsArray[i]);
 	}
+	PROFILE_LEAVE(PROF_DrawRooms);
+}
+
+void __cdecl GetRoomBounds() {
+	while( BoundStart != BoundEnd ) {
+		int roomNumber = BoundRooms[BoundStart++ % ARRAY_SIZE(BoundRooms)];
+		ROOM_INFO *room = &RoomInfo[roomNumber];
+
+		PROFILE_COUNT(PROF_RoomWalkTraversed, 1);
+		room->boundActive -= 2;
+		MidSort = (room->boundActive >> 8) + 1;
+
+		if( room->left < room->boundLeft ) room->boundLeft = room->left;
+		if( room->top < room->boundTop ) room->boundTop = room->top;
+		if( room->right > room->boundRight ) room->boundRight = room->right;
+		if( room->bottom > room->boundBotom ) room->boundBotom = room->bottom;
+
+		if( !(room->boundActive & 1) ) {
+			DrawRoomsArray[DrawRoomsCount++] = roomNumber;
+			room->boundActive |= 1;
+			if( room->flags & ROOM_OUTSIDE ) {
+				if( room->boundLeft < OutsideLeft ) OutsideLeft = room->boundLeft;
+				if( room->boundRight > OutsideRight ) OutsideRight = room->boundRight;
+				if( room->boundTop < OutsideTop ) OutsideTop = room->boundTop;
+				if( room->boundBotom > OutsideBottom ) OutsideBottom = room->boundBotom;
+			}
+		}
+
+		if( room->doors == NULL ) continue;
+
+		phd_PushMatrix();
+		phd_TranslateAbs(room->x, room->y, room->z);
+		for( int i = 0; i < room->doors->wCount; ++i ) {
+			DOOR_INFO *door = &room->doors->door[i];
+			// only the doors facing the camera are passed through
+			if( door->x * (room->x + door->vertex[0].x - MatrixW2V._03)
+				+ door->y * (room->y + door->vertex[0].y - MatrixW2V._13)
+				+ door->z * (room->z + door->vertex[0].z - MatrixW2V._23) < 0 )
+			{
+				SetRoomBounds(&door->x, door->room, room);
+			}
+		}
+		phd_PopMatrix();
+	}
+}
+
+void __cdecl SetRoomBounds(__int16 *ptrObj, int roomNumber, ROOM_INFO *parent) {
+	ROOM_INFO *room = &RoomInfo[roomNumber];
+	PHD_VECTOR vtx[4];
+	int left, right, top, bottom;
+	int zBehind = 0, zTooFar = 0;
+
+	// the room is already drawn in the whole parent window
+	if( room->boundLeft <= parent->left && room->boundRight >= parent->right
+		&& room->boundTop <= parent->top && room->boundBotom >= parent->bottom )
+	{
+		return;
+	}
+
+	left = parent->right;
+	right = parent->left;
+	top = parent->bottom;
+	bottom = parent->top;
+	ptrObj += 3; // skip the door normal
+
+	for( int i = 0; i < 4; ++i, ptrObj += 3 ) {
+		int xv = PhdMatrixPtr->_00 * ptrObj[0] + PhdMatrixPtr->_01 * ptrObj[1] + PhdMatrixPtr->_02 * ptrObj[2] + PhdMatrixPtr->_03;
+		int yv = PhdMatrixPtr->_10 * ptrObj[0] + PhdMatrixPtr->_11 * ptrObj[1] + PhdMatrixPtr->_12 * ptrObj[2] + PhdMatrixPtr->_13;
+		int zv = PhdMatrixPtr->_20 * ptrObj[0] + PhdMatrixPtr->_21 * ptrObj[1] + PhdMatrixPtr->_22 * ptrObj[2] + PhdMatrixPtr->_23;
+		vtx[i].x = xv;
+		vtx[i].y = yv;
+		vtx[i].z = zv;
+
+		if( zv <= 0 ) {
+			++zBehind;
+			continue;
+		}
+		if( zv > PhdFarZ ) {
+			++zTooFar;
+		}
+
+		int xs, ys;
+		int zp = zv / PhdPersp;
+		if( zp ) {
+			xs = xv / zp + PhdWinCenterX;
+			ys = yv / zp + PhdWinCenterY;
+		} else {
+			xs = ( xv < 0 ) ? PhdWinLeft : PhdWinRight;
+			ys = ( yv < 0 ) ? PhdWinTop : PhdWinBottom;
+		}
+
+		if( xs - 1 < left ) left = xs - 1;
+		if( xs + 1 > right ) right = xs + 1;
+		if( ys - 1 < top ) top = ys - 1;
+		if( ys + 1 > bottom ) bottom = ys + 1;
+	}
+
+	if( zBehind == 4 || zTooFar == 4 ) {
+		return;
+	}
+
+	// the door edges crossing the camera plane open the window up to the screen edges
+	if( zBehind > 0 ) {
+		for( int i = 0, j = 3; i < 4; j = i++ ) {
+			if( (vtx[i].z < 0) == (vtx[j].z < 0) ) continue;
+
+			if( vtx[i].x < 0 && vtx[j].x < 0 ) {
+				left = 0;
+			} else if( vtx[i].x > 0 && vtx[j].x > 0 ) {
+				right = PhdWinMaxX;
+			} else {
+				left = 0;
+				right = PhdWinMaxX;
+			}
+
+			if( vtx[i].y < 0 && vtx[j].y < 0 ) {
+				top = 0;
+			} else if( vtx[i].y > 0 && vtx[j].y > 0 ) {
+				bottom = PhdWinMaxY;
+			} else {
+				top = 0;
+				bottom = PhdWinMaxY;
+			}
+		}
+	}
+
+	CLAMPL(left, parent->left);
+	CLAMPL(top, parent->top);
+	CLAMPG(right, parent->right);
+	CLAMPG(bottom, parent->bottom);
+
+	if( left >= right || top >= bottom ) {
+		return;
+	}
+
+	if( room->boundActive & 2 ) {
+		if( left < room->left ) room->left = left;
+		if( top < room->top ) room->top = top;
+		if( right > room->right ) room->right = right;
+		if( bottom > room->bottom ) room->bottom = bottom;
+	} else {
+		BoundRooms[BoundEnd++ % ARRAY_SIZE(BoundRooms)] = roomNumber;
+		room->boundActive |= 2;
+		room->boundActive += (__int16)(MidSort << 8);
+		room->left = left;
+		room->right = right;
+		room->top = top;
+		room->bottom = bottom;
+	}
 }
 
 void __cdecl DrawEffect(__int16 fx_id) {
@@ -185,6 +352,12 @@ void __cdecl DrawAnimatingItem(ITEM_INFO *item) {
 
 	if( clip ) {
 		CalculateObjectLighting(item, frames[0]);
+#ifdef FEATURE_RENDER_IMPROVED
+		AnimCacheBind(frames[0], obj->nMeshes);
+		if( frac ) {
+			AnimCacheBind(frames[1], obj->nMeshes);
+		}
+#endif // FEATURE_RENDER_IMPROVED
 
 		__int16 *rots = item->data ? (__int16 *)item->data : no_rotation;
 		__int16 **meshPtr = &MeshPtr[obj->meshIndex];
@@ -288,6 +461,9 @@ void __cdecl DrawAnimatingItem(ITEM_INFO *item) {
 				}
 			}
 		}
+#ifdef FEATURE_RENDER_IMPROVED
+		AnimCacheUnbind();
+#endif // FEATURE_RENDER_IMPROVED
 	}
 	phd_PopMatrix();
 }
@@ -319,6 +495,11 @@ void __cdecl DrawLaraInt(ITEM_INFO *item, __int16 *frame1, __int16 *frame2, int
 
 	rot1 = (UINT16 *)frame1 + 9;
 	rot2 = (UINT16 *)frame2 + 9;
+#ifdef FEATURE_RENDER_IMPROVED
+	// the arms and the back gun take their rotations from other frames, they are decoded as usual
+	AnimCacheBind(frame1, obj->nMeshes);
+	AnimCacheBind(frame2, obj->nMeshes);
+#endif // FEATURE_RENDER_IMPROVED
 
 	InitInterpolate(frac, rate);
 	phd_TranslateRel_ID(frame1[6], frame1[7], frame1[8], frame2[6], frame2[7], frame2[8]);
@@ -526,12 +707,21 @@ void __cdecl DrawLaraInt(ITEM_INFO *item, __int16 *frame1, __int16 *frame2, int
 		default:
 			break;
 	}
+#ifdef FEATURE_RENDER_IMPROVED
+	AnimCacheUnbind();
+#endif // FEATURE_RENDER_IMPROVED
 	phd_PopMatrix();
 	phd_PopMatrix();
 	phd_PopMatrix();
 }
 
 void __cdecl phd_RotYXZsuperpack(UINT16 **pptr, int index) {
+#ifdef FEATURE_RENDER_IMPROVED
+	// the decoded rotation blocks of the bound frames
+	if( AnimCacheRotate(pptr, index) ) {
+		return;
+	}
+#endif // FEATURE_RENDER_IMPROVED
 	for( int i = 0; i < index; ++i ) {
 		if( (**pptr >> 14) == 0 )
 			*pptr += 2;
@@ -640,8 +830,8 @@ void Inject_Draw() {
 
 	INJECT(0x004189A0, DrawRooms);
 
-//	INJECT(0x00418C50, GetRoomBounds);
-//	INJECT(0x00418E20, SetRoomBounds);
+	INJECT(0x00418C50, GetRoomBounds);
+	INJECT(0x00418E20, SetRoomBounds);
 //	INJECT(0x004191A0, ClipRoom);
 //	INJECT(0x00419580, PrintRooms);
 //	INJECT(0x00419640, PrintObjects);
@@ -31,9 +31,9 @@
 #define DrawPhaseGame ((int(__cdecl*)(void)) 0x00418960)
 
 void __cdecl DrawRooms(__int16 currentRoom); // 0x004189A0
+void __cdecl GetRoomBounds(); // 0x00418C50
+void __cdecl SetRoomBounds(__int16 *ptrObj, int roomNumber, ROOM_INFO *parent); // 0x00418E20
 
-#define GetRoomBounds ((void(__cdecl*)(void)) 0x00418C50)
-#define SetRoomBounds ((void(__cdecl*)(__int16, int, ROOM_INFO*)) 0x00418E20)
 #define ClipRoom ((void(__cdecl*)(ROOM_INFO*)) 0x004191A0)
 #define PrintRooms ((void(__cdecl*)(__int16)) 0x00419580)
 #define PrintObjects ((void(__cdecl*)(__int16)) 0x00419640)
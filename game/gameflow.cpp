@@ -101,6 +101,17 @@ static bool __cdecl GF_GetSequenceValue(DWORD levelID, GF_EVENTS event, __int16
 	return result;
 }
 
+#ifdef FEATURE_LOADING_IMPROVED
+// NOTE: there is no such function in the original code
+static void __cdecl GF_PrefetchLevel(DWORD levelID) {
+	__int16 level = -1;
+	// the level file is read in background while FMVs, cutscenes or statistics are shown
+	if( GF_GetSequenceValue(levelID, GFE_STARTLEVEL, &level, -1) && level >= 0 && (DWORD)level < GF_GameFlow.num_Levels ) {
+		PrefetchLevelFile(GF_LevelFilesStringTable[level]);
+	}
+}
+#endif // FEATURE_LOADING_IMPROVED
+
 // NOTE: there is no such function in the original code
 int __cdecl GF_GetNumSecrets(DWORD levelID) {
 	__int16 result = 3;
@@ -171,6 +182,11 @@ BOOL __cdecl GF_DoFrontEndSequence() {
 
 int __cdecl GF_DoLevelSequence(DWORD levelID, GF_LEVEL_TYPE levelType) {
 	for( DWORD i = levelID; i < GF_GameFlow.num_Levels; ++i ) {
+#ifdef FEATURE_LOADING_IMPROVED
+		if( levelType != GFL_STORY && levelType != GFL_MIDSTORY ) {
+			GF_PrefetchLevel(i);
+		}
+#endif // FEATURE_LOADING_IMPROVED
 		int direction = GF_InterpretSequence(GF_ScriptTable[i], levelType, 0);
 
 		if( GF_GameFlow.singleLevel >= 0 ||
@@ -277,6 +293,11 @@ int __cdecl GF_InterpretSequence(__int16 *seq, GF_LEVEL_TYPE levelType, int seqT
 
 			case GFE_LEVCOMPLETE :
 				if( levelType != GFL_STORY && levelType != GFL_MIDSTORY ) {
+#ifdef FEATURE_LOADING_IMPROVED
+					if( GF_GameFlow.singleLevel < 0 ) {
+						GF_PrefetchLevel(CurrentLevel + 1);
+					}
+#endif // FEATURE_LOADING_IMPROVED
 					if( LevelStats(CurrentLevel) ) {
 						return GF_EXIT_TO_TITLE;
 					}
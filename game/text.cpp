@@ -25,6 +25,7 @@
 #include "game/health.h"
 #include "specific/frontend.h"
 #include "specific/output.h"
+#include "modding/profiler.h"
 #include "global/vars.h"
 
 #ifdef FEATURE_HUD_IMPROVED
@@ -96,6 +97,9 @@ void __cdecl T_InitPrint() {
 		TextInfoTable[i].flags = 0;
 
 	TextStringCount = 0;
+#ifdef FEATURE_PROFILER
+	ProfilerResetOverlay();
+#endif // FEATURE_PROFILER
 }
 
 TEXT_STR_INFO *__cdecl T_Print(int x, int y, __int16 z, const char *str) {
@@ -72,6 +72,9 @@ typedef struct {
 
 // Geometry values
 #define WALL_SHIFT			(10)
+#define WALL_L				(1<<WALL_SHIFT)
+#define NO_ROOM				(255)
+#define NO_HEIGHT			(-32512)
 
 // Angle values
 #define PHD_360				(PHD_ONE)
@@ -203,6 +206,17 @@ typedef struct {
 #define ROOM_UNDERWATER		(0x01)
 #define ROOM_OUTSIDE		(0x08)
 
+// Floor data types
+#define FT_FLOOR			(0)
+#define FT_DOOR				(1)
+#define FT_TILT				(2)
+#define FT_ROOF				(3)
+#define FT_TRIGGER			(4)
+#define FT_LAVA				(5)
+#define FT_CLIMB			(6)
+#define FD_TYPE_MASK		(0x1F)
+#define FD_END_BIT			(0x8000)
+
 // SFX flags
 #define SFX_UNDERWATER		(1)
 #define SFX_ALWAYS			(2)
@@ -1703,9 +1717,9 @@ typedef struct DoorInfos_t {
 typedef struct FloorInfo_t {
 	__int16 index;
 	__int16 box;
-	char pitRoom;
+	BYTE pitRoom;
 	char floor;
-	char skyRoom;
+	BYTE skyRoom;
 	char ceiling;
 } FLOOR_INFO;
 
@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global/precompiled.h"
+#include "modding/anim_cache.h"
+#include "game/draw.h"
+#include "modding/profiler.h"
+#include "specific/utils.h"
+#include "global/vars.h"
+
+#define ANIM_CACHE_HASH_MIN	(0x1000) // must be power of two
+#define ANIM_CACHE_BINDS	(4)
+
+// Decoded keyframe. The header is followed by its arrays:
+// __int16 rotations[bonesCount][9]; 3x3 blocks in W2V_SHIFT fixed point
+// UINT16 offsets[bonesCount + 1]; rotation data offset of each bone in words
+// BYTE bones[wordsCount]; bone of each rotation data word
+typedef struct AnimCacheEntry_t {
+	__int16 *frame;
+	UINT16 bonesCount;
+	UINT16 wordsCount;
+} ANIM_CACHE_ENTRY;
+
+typedef struct AnimCacheBind_t {
+	UINT16 *start; // the first rotation word of the frame
+	UINT16 *end;
+	ANIM_CACHE_ENTRY *entry;
+} ANIM_CACHE_BIND;
+
+DWORD AnimCacheSize = 8; // megabytes, zero disables the cache
+
+static BYTE *CacheData = NULL;
+static DWORD CacheDataSize = 0;
+static DWORD CacheDataUsed = 0;
+static DWORD *CacheHash = NULL; // entry offsets plus one, zero is an empty slot
+static DWORD CacheHashSize = 0;
+static DWORD CacheEntries = 0;
+static bool IsCacheFull = false;
+static bool IsCacheFilling = false;
+static double FillTime = 0.0;
+static DWORD FillBones = 0;
+static DWORD BoneTimeNs = 0; // average decoding time of one bone
+
+static ANIM_CACHE_BIND Binds[ANIM_CACHE_BINDS];
+static int BindsCount = 0;
+
+static inline __int16 *GetRotations(ANIM_CACHE_ENTRY *entry) {
+	return (__int16 *)(entry + 1);
+}
+
+static inline UINT16 *GetOffsets(ANIM_CACHE_ENTRY *entry) {
+	return (UINT16 *)(GetRotations(entry) + entry->bonesCount * 9);
+}
+
+static inline BYTE *GetBones(ANIM_CACHE_ENTRY *entry) {
+	return (BYTE *)(GetOffsets(entry) + entry->bonesCount + 1);
+}
+
+static inline DWORD GetEntrySize(int bonesCount, int wordsCount) {
+	DWORD size = sizeof(ANIM_CACHE_ENTRY) + sizeof(__int16) * 9 * bonesCount + sizeof(UINT16) * (bonesCount + 1) + wordsCount;
+	return (size + 7) & ~7;
+}
+
+static inline DWORD HashFrame(__int16 *frame) {
+	return ((DWORD)frame >> 1) * 0x9E3779B1;
+}
+
+static ANIM_CACHE_ENTRY *FindEntry(__int16 *frame) {
+	if( CacheHash == NULL ) {
+		return NULL;
+	}
+	DWORD mask = CacheHashSize - 1;
+	for( DWORD i = HashFrame(frame) & mask; CacheHash[i] != 0; i = (i + 1) & mask ) {
+		ANIM_CACHE_ENTRY *entry = (ANIM_CACHE_ENTRY *)(CacheData + CacheHash[i] - 1);
+		if( entry->frame == frame ) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+static bool InsertHash(DWORD offset) {
+	// the table is kept half empty, so the probes are short
+	if( (CacheEntries + 1) * 2 > CacheHashSize ) {
+		DWORD size = CacheHashSize ? CacheHashSize * 2 : ANIM_CACHE_HASH_MIN;
+		DWORD *hash = (DWORD *)calloc(size, sizeof(DWORD));
+		if( hash == NULL ) {
+			return false;
+		}
+		for( DWORD i = 0; i < CacheHashSize; ++i ) {
+			if( CacheHash[i] != 0 ) {
+				ANIM_CACHE_ENTRY *entry = (ANIM_CACHE_ENTRY *)(CacheData + CacheHash[i] - 1);
+				DWORD j = HashFrame(entry->frame) & (size - 1);
+				while( hash[j] != 0 ) j = (j + 1) & (size - 1);
+				hash[j] = CacheHash[i];
+			}
+		}
+		free(CacheHash);
+		CacheHash = hash;
+		CacheHashSize = size;
+	}
+	ANIM_CACHE_ENTRY *entry = (ANIM_CACHE_ENTRY *)(CacheData + offset);
+	DWORD mask = CacheHashSize - 1;
+	DWORD i = HashFrame(entry->frame) & mask;
+	while( CacheHash[i] != 0 ) i = (i + 1) & mask;
+	CacheHash[i] = offset + 1;
+	++CacheEntries;
+	return true;
+}
+
+static ANIM_CACHE_ENTRY *AddEntry(__int16 *frame, int bonesCount) {
+	if( IsCacheFull || bonesCount <= 0 || bonesCount > 0xFF ) {
+		return NULL;
+	}
+	// the arena is allocated once, so the bound entries never move
+	if( CacheData == NULL ) {
+		CacheDataSize = AnimCacheSize * 0x100000;
+		CacheData = (BYTE *)malloc(CacheDataSize);
+		if( CacheData == NULL ) {
+			IsCacheFull = true;
+			return NULL;
+		}
+	}
+
+	// the packed rotation takes two words, a single axis rotation takes one
+	UINT16 *rot = (UINT16 *)frame + 9;
+	int wordsCount = 0;
+	for( int i = 0; i < bonesCount; ++i ) {
+		wordsCount += ( (rot[wordsCount] >> 14) == 0 ) ? 2 : 1;
+	}
+	DWORD size = GetEntrySize(bonesCount, wordsCount);
+	if( CacheDataUsed + size > CacheDataSize ) {
+		IsCacheFull = true; // the rest of the level is decoded as usual
+		return NULL;
+	}
+
+	double startTime = UT_Microseconds();
+	ANIM_CACHE_ENTRY *entry = (ANIM_CACHE_ENTRY *)(CacheData + CacheDataUsed);
+	entry->frame = frame;
+	entry->bonesCount = bonesCount;
+	entry->wordsCount = wordsCount;
+	__int16 *rotations = GetRotations(entry);
+	UINT16 *offsets = GetOffsets(entry);
+	BYTE *bones = GetBones(entry);
+
+	// the same rotation code is applied to the unit matrix, so the block gives the same result
+	PHD_MATRIX unit, *saved = PhdMatrixPtr;
+	PhdMatrixPtr = &unit;
+	IsCacheFilling = true;
+	for( int i = 0; i < bonesCount; ++i ) {
+		memset(&unit, 0, sizeof(unit));
+		unit._00 = unit._11 = unit._22 = W2V_SCALE;
+		offsets[i] = rot - ((UINT16 *)frame + 9);
+		phd_RotYXZsuperpack(&rot, 0);
+		__int16 *block = &rotations[i * 9];
+		block[0] = unit._00; block[1] = unit._01; block[2] = unit._02;
+		block[3] = unit._10; block[4] = unit._11; block[5] = unit._12;
+		block[6] = unit._20; block[7] = unit._21; block[8] = unit._22;
+		for( int j = offsets[i]; j < rot - ((UINT16 *)frame + 9); ++j ) {
+			bones[j] = i;
+		}
+	}
+	offsets[bonesCount] = wordsCount;
+	IsCacheFilling = false;
+	PhdMatrixPtr = saved;
+
+	if( !InsertHash(CacheDataUsed) ) {
+		IsCacheFull = true;
+		return NULL;
+	}
+	CacheDataUsed += size;
+	FillTime += UT_Microseconds() - startTime;
+	FillBones += bonesCount;
+	BoneTimeNs = (DWORD)(FillTime / FillBones * 1000000000.0);
+	return entry;
+}
+
+static inline void ApplyRotation(const __int16 *r) {
+	PHD_MATRIX *m = PhdMatrixPtr;
+	int a, b, c;
+
+	// the unit matrix gives no rotation
+	if( r[0] == W2V_SCALE && r[4] == W2V_SCALE && r[8] == W2V_SCALE ) {
+		return;
+	}
+	a = m->_00; b = m->_01; c = m->_02;
+	m->_00 = (a * r[0] + b * r[3] + c * r[6]) >> W2V_SHIFT;
+	m->_01 = (a * r[1] + b * r[4] + c * r[7]) >> W2V_SHIFT;
+	m->_02 = (a * r[2] + b * r[5] + c * r[8]) >> W2V_SHIFT;
+	a = m->_10; b = m->_11; c = m->_12;
+	m->_10 = (a * r[0] + b * r[3] + c * r[6]) >> W2V_SHIFT;
+	m->_11 = (a * r[1] + b * r[4] + c * r[7]) >> W2V_SHIFT;
+	m->_12 = (a * r[2] + b * r[5] + c * r[8]) >> W2V_SHIFT;
+	a = m->_20; b = m->_21; c = m->_22;
+	m->_20 = (a * r[0] + b * r[3] + c * r[6]) >> W2V_SHIFT;
+	m->_21 = (a * r[1] + b * r[4] + c * r[7]) >> W2V_SHIFT;
+	m->_22 = (a * r[2] + b * r[5] + c * r[8]) >> W2V_SHIFT;
+}
+
+void AnimCacheBind(__int16 *frame, int bonesCount) {
+	if( AnimCacheSize == 0 || frame == NULL || BindsCount >= ANIM_CACHE_BINDS ) {
+		return;
+	}
+	ANIM_CACHE_ENTRY *entry = FindEntry(frame);
+	if( entry == NULL ) {
+		entry = AddEntry(frame, bonesCount);
+	}
+	// the same frame may be used by an object with more meshes, then it is decoded as usual
+	if( entry == NULL || entry->bonesCount < bonesCount ) {
+		return;
+	}
+	Binds[BindsCount].start = (UINT16 *)frame + 9;
+	Binds[BindsCount].end = Binds[BindsCount].start + entry->wordsCount;
+	Binds[BindsCount].entry = entry;
+	++BindsCount;
+}
+
+void AnimCacheUnbind() {
+	BindsCount = 0;
+}
+
+bool AnimCacheRotate(UINT16 **pptr, int index) {
+	UINT16 *ptr = *pptr;
+	if( IsCacheFilling ) {
+		return false;
+	}
+	for( int i = 0; i < BindsCount; ++i ) {
+		if( ptr < Binds[i].start || ptr >= Binds[i].end ) {
+			continue;
+		}
+		ANIM_CACHE_ENTRY *entry = Binds[i].entry;
+		int offset = ptr - Binds[i].start;
+		int bone = GetBones(entry)[offset];
+		// the pointer must be at the bone start, and the skipped bones must be in the frame
+		if( GetOffsets(entry)[bone] != offset || bone + index >= entry->bonesCount ) {
+			break;
+		}
+		bone += index;
+		ApplyRotation(&GetRotations(entry)[bone * 9]);
+		*pptr = Binds[i].start + GetOffsets(entry)[bone + 1];
+		PROFILE_COUNT(PROF_AnimCacheHits, 1);
+		PROFILE_COUNT(PROF_AnimCacheSavedNs, BoneTimeNs);
+		return true;
+	}
+	PROFILE_COUNT(PROF_AnimCacheMisses, 1);
+	return false;
+}
+
+void AnimCacheReset() {
+	// the frame pointers are valid for one level only
+	free(CacheData);
+	free(CacheHash);
+	CacheData = NULL;
+	CacheDataSize = 0;
+	CacheDataUsed = 0;
+	CacheHash = NULL;
+	CacheHashSize = 0;
+	CacheEntries = 0;
+	IsCacheFull = false;
+	BindsCount = 0;
+}
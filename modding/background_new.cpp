@@ -34,6 +34,7 @@
 #include "specific/winvid.h"
 #include "modding/file_utils.h"
 #include "modding/gdi_utils.h"
+#include "modding/pixel_convert.h"
 #include "global/vars.h"
 
 #ifdef FEATURE_BACKGROUND_IMPROVED
@@ -470,64 +471,6 @@ int __cdecl BGND2_FadeTo(int target, int delta) {
 	return current;
 }
 
-static void BGND2_CustomBlt(LPDDSDESC dst, DWORD dstX, DWORD dstY, LPDDSDESC src, LPRECT srcRect) {
-	DWORD srcBpp = src->ddpfPixelFormat.dwRGBBitCount/8;
-	DWORD dstBpp = dst->ddpfPixelFormat.dwRGBBitCount/8;
-	COLOR_BIT_MASKS srcMask, dstMask;
-
-	WinVidGetColorBitMasks(&srcMask, &src->ddpfPixelFormat);
-	WinVidGetColorBitMasks(&dstMask, &dst->ddpfPixelFormat);
-
-	DWORD srcX = srcRect->left;
-	DWORD srcY = srcRect->top;
-	DWORD width = srcRect->right - srcRect->left;
-	DWORD height = srcRect->bottom - srcRect->top;
-
-	BYTE *srcLine = (BYTE *)src->lpSurface + srcY * src->lPitch  + srcX * srcBpp;
-	BYTE *dstLine = (BYTE *)dst->lpSurface + dstY * dst->lPitch  + dstX * dstBpp;
-	for( DWORD j = 0; j < height; ++j ) {
-		BYTE *srcPtr = srcLine;
-		BYTE *dstPtr = dstLine;
-		for( DWORD i = 0; i < width; ++i ) {
-			DWORD color = 0;
-			memcpy(&color, srcPtr, srcBpp);
-			DWORD red   = ((color & srcMask.dwRBitMask) >> srcMask.dwRBitOffset);
-			DWORD green = ((color & srcMask.dwGBitMask) >> srcMask.dwGBitOffset);
-			DWORD blue  = ((color & srcMask.dwBBitMask) >> srcMask.dwBBitOffset);
-			if( srcMask.dwRBitDepth < dstMask.dwRBitDepth ) {
-				DWORD high = dstMask.dwRBitDepth - srcMask.dwRBitDepth;
-				DWORD low = (srcMask.dwRBitDepth > high) ? srcMask.dwRBitDepth - high : 0;
-				red = (red << high) | (red >> low);
-			} else if( srcMask.dwRBitDepth > dstMask.dwRBitDepth ) {
-				red >>= srcMask.dwRBitDepth - dstMask.dwRBitDepth;
-			}
-			if( srcMask.dwGBitDepth < dstMask.dwGBitDepth ) {
-				DWORD high = dstMask.dwGBitDepth - srcMask.dwGBitDepth;
-				DWORD low = (srcMask.dwGBitDepth > high) ? srcMask.dwGBitDepth - high : 0;
-				green = (green << high) | (green >> low);
-			} else if( srcMask.dwGBitDepth > dstMask.dwGBitDepth ) {
-				green >>= srcMask.dwGBitDepth - dstMask.dwGBitDepth;
-			}
-			if( srcMask.dwBBitDepth < dstMask.dwBBitDepth ) {
-				DWORD high = dstMask.dwBBitDepth - srcMask.dwBBitDepth;
-				DWORD low = (srcMask.dwBBitDepth > high) ? srcMask.dwBBitDepth - high : 0;
-				blue = (blue << high) | (blue >> low);
-			} else if( srcMask.dwBBitDepth > dstMask.dwBBitDepth ) {
-				blue >>= srcMask.dwBBitDepth - dstMask.dwBBitDepth;
-			}
-			color = dst->ddpfPixelFormat.dwRGBAlphaBitMask; // destination is opaque
-			color |= red   << dstMask.dwRBitOffset;
-			color |= green << dstMask.dwGBitOffset;
-			color |= blue  << dstMask.dwBBitOffset;
-			memcpy(dstPtr, &color, dstBpp);
-			srcPtr += srcBpp;
-			dstPtr += dstBpp;
-		}
-		srcLine += src->lPitch;
-		dstLine += dst->lPitch;
-	}
-}
-
 int __cdecl BGND2_CapturePicture() {
 	static bool isCustomBlt = false;
 	bool isSrcLock = false;
@@ -610,7 +553,7 @@ int __cdecl BGND2_CapturePicture() {
 					ret = -1;
 					goto CLEANUP;
 				}
-				BGND2_CustomBlt(&dstDesc, 0, 0, &srcDesc, &r);
+				PixelConvertRect(&dstDesc, 0, 0, &srcDesc, &r);
 				WinVidBufferUnlock(TexturePages[pageIndex].sysMemSurface, &dstDesc);
 			}
 			if( !LoadTexturePage(pageIndex, false) ) {
@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global/precompiled.h"
+#include "modding/cpu_utils.h"
+#include "global/vars.h"
+
+static int Sse2Support = -1;
+
+bool IsSse2Available() {
+	// the check is the same for every thread, so it is safe to do it twice
+	if( Sse2Support < 0 ) {
+		Sse2Support = IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE) ? 1 : 0;
+	}
+	return ( Sse2Support > 0 );
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CPU_UTILS_H_INCLUDED
+#define CPU_UTILS_H_INCLUDED
+
+#include "global/types.h"
+#include <emmintrin.h>
+
+// The game is built for plain i386, so SSE2 code is enabled per function and
+// the stack is realigned since the game and its threads may call us with 4 byte aligned stack.
+#define SIMD_SSE2 __attribute__((target("sse2"), force_align_arg_pointer))
+
+/*
+ * Function list
+ */
+bool IsSse2Available();
+
+#endif // CPU_UTILS_H_INCLUDED
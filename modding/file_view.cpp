@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global/precompiled.h"
+#include "modding/file_view.h"
+#include "global/vars.h"
+
+bool FileViewOpen(FILE_VIEW *view, LPCTSTR fileName) {
+	if( view == NULL || fileName == NULL ) {
+		return false;
+	}
+	memset(view, 0, sizeof(FILE_VIEW));
+
+	view->hFile = CreateFile(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN|FILE_ATTRIBUTE_NORMAL, NULL);
+	if( view->hFile == INVALID_HANDLE_VALUE ) {
+		view->hFile = NULL;
+		return false;
+	}
+
+	view->size = GetFileSize(view->hFile, NULL);
+	if( view->size == INVALID_FILE_SIZE || view->size == 0 ) {
+		goto FAIL;
+	}
+
+	view->hMapping = CreateFileMapping(view->hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if( view->hMapping == NULL ) {
+		goto FAIL;
+	}
+
+	view->data = (const BYTE *)MapViewOfFile(view->hMapping, FILE_MAP_READ, 0, 0, 0);
+	if( view->data == NULL ) {
+		goto FAIL;
+	}
+	return true;
+
+FAIL :
+	FileViewClose(view);
+	return false;
+}
+
+bool FileViewOpenMemory(FILE_VIEW *view, LPCVOID data, DWORD size) {
+	if( view == NULL || data == NULL || size == 0 ) {
+		return false;
+	}
+	memset(view, 0, sizeof(FILE_VIEW));
+	view->data = (const BYTE *)data;
+	view->size = size;
+	return true;
+}
+
+void FileViewClose(FILE_VIEW *view) {
+	if( view == NULL ) {
+		return;
+	}
+	// the memory block is owned by the caller, so unmap only our own mapping
+	if( view->hMapping != NULL ) {
+		if( view->data != NULL ) {
+			UnmapViewOfFile(view->data);
+		}
+		CloseHandle(view->hMapping);
+	}
+	if( view->hFile != NULL ) {
+		CloseHandle(view->hFile);
+	}
+	memset(view, 0, sizeof(FILE_VIEW));
+}
+
+LPCVOID FileViewPtr(FILE_VIEW *view, DWORD size) {
+	if( view == NULL || view->data == NULL || size > view->size - view->offset ) {
+		return NULL;
+	}
+	LPCVOID result = view->data + view->offset;
+	view->offset += size;
+	return result;
+}
+
+bool FileViewRead(FILE_VIEW *view, LPVOID buffer, DWORD size) {
+	LPCVOID src = FileViewPtr(view, size);
+	if( src == NULL ) {
+		return false;
+	}
+	if( size > 0 ) {
+		memcpy(buffer, src, size);
+	}
+	return true;
+}
+
+bool FileViewSkip(FILE_VIEW *view, DWORD size) {
+	return ( FileViewPtr(view, size) != NULL );
+}
+
+bool FileViewSeek(FILE_VIEW *view, DWORD offset) {
+	if( view == NULL || view->data == NULL || offset > view->size ) {
+		return false;
+	}
+	view->offset = offset;
+	return true;
+}
+
+DWORD FileViewTell(FILE_VIEW *view) {
+	return ( view != NULL ) ? view->offset : 0;
+}
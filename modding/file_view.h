@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FILE_VIEW_H_INCLUDED
+#define FILE_VIEW_H_INCLUDED
+
+#include "global/types.h"
+
+// File view is a read-only window to the whole file content with a read cursor.
+// It may be backed by a file mapping or by a caller provided memory block,
+// so the parsers don't care where the data came from.
+typedef struct FileView_t {
+	HANDLE hFile;
+	HANDLE hMapping;
+	const BYTE *data;
+	DWORD size;
+	DWORD offset;
+} FILE_VIEW;
+
+/*
+ * Function list
+ */
+bool FileViewOpen(FILE_VIEW *view, LPCTSTR fileName);
+bool FileViewOpenMemory(FILE_VIEW *view, LPCVOID data, DWORD size);
+void FileViewClose(FILE_VIEW *view);
+
+bool FileViewRead(FILE_VIEW *view, LPVOID buffer, DWORD size);
+LPCVOID FileViewPtr(FILE_VIEW *view, DWORD size);
+bool FileViewSkip(FILE_VIEW *view, DWORD size);
+bool FileViewSeek(FILE_VIEW *view, DWORD offset);
+DWORD FileViewTell(FILE_VIEW *view);
+
+#endif // FILE_VIEW_H_INCLUDED
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global/precompiled.h"
+#include "modding/floor_table.h"
+#include "game/control.h"
+#include "global/vars.h"
+
+typedef struct FloorTableRoom_t {
+	FLOOR_INFO *floor; // the sectors the doors are decoded from
+	DWORD sectorCount;
+	__int16 *doors;
+} FLOOR_TABLE_ROOM;
+
+static FLOOR_TABLE_ROOM *TableRooms = NULL;
+static __int16 *TableDoors = NULL;
+static int TableRoomCount = 0;
+
+bool FloorDoorTableEnabled = true;
+
+static FLOOR_TABLE_ROOM *GetTableRoom(__int16 roomID) {
+	if( roomID < 0 || roomID >= TableRoomCount ) {
+		return NULL;
+	}
+	FLOOR_TABLE_ROOM *room = &TableRooms[roomID];
+	FLOOR_INFO *floor = RoomInfo[roomID].floor;
+	if( room->floor == floor ) {
+		return room;
+	}
+	// the flip map swaps the room data in pairs, so the decoded sectors are swapped the same way
+	for( int i = 0; i < TableRoomCount; ++i ) {
+		if( TableRooms[i].floor == floor ) {
+			FLOOR_TABLE_ROOM swap = *room;
+			*room = TableRooms[i];
+			TableRooms[i] = swap;
+			return room;
+		}
+	}
+	return NULL;
+}
+
+void FloorTableBuild() {
+	DWORD sectorCount = 0;
+
+	FloorTableFree();
+	if( !FloorDoorTableEnabled || RoomInfo == NULL || RoomCount <= 0 ) {
+		return;
+	}
+	for( int i = 0; i < RoomCount; ++i ) {
+		sectorCount += RoomInfo[i].xSize * RoomInfo[i].ySize;
+	}
+	TableRooms = (FLOOR_TABLE_ROOM *)malloc(sizeof(FLOOR_TABLE_ROOM) * RoomCount);
+	TableDoors = (__int16 *)malloc(sizeof(__int16) * MAX(sectorCount, 1));
+	if( TableRooms == NULL || TableDoors == NULL ) {
+		FloorTableFree();
+		return;
+	}
+
+	__int16 *doors = TableDoors;
+	for( int i = 0; i < RoomCount; ++i ) {
+		ROOM_INFO *room = &RoomInfo[i];
+		TableRooms[i].floor = room->floor;
+		TableRooms[i].sectorCount = room->xSize * room->ySize;
+		TableRooms[i].doors = doors;
+		for( DWORD j = 0; j < TableRooms[i].sectorCount; ++j ) {
+			*(doors++) = GetDoor(&room->floor[j]);
+		}
+	}
+	TableRoomCount = RoomCount;
+}
+
+void FloorTableFree() {
+	free(TableRooms);
+	free(TableDoors);
+	TableRooms = NULL;
+	TableDoors = NULL;
+	TableRoomCount = 0;
+}
+
+__int16 FloorTableGetDoor(__int16 roomID, FLOOR_INFO *floor) {
+	FLOOR_TABLE_ROOM *room = GetTableRoom(roomID);
+	if( room != NULL ) {
+		DWORD index = floor - room->floor;
+		if( index < room->sectorCount ) {
+			return room->doors[index];
+		}
+	}
+	return GetDoor(floor);
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLOOR_TABLE_H_INCLUDED
+#define FLOOR_TABLE_H_INCLUDED
+
+#include "global/types.h"
+
+// Floor table keeps the door room of every sector decoded from the floor data
+// once per level, so the floor queries do not walk the opcode stream. The rooms
+// swapped by the flip map are rebound to their decoded sectors on the next query.
+
+/*
+ * Function list
+ */
+void FloorTableBuild();
+void FloorTableFree();
+__int16 FloorTableGetDoor(__int16 roomID, FLOOR_INFO *floor);
+
+#endif // FLOOR_TABLE_H_INCLUDED
@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global/precompiled.h"
+#include "modding/frame_interp.h"
+#include "3dsystem/3d_gen.h"
+#include "global/vars.h"
+
+// Items that moved farther than this within one tick are teleported, so they are not interpolated
+#define INTERP_MAX_DISTANCE	(2 << WALL_SHIFT)
+
+typedef struct InterpItem_t {
+	PHD_3DPOS pos;
+	__int16 objectID;
+	__int16 roomNumber;
+	bool isApplied;
+} INTERP_ITEM;
+
+typedef struct InterpFx_t {
+	PHD_3DPOS pos;
+	__int16 objectID;
+	__int16 roomNumber;
+	bool isActive;
+	bool isApplied;
+} INTERP_FX;
+
+typedef struct InterpView_t {
+	int xsrc, ysrc, zsrc;
+	int xtar, ytar, ztar;
+	__int16 roll;
+	__int16 roomNumber;
+	bool isValid;
+} INTERP_VIEW;
+
+// The state of the last two control ticks. The render draws the state
+// between them, so it is one tick behind the game logic at most.
+static INTERP_ITEM *PrevItems = NULL;
+static INTERP_ITEM *CurrItems = NULL;
+static int InterpItemCount = 0;
+static int InterpItemCapacity = 0;
+static bool IsPrevItemsValid = false;
+
+// Effects are indexed by their slot. Only the slots in the room lists are active.
+static INTERP_FX *PrevFx = NULL;
+static INTERP_FX *CurrFx = NULL;
+static int InterpFxCount = 0;
+static bool IsPrevFxValid = false;
+static bool IsCurrFxValid = false;
+
+static INTERP_VIEW LastView; // the latest phd_LookAt() call of the game
+static INTERP_VIEW PrevView;
+static INTERP_VIEW CurrView;
+static bool IsViewApplied = false;
+static bool IsViewOverridden = false; // phd_LookAt() is called by the interpolation itself
+
+static int LerpInt(int prev, int curr, double alpha) {
+	return prev + (int)((double)(curr - prev) * alpha);
+}
+
+static __int16 LerpAngle(__int16 prev, __int16 curr, double alpha) {
+	// the shortest way around the circle
+	return prev + (__int16)((double)(__int16)(curr - prev) * alpha);
+}
+
+static bool IsTeleported(PHD_3DPOS *prev, PHD_3DPOS *curr) {
+	return ( ABS(curr->x - prev->x) > INTERP_MAX_DISTANCE ||
+			 ABS(curr->y - prev->y) > INTERP_MAX_DISTANCE ||
+			 ABS(curr->z - prev->z) > INTERP_MAX_DISTANCE );
+}
+
+static void SetLookAt(INTERP_VIEW *view) {
+	IsViewOverridden = true;
+	phd_LookAt(view->xsrc, view->ysrc, view->zsrc, view->xtar, view->ytar, view->ztar, view->roll);
+	IsViewOverridden = false;
+}
+
+static void RecordEffects() {
+	int maxID = -1;
+	for( int i = 0; i < RoomCount; ++i ) {
+		for( int fxID = RoomInfo[i].fxNumber; fxID >= 0; fxID = Effects[fxID].next_fx ) {
+			CLAMPL(maxID, fxID);
+		}
+	}
+	if( maxID >= InterpFxCount ) {
+		if( PrevFx != NULL ) delete[] PrevFx;
+		if( CurrFx != NULL ) delete[] CurrFx;
+		InterpFxCount = maxID + 1;
+		PrevFx = new INTERP_FX[InterpFxCount];
+		CurrFx = new INTERP_FX[InterpFxCount];
+		if( PrevFx == NULL || CurrFx == NULL ) {
+			if( PrevFx != NULL ) delete[] PrevFx;
+			if( CurrFx != NULL ) delete[] CurrFx;
+			PrevFx = CurrFx = NULL;
+			InterpFxCount = 0;
+			IsPrevFxValid = IsCurrFxValid = false;
+			return;
+		}
+		IsCurrFxValid = false;
+	}
+
+	INTERP_FX *swap = PrevFx;
+	PrevFx = CurrFx;
+	CurrFx = swap;
+	IsPrevFxValid = IsCurrFxValid;
+	IsCurrFxValid = true;
+	memset(CurrFx, 0, sizeof(INTERP_FX) * InterpFxCount);
+	for( int i = 0; i < RoomCount; ++i ) {
+		for( int fxID = RoomInfo[i].fxNumber; fxID >= 0; fxID = Effects[fxID].next_fx ) {
+			CurrFx[fxID].pos = Effects[fxID].pos;
+			CurrFx[fxID].objectID = Effects[fxID].object_number;
+			CurrFx[fxID].roomNumber = Effects[fxID].room_number;
+			CurrFx[fxID].isActive = true;
+		}
+	}
+}
+
+void FrameInterpReset() {
+	IsPrevItemsValid = false;
+	InterpItemCount = 0;
+	IsPrevFxValid = false;
+	IsCurrFxValid = false;
+	PrevView.isValid = false;
+	CurrView.isValid = false;
+	LastView.isValid = false;
+}
+
+// Must be called after every control phase
+void FrameInterpRecordTick() {
+	if( LevelItemCount > InterpItemCapacity ) {
+		if( PrevItems != NULL ) delete[] PrevItems;
+		if( CurrItems != NULL ) delete[] CurrItems;
+		PrevItems = new INTERP_ITEM[LevelItemCount];
+		CurrItems = new INTERP_ITEM[LevelItemCount];
+		if( PrevItems == NULL || CurrItems == NULL ) {
+			if( PrevItems != NULL ) delete[] PrevItems;
+			if( CurrItems != NULL ) delete[] CurrItems;
+			PrevItems = CurrItems = NULL;
+			InterpItemCapacity = 0;
+			FrameInterpReset();
+			return;
+		}
+		InterpItemCapacity = LevelItemCount;
+		InterpItemCount = 0;
+	}
+
+	INTERP_ITEM *swap = PrevItems;
+	PrevItems = CurrItems;
+	CurrItems = swap;
+	IsPrevItemsValid = ( InterpItemCount == LevelItemCount );
+	InterpItemCount = LevelItemCount;
+	for( int i = 0; i < InterpItemCount; ++i ) {
+		CurrItems[i].pos = Items[i].pos;
+		CurrItems[i].objectID = Items[i].objectID;
+		CurrItems[i].roomNumber = Items[i].roomNumber;
+		CurrItems[i].isApplied = false;
+	}
+
+	RecordEffects();
+
+	PrevView = CurrView;
+	CurrView = LastView;
+	CurrView.roomNumber = Camera.pos.roomNumber;
+}
+
+void FrameInterpSetLookAt(int xsrc, int ysrc, int zsrc, int xtar, int ytar, int ztar, __int16 roll) {
+	if( IsViewOverridden ) {
+		return;
+	}
+	LastView.xsrc = xsrc;
+	LastView.ysrc = ysrc;
+	LastView.zsrc = zsrc;
+	LastView.xtar = xtar;
+	LastView.ytar = ytar;
+	LastView.ztar = ztar;
+	LastView.roll = roll;
+	LastView.isValid = true;
+}
+
+// Moves items, effects and camera to the point between the last two ticks.
+// The exact state must be restored by FrameInterpRestore() after drawing.
+bool FrameInterpApply(double alpha) {
+	bool result = false;
+
+	if( alpha >= 1.0 ) {
+		return false;
+	}
+	CLAMPL(alpha, 0.0);
+
+	if( IsPrevItemsValid ) {
+		for( int i = 0; i < InterpItemCount; ++i ) {
+			INTERP_ITEM *prev = &PrevItems[i];
+			INTERP_ITEM *curr = &CurrItems[i];
+			// the slot may be reused by another item, and the room must be the same for drawing
+			if( prev->objectID != curr->objectID || prev->roomNumber != curr->roomNumber ||
+				IsTeleported(&prev->pos, &curr->pos) )
+			{
+				continue;
+			}
+			PHD_3DPOS *pos = &Items[i].pos;
+			pos->x = LerpInt(prev->pos.x, curr->pos.x, alpha);
+			pos->y = LerpInt(prev->pos.y, curr->pos.y, alpha);
+			pos->z = LerpInt(prev->pos.z, curr->pos.z, alpha);
+			pos->rotX = LerpAngle(prev->pos.rotX, curr->pos.rotX, alpha);
+			pos->rotY = LerpAngle(prev->pos.rotY, curr->pos.rotY, alpha);
+			pos->rotZ = LerpAngle(prev->pos.rotZ, curr->pos.rotZ, alpha);
+			curr->isApplied = true;
+			result = true;
+		}
+	}
+
+	// the sprite flags of some effects are stored in their rotation, so only the position is interpolated
+	if( IsPrevFxValid ) {
+		for( int i = 0; i < InterpFxCount; ++i ) {
+			INTERP_FX *prev = &PrevFx[i];
+			INTERP_FX *curr = &CurrFx[i];
+			if( !prev->isActive || !curr->isActive ||
+				prev->objectID != curr->objectID || prev->roomNumber != curr->roomNumber ||
+				IsTeleported(&prev->pos, &curr->pos) )
+			{
+				continue;
+			}
+			PHD_3DPOS *pos = &Effects[i].pos;
+			pos->x = LerpInt(prev->pos.x, curr->pos.x, alpha);
+			pos->y = LerpInt(prev->pos.y, curr->pos.y, alpha);
+			pos->z = LerpInt(prev->pos.z, curr->pos.z, alpha);
+			curr->isApplied = true;
+			result = true;
+		}
+	}
+
+	// the rooms are drawn from the current camera room, so the camera must stay there
+	if( PrevView.isValid && CurrView.isValid && PrevView.roomNumber == CurrView.roomNumber ) {
+		INTERP_VIEW view;
+		view.xsrc = LerpInt(PrevView.xsrc, CurrView.xsrc, alpha);
+		view.ysrc = LerpInt(PrevView.ysrc, CurrView.ysrc, alpha);
+		view.zsrc = LerpInt(PrevView.zsrc, CurrView.zsrc, alpha);
+		view.xtar = LerpInt(PrevView.xtar, CurrView.xtar, alpha);
+		view.ytar = LerpInt(PrevView.ytar, CurrView.ytar, alpha);
+		view.ztar = LerpInt(PrevView.ztar, CurrView.ztar, alpha);
+		view.roll = LerpAngle(PrevView.roll, CurrView.roll, alpha);
+		SetLookAt(&view);
+		IsViewApplied = true;
+		result = true;
+	}
+	return result;
+}
+
+void FrameInterpRestore() {
+	for( int i = 0; i < InterpItemCount; ++i ) {
+		if( CurrItems[i].isApplied ) {
+			Items[i].pos = CurrItems[i].pos;
+			CurrItems[i].isApplied = false;
+		}
+	}
+	for( int i = 0; i < InterpFxCount; ++i ) {
+		if( CurrFx[i].isApplied ) {
+			Effects[i].pos = CurrFx[i].pos;
+			CurrFx[i].isApplied = false;
+		}
+	}
+	if( IsViewApplied ) {
+		SetLookAt(&CurrView);
+		IsViewApplied = false;
+	}
+}
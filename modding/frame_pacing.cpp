@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global/precompiled.h"
+#include "modding/frame_pacing.h"
+#include "modding/file_utils.h"
+#include "specific/utils.h"
+#include "global/vars.h"
+#include <math.h>
+
+#define PACING_SPIN_TIME	(0.002) // the coarse wait returns this time before the tick, the rest is spinning
+#define PACING_LATE_TIME	(0.001) // the tick is late if the wait returns later than this
+#define PACING_HISTO_BINS	(64) // the frame time histogram has 1 ms bins
+#define PACING_REPORT_PATH	".\\profiles"
+
+DWORD FramePacingMode = PACE_Sleep;
+
+static bool IsTimerPeriodSet = false;
+static HANDLE hWaitTimer = NULL;
+static double VBlankInterval = 1.0 / 60.0; // measured for the vsync mode
+static double LastVBlankTime = 0.0;
+
+// Frame times are measured between the S_DumpScreen() calls
+static DWORD FrameHisto[PACING_HISTO_BINS];
+static DWORD FrameCount = 0;
+static DWORD FrameMissed = 0;
+static double FrameTimeSum = 0.0;
+static double FrameTimeSqrSum = 0.0;
+static double FrameTimeMax = 0.0;
+static double LastFrameTime = 0.0;
+
+// Tick waits are measured against the tick deadline
+static DWORD WaitCount = 0;
+static DWORD WaitLate = 0;
+static double WaitLateSum = 0.0;
+static double WaitLateMax = 0.0;
+static double WaitTimeSum = 0.0;
+static double IdleTimeSum = 0.0; // the part of the wait time when the thread did not spin
+
+static double GetCurrentTicks() {
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart / TIME_Frequency;
+}
+
+static bool WaitVBlank(double remain) {
+	if( DDraw == NULL || remain < VBlankInterval ) {
+		return false;
+	}
+	if FAILED(DDraw->WaitForVerticalBlank(DDWAITVB_BLOCKBEGIN, NULL)) {
+		return false;
+	}
+	double now = UT_Microseconds();
+	double interval = now - LastVBlankTime;
+	if( interval > 0.002 && interval < 0.05 ) { // 20..500 Hz
+		VBlankInterval = VBlankInterval * 0.9 + interval * 0.1;
+	}
+	LastVBlankTime = now;
+	return true;
+}
+
+static bool WaitTimer(double remain) {
+	LARGE_INTEGER dueTime;
+
+	if( hWaitTimer == NULL ) {
+		hWaitTimer = CreateWaitableTimer(NULL, TRUE, NULL);
+		if( hWaitTimer == NULL ) return false;
+	}
+	dueTime.QuadPart = -(LONGLONG)(remain * 10000000.0); // relative time in 100 ns units
+	if( !SetWaitableTimer(hWaitTimer, &dueTime, 0, NULL, NULL, FALSE) ) {
+		return false;
+	}
+	return ( WaitForSingleObject(hWaitTimer, INFINITE) == WAIT_OBJECT_0 );
+}
+
+static void CoarseWait(double remain) {
+	switch( FramePacingMode ) {
+		case PACE_Timer :
+			if( WaitTimer(remain) ) return;
+			break;
+		case PACE_VSync :
+			if( WaitVBlank(remain) ) return;
+			break;
+		default :
+			break;
+	}
+	Sleep(1);
+}
+
+// Waits for the next tick like the original `while( !Sync() );` loop does
+// and returns the Sync() result, but it does not spin the whole time
+DWORD PacingWaitTick() {
+	DWORD ticks;
+	double deadline = floor(TIME_Ticks) + 1.0;
+	double startTime = UT_Microseconds();
+	double idleTime = 0.0;
+
+	if( FramePacingMode != PACE_Spin ) {
+		if( !IsTimerPeriodSet ) {
+			// the default Windows timer period is too coarse for Sleep(1)
+			timeBeginPeriod(1);
+			IsTimerPeriodSet = true;
+		}
+		for( ;; ) {
+			double remain = (deadline - GetCurrentTicks()) / (double)TICKS_PER_SECOND;
+			if( remain <= PACING_SPIN_TIME ) break;
+			double idleStart = UT_Microseconds();
+			CoarseWait(remain - PACING_SPIN_TIME);
+			idleTime += UT_Microseconds() - idleStart;
+		}
+	}
+	while( 0 == (ticks = Sync()) ) /* spin the rest of the tick */;
+
+	double late = (TIME_Ticks - deadline) / (double)TICKS_PER_SECOND;
+	++WaitCount;
+	if( late > PACING_LATE_TIME ) {
+		++WaitLate;
+	}
+	WaitLateSum += late;
+	CLAMPL(WaitLateMax, late);
+	WaitTimeSum += UT_Microseconds() - startTime;
+	IdleTimeSum += idleTime;
+	return ticks;
+}
+
+void PacingFrameDone(DWORD ticks) {
+	double now = UT_Microseconds();
+	if( LastFrameTime > 0.0 ) {
+		double frameTime = now - LastFrameTime;
+		int bin = (int)(frameTime * 1000.0);
+		CLAMP(bin, 0, PACING_HISTO_BINS - 1);
+		++FrameHisto[bin];
+		++FrameCount;
+		FrameTimeSum += frameTime;
+		FrameTimeSqrSum += frameTime * frameTime;
+		CLAMPL(FrameTimeMax, frameTime);
+		if( ticks > TICKS_PER_FRAME ) {
+			++FrameMissed; // the frame took longer than one game frame
+		}
+	}
+	LastFrameTime = now;
+}
+
+bool PacingDumpReport() {
+	static LPCTSTR modeNames[] = {"spin", "sleep", "waitable timer", "vsync"};
+	static SYSTEMTIME lastTime = {0, 0, 0, 0, 0, 0, 0, 0};
+	static int lastIndex = 0;
+	char fileName[MAX_PATH];
+
+	CreateDateTimeFilename(fileName, sizeof(fileName), PACING_REPORT_PATH, ".txt", &lastTime, &lastIndex);
+	CreateDirectories(fileName, true);
+	FILE *fp = fopen(fileName, "wt");
+	if( fp == NULL ) {
+		return false;
+	}
+
+	double avg = FrameCount ? FrameTimeSum / FrameCount : 0.0;
+	double jitter = FrameCount ? sqrt(MAX(0.0, FrameTimeSqrSum / FrameCount - avg * avg)) : 0.0;
+	fprintf(fp, "Frame pacing: %s\n", modeNames[MIN(FramePacingMode, ARRAY_SIZE(modeNames) - 1)]);
+	fprintf(fp, "Frames %d, avg %.3f ms, jitter %.3f ms, max %.3f ms, missed %d\n",
+			FrameCount, avg * 1000.0, jitter * 1000.0, FrameTimeMax * 1000.0, FrameMissed);
+	fprintf(fp, "Tick waits %d, late %d, avg lateness %.3f ms, max lateness %.3f ms, idle %.1f%%\n",
+			WaitCount, WaitLate, WaitCount ? WaitLateSum * 1000.0 / WaitCount : 0.0, WaitLateMax * 1000.0,
+			WaitTimeSum > 0.0 ? IdleTimeSum * 100.0 / WaitTimeSum : 0.0);
+	fprintf(fp, "Frame time histogram:\n");
+	for( int i = 0; i < PACING_HISTO_BINS; ++i ) {
+		if( FrameHisto[i] != 0 ) {
+			fprintf(fp, "%2d%s ms: %d\n", i, (i == PACING_HISTO_BINS - 1) ? "+" : " ", FrameHisto[i]);
+		}
+	}
+	fclose(fp);
+	return true;
+}
+
+void PacingShutdown() {
+	if( IsTimerPeriodSet ) {
+		timeEndPeriod(1);
+		IsTimerPeriodSet = false;
+	}
+	if( hWaitTimer != NULL ) {
+		CloseHandle(hWaitTimer);
+		hWaitTimer = NULL;
+	}
+}
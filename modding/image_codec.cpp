@@ -0,0 +1,613 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "modding/image_codec.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define PCX_HEADER_SIZE		(128)
+#define TGA_HEADER_SIZE		(18)
+#define DEFLATE_WINDOW		(32768)
+#define DEFLATE_HASH_BITS	(15)
+#define DEFLATE_MIN_MATCH	(3)
+#define DEFLATE_MAX_MATCH	(258)
+#define DEFLATE_MAX_CHAIN	(8) // matches checked per position
+
+typedef struct BitWriter_t {
+	uint8_t *ptr;
+	uint64_t bits;
+	int count;
+} BIT_WRITER;
+
+static const uint16_t LengthBase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+static const uint8_t LengthExtra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+static const uint16_t DistBase[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577,
+};
+static const uint8_t DistExtra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+};
+
+// the tables are built once, and they are the same for all threads
+static uint32_t CrcTable[256];
+static uint16_t FixedCodes[288]; // bit reversed fixed Huffman codes
+static uint8_t FixedLengths[288];
+static uint8_t DistCodes[30]; // bit reversed fixed distance codes
+static uint8_t LengthCodes[DEFLATE_MAX_MATCH + 1]; // match length to length code index
+static volatile bool AreTablesReady = false;
+
+static uint32_t ReverseBits(uint32_t code, int length) {
+	uint32_t result = 0;
+	for( int i = 0; i < length; ++i ) {
+		result = (result << 1) | (code & 1);
+		code >>= 1;
+	}
+	return result;
+}
+
+static void InitTables() {
+	if( AreTablesReady ) {
+		return;
+	}
+	for( uint32_t i = 0; i < 256; ++i ) {
+		uint32_t crc = i;
+		for( int j = 0; j < 8; ++j ) {
+			crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : (crc >> 1);
+		}
+		CrcTable[i] = crc;
+	}
+	for( int i = 0; i < 288; ++i ) {
+		uint32_t code;
+		int length;
+		if( i < 144 ) {
+			code = 0x30 + i;
+			length = 8;
+		} else if( i < 256 ) {
+			code = 0x190 + i - 144;
+			length = 9;
+		} else if( i < 280 ) {
+			code = i - 256;
+			length = 7;
+		} else {
+			code = 0xC0 + i - 280;
+			length = 8;
+		}
+		FixedCodes[i] = ReverseBits(code, length);
+		FixedLengths[i] = length;
+	}
+	for( int i = 0; i < 30; ++i ) {
+		DistCodes[i] = ReverseBits(i, 5);
+	}
+	for( int i = 0; i < 29; ++i ) {
+		for( int j = LengthBase[i]; j < LengthBase[i] + (1 << LengthExtra[i]) && j <= DEFLATE_MAX_MATCH; ++j ) {
+			LengthCodes[j] = i;
+		}
+	}
+	LengthCodes[DEFLATE_MAX_MATCH] = 28; // 258 has its own code
+	// the tables are the same for each build, so a concurrent build is harmless
+	AreTablesReady = true;
+}
+
+bool ImageBufferReserve(IMAGE_BUFFER *buffer, size_t size) {
+	if( buffer->size + size <= buffer->capacity ) {
+		return true;
+	}
+	size_t capacity = buffer->capacity ? buffer->capacity : 0x10000;
+	while( capacity < buffer->size + size ) {
+		capacity *= 2;
+	}
+	uint8_t *data = (uint8_t *)realloc(buffer->data, capacity);
+	if( data == NULL ) {
+		return false;
+	}
+	buffer->data = data;
+	buffer->capacity = capacity;
+	return true;
+}
+
+void ImageBufferFree(IMAGE_BUFFER *buffer) {
+	free(buffer->data);
+	memset(buffer, 0, sizeof(IMAGE_BUFFER));
+}
+
+static bool PutData(IMAGE_BUFFER *out, const void *data, size_t size) {
+	if( !ImageBufferReserve(out, size) ) {
+		return false;
+	}
+	memcpy(out->data + out->size, data, size);
+	out->size += size;
+	return true;
+}
+
+static void PutWord(uint8_t *ptr, uint16_t value) {
+	ptr[0] = value & 0xFF;
+	ptr[1] = value >> 8;
+}
+
+static void PutDwordBE(uint8_t *ptr, uint32_t value) {
+	ptr[0] = value >> 24;
+	ptr[1] = value >> 16;
+	ptr[2] = value >> 8;
+	ptr[3] = value;
+}
+
+static int MaskShift(uint32_t mask) {
+	int shift = 0;
+	if( mask == 0 ) return 0;
+	while( !(mask & 1) ) {
+		mask >>= 1;
+		++shift;
+	}
+	return shift;
+}
+
+static uint8_t MaskChannel(uint32_t pixel, uint32_t mask, int shift, uint32_t maxValue) {
+	return ( maxValue == 0 ) ? 0 : ((pixel & mask) >> shift) * 255 / maxValue;
+}
+
+bool ImageFrameToRGB(const IMAGE_FRAME *frame, uint8_t *rgb) {
+	if( frame == NULL || frame->pixels == NULL || rgb == NULL ) {
+		return false;
+	}
+	if( frame->bpp == 8 ) {
+		if( frame->palette == NULL ) return false;
+		for( int y = 0; y < frame->height; ++y ) {
+			const uint8_t *src = frame->pixels + y * frame->pitch;
+			for( int x = 0; x < frame->width; ++x ) {
+				memcpy(rgb, &frame->palette[src[x] * 3], 3);
+				rgb += 3;
+			}
+		}
+		return true;
+	}
+	if( frame->bpp != 16 && frame->bpp != 24 && frame->bpp != 32 ) {
+		return false;
+	}
+
+	int bytes = frame->bpp / 8;
+	int rShift = MaskShift(frame->rMask);
+	int gShift = MaskShift(frame->gMask);
+	int bShift = MaskShift(frame->bMask);
+	uint32_t rMax = frame->rMask >> rShift;
+	uint32_t gMax = frame->gMask >> gShift;
+	uint32_t bMax = frame->bMask >> bShift;
+	bool is888 = ( rMax == 0xFF && gMax == 0xFF && bMax == 0xFF );
+
+	for( int y = 0; y < frame->height; ++y ) {
+		const uint8_t *src = frame->pixels + y * frame->pitch;
+		if( is888 ) {
+			// 8 bit channels, no scaling
+			for( int x = 0; x < frame->width; ++x, src += bytes ) {
+				uint32_t pixel = src[0] | (src[1] << 8) | (src[2] << 16);
+				*(rgb++) = pixel >> rShift;
+				*(rgb++) = pixel >> gShift;
+				*(rgb++) = pixel >> bShift;
+			}
+			continue;
+		}
+		for( int x = 0; x < frame->width; ++x, src += bytes ) {
+			uint32_t pixel = src[0] | (src[1] << 8) | (( bytes > 2 ) ? src[2] << 16 : 0);
+			*(rgb++) = MaskChannel(pixel, frame->rMask, rShift, rMax);
+			*(rgb++) = MaskChannel(pixel, frame->gMask, gShift, gMax);
+			*(rgb++) = MaskChannel(pixel, frame->bMask, bShift, bMax);
+		}
+	}
+	return true;
+}
+
+size_t ImageEncodeLinePCX(const uint8_t *src, int width, uint8_t *dst) {
+	uint8_t *ptr = dst;
+
+	// up to 63 equal bytes go as a run, a single byte
+	// goes as is, if its two high bits are not set
+	for( int i = 0; i < width; ) {
+		uint8_t value = src[i];
+		int run = 1;
+		while( i + run < width && src[i + run] == value && run < 63 ) {
+			++run;
+		}
+		if( run == 1 && (value & 0xC0) != 0xC0 ) {
+			*(ptr++) = value;
+		} else {
+			*(ptr++) = 0xC0 | run;
+			*(ptr++) = value;
+		}
+		i += run;
+	}
+	return ptr - dst;
+}
+
+size_t ImageBoundPCX(int width, int height) {
+	return PCX_HEADER_SIZE + width * 2 * height + 1 + 256 * 3;
+}
+
+size_t ImageWritePCX(const IMAGE_FRAME *frame, uint8_t *dst) {
+	uint8_t *ptr = dst;
+
+	memset(ptr, 0, PCX_HEADER_SIZE);
+	ptr[0] = 10; // manufacturer
+	ptr[1] = 5; // version
+	ptr[2] = 1; // RLE
+	ptr[3] = 8; // bpp
+	PutWord(&ptr[8], frame->width - 1);
+	PutWord(&ptr[10], frame->height - 1);
+	PutWord(&ptr[12], frame->width);
+	PutWord(&ptr[14], frame->height);
+	ptr[65] = 1; // planes
+	PutWord(&ptr[66], frame->width);
+	ptr += PCX_HEADER_SIZE;
+
+	for( int y = 0; y < frame->height; ++y ) {
+		ptr += ImageEncodeLinePCX(frame->pixels + y * frame->pitch, frame->width, ptr);
+	}
+	*(ptr++) = 0x0C;
+	memcpy(ptr, frame->palette, 256 * 3);
+	ptr += 256 * 3;
+	return ptr - dst;
+}
+
+bool ImageEncodePCX(const IMAGE_FRAME *frame, IMAGE_BUFFER *out) {
+	if( frame == NULL || frame->bpp != 8 || frame->palette == NULL ) {
+		return false;
+	}
+	if( !ImageBufferReserve(out, ImageBoundPCX(frame->width, frame->height)) ) {
+		return false;
+	}
+	out->size += ImageWritePCX(frame, out->data + out->size);
+	return true;
+}
+
+bool ImageEncodeTGA(const uint8_t *rgb, int width, int height, IMAGE_BUFFER *out) {
+	if( !ImageBufferReserve(out, TGA_HEADER_SIZE + width * height * 3) ) {
+		return false;
+	}
+
+	uint8_t *header = out->data + out->size;
+	memset(header, 0, TGA_HEADER_SIZE);
+	header[2] = 2; // uncompressed RGB
+	PutWord(&header[12], width);
+	PutWord(&header[14], height);
+	header[16] = 24;
+	out->size += TGA_HEADER_SIZE;
+
+	// TGA lines go from the bottom, and the channels are in BGR order
+	for( int y = height - 1; y >= 0; --y ) {
+		const uint8_t *src = rgb + y * width * 3;
+		uint8_t *dst = out->data + out->size;
+		for( int x = 0; x < width; ++x, src += 3, dst += 3 ) {
+			dst[0] = src[2];
+			dst[1] = src[1];
+			dst[2] = src[0];
+		}
+		out->size += width * 3;
+	}
+	return true;
+}
+
+static uint32_t UpdateCrc(uint32_t crc, const uint8_t *data, size_t size) {
+	for( size_t i = 0; i < size; ++i ) {
+		crc = CrcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+static uint32_t UpdateAdler(uint32_t adler, const uint8_t *data, size_t size) {
+	uint32_t a = adler & 0xFFFF;
+	uint32_t b = adler >> 16;
+	while( size > 0 ) {
+		// 5552 is the biggest block which does not overflow before the modulo
+		size_t block = ( size < 5552 ) ? size : 5552;
+		size -= block;
+		while( block-- ) {
+			a += *(data++);
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	return (b << 16) | a;
+}
+
+// the output space is reserved beforehand, so there are no checks here
+static inline void PutBits(BIT_WRITER *writer, uint32_t bits, int count) {
+	writer->bits |= (uint64_t)bits << writer->count;
+	writer->count += count;
+	if( writer->count >= 32 ) {
+		writer->ptr[0] = writer->bits;
+		writer->ptr[1] = writer->bits >> 8;
+		writer->ptr[2] = writer->bits >> 16;
+		writer->ptr[3] = writer->bits >> 24;
+		writer->ptr += 4;
+		writer->bits >>= 32;
+		writer->count -= 32;
+	}
+}
+
+static void FlushBits(BIT_WRITER *writer) {
+	while( writer->count > 0 ) {
+		*(writer->ptr++) = writer->bits;
+		writer->bits >>= 8;
+		writer->count -= 8;
+	}
+	writer->bits = 0;
+	writer->count = 0;
+}
+
+static inline uint32_t Hash3(const uint8_t *ptr) {
+	uint32_t value = ptr[0] | (ptr[1] << 8) | (ptr[2] << 16);
+	return (value * 2654435761U) >> (32 - DEFLATE_HASH_BITS);
+}
+
+// Single fixed Huffman block with a short hash chain LZ77.
+// It is several times faster than zlib's default level, while
+// the rendered frames are compressed almost as well.
+static bool Deflate(const uint8_t *data, size_t size, IMAGE_BUFFER *out) {
+	BIT_WRITER writer = {NULL, 0, 0};
+	int32_t *head = (int32_t *)malloc(sizeof(int32_t) * (1 << DEFLATE_HASH_BITS));
+	int32_t *prev = (int32_t *)malloc(sizeof(int32_t) * DEFLATE_WINDOW);
+	bool result = false;
+
+	// the worst case is 9 bits per literal
+	if( head == NULL || prev == NULL || !ImageBufferReserve(out, size + size / 8 + 16) ) {
+		goto CLEANUP;
+	}
+	memset(head, 0xFF, sizeof(int32_t) * (1 << DEFLATE_HASH_BITS));
+	writer.ptr = out->data + out->size;
+
+	PutBits(&writer, 1, 1); // final block
+	PutBits(&writer, 1, 2); // fixed codes
+	for( size_t pos = 0; pos < size; ) {
+		int bestLength = 0;
+		int bestDist = 0;
+
+		if( pos + DEFLATE_MIN_MATCH <= size ) {
+			uint32_t hash = Hash3(&data[pos]);
+			int maxLength = ( size - pos < DEFLATE_MAX_MATCH ) ? size - pos : DEFLATE_MAX_MATCH;
+			int32_t candidate = head[hash];
+			for( int chain = 0; chain < DEFLATE_MAX_CHAIN && candidate >= 0 && pos - candidate <= DEFLATE_WINDOW; ++chain ) {
+				const uint8_t *a = &data[candidate];
+				const uint8_t *b = &data[pos];
+				if( a[bestLength] == b[bestLength] ) {
+					int length = 0;
+					while( length < maxLength && a[length] == b[length] ) {
+						++length;
+					}
+					if( length > bestLength ) {
+						bestLength = length;
+						bestDist = pos - candidate;
+						if( length == maxLength ) break;
+					}
+				}
+				candidate = prev[candidate % DEFLATE_WINDOW];
+			}
+			prev[pos % DEFLATE_WINDOW] = head[hash];
+			head[hash] = pos;
+		}
+
+		if( bestLength >= DEFLATE_MIN_MATCH ) {
+			int lengthCode = LengthCodes[bestLength];
+			int distCode = 0;
+			while( distCode < 29 && DistBase[distCode + 1] <= bestDist ) {
+				++distCode;
+			}
+			int symbol = 257 + lengthCode;
+			PutBits(&writer, FixedCodes[symbol], FixedLengths[symbol]);
+			PutBits(&writer, bestLength - LengthBase[lengthCode], LengthExtra[lengthCode]);
+			PutBits(&writer, DistCodes[distCode], 5);
+			PutBits(&writer, bestDist - DistBase[distCode], DistExtra[distCode]);
+			// the matched positions are hashed too, so the next matches may refer to them
+			for( size_t end = pos + bestLength; ++pos < end; ) {
+				if( pos + DEFLATE_MIN_MATCH <= size ) {
+					uint32_t hash = Hash3(&data[pos]);
+					prev[pos % DEFLATE_WINDOW] = head[hash];
+					head[hash] = pos;
+				}
+			}
+		} else {
+			PutBits(&writer, FixedCodes[data[pos]], FixedLengths[data[pos]]);
+			++pos;
+		}
+	}
+	PutBits(&writer, FixedCodes[256], FixedLengths[256]);
+	FlushBits(&writer);
+	out->size = writer.ptr - out->data;
+	result = true;
+
+CLEANUP :
+	free(head);
+	free(prev);
+	return result;
+}
+
+static bool PutChunkPNG(IMAGE_BUFFER *out, const char *type, const uint8_t *data, size_t size) {
+	uint8_t buf[8];
+	PutDwordBE(buf, size);
+	memcpy(&buf[4], type, 4);
+	if( !PutData(out, buf, 8) || (size > 0 && !PutData(out, data, size)) ) {
+		return false;
+	}
+	uint32_t crc = UpdateCrc(0xFFFFFFFF, (const uint8_t *)type, 4);
+	crc = UpdateCrc(crc, data, size) ^ 0xFFFFFFFF;
+	PutDwordBE(buf, crc);
+	return PutData(out, buf, 4);
+}
+
+static inline uint8_t Paeth(int a, int b, int c) {
+	int pa = abs(b - c);
+	int pb = abs(a - c);
+	int pc = abs(a + b - c - c);
+	return ( pa <= pb && pa <= pc ) ? a : ( pb <= pc ) ? b : c;
+}
+
+static uint32_t SumFilteredLine(const uint8_t *line, int size) {
+	uint32_t sum = 0;
+	for( int i = 0; i < size; ++i ) {
+		sum += abs((int8_t)line[i]);
+	}
+	return sum;
+}
+
+// Each line gets the filter with the least sum of absolute values,
+// which is the usual heuristic for the best compression.
+// The filters go in separate loops, so the compiler may vectorize them.
+static void FilterLinePNG(const uint8_t *line, const uint8_t *prior, int size, uint8_t *dst, uint8_t *tmp) {
+	uint8_t *sub = tmp;
+	uint8_t *up = tmp + size;
+	uint8_t *avg = tmp + size * 2;
+	uint8_t *paeth = tmp + size * 3;
+
+	for( int i = 0; i < 3; ++i ) {
+		sub[i] = line[i];
+		up[i] = line[i] - prior[i];
+		avg[i] = line[i] - (prior[i] >> 1);
+		paeth[i] = line[i] - prior[i];
+	}
+	for( int i = 3; i < size; ++i ) {
+		sub[i] = line[i] - line[i - 3];
+	}
+	for( int i = 3; i < size; ++i ) {
+		up[i] = line[i] - prior[i];
+	}
+	for( int i = 3; i < size; ++i ) {
+		avg[i] = line[i] - ((line[i - 3] + prior[i]) >> 1);
+	}
+	for( int i = 3; i < size; ++i ) {
+		paeth[i] = line[i] - Paeth(line[i - 3], prior[i], prior[i - 3]);
+	}
+
+	const uint8_t *filtered[5] = {line, sub, up, avg, paeth};
+	int best = 0;
+	uint32_t bestSum = SumFilteredLine(line, size);
+	for( int filter = 1; filter < 5; ++filter ) {
+		uint32_t sum = SumFilteredLine(filtered[filter], size);
+		if( sum < bestSum ) {
+			bestSum = sum;
+			best = filter;
+		}
+	}
+	dst[0] = best;
+	memcpy(&dst[1], filtered[best], size);
+}
+
+bool ImageEncodePNG(const uint8_t *rgb, int width, int height, IMAGE_BUFFER *out) {
+	static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+	uint8_t ihdr[13] = {0};
+	IMAGE_BUFFER zlib = {NULL, 0, 0};
+	bool result = false;
+	int lineSize = width * 3;
+	size_t rawSize = (size_t)(lineSize + 1) * height;
+	uint8_t *raw = (uint8_t *)malloc(rawSize);
+	uint8_t *tmp = (uint8_t *)malloc(lineSize * 4);
+	uint8_t *zero = (uint8_t *)calloc(lineSize, 1); // the prior line of the first one
+
+	InitTables();
+	if( raw == NULL || tmp == NULL || zero == NULL ) {
+		goto CLEANUP;
+	}
+	for( int y = 0; y < height; ++y ) {
+		FilterLinePNG(rgb + y * lineSize, y ? rgb + (y - 1) * lineSize : zero, lineSize, raw + y * (lineSize + 1), tmp);
+	}
+
+	static const uint8_t zlibHeader[2] = {0x78, 0x01};
+	uint8_t adler[4];
+	PutDwordBE(adler, UpdateAdler(1, raw, rawSize));
+	if( !PutData(&zlib, zlibHeader, 2) || !Deflate(raw, rawSize, &zlib) || !PutData(&zlib, adler, 4) ) {
+		goto CLEANUP;
+	}
+
+	PutDwordBE(&ihdr[0], width);
+	PutDwordBE(&ihdr[4], height);
+	ihdr[8] = 8; // bits per channel
+	ihdr[9] = 2; // RGB
+	result = PutData(out, signature, sizeof(signature)) &&
+		PutChunkPNG(out, "IHDR", ihdr, sizeof(ihdr)) &&
+		PutChunkPNG(out, "IDAT", zlib.data, zlib.size) &&
+		PutChunkPNG(out, "IEND", NULL, 0);
+
+CLEANUP :
+	ImageBufferFree(&zlib);
+	free(raw);
+	free(tmp);
+	free(zero);
+	return result;
+}
+
+size_t ImageHeaderY4M(char *header, size_t size, int width, int height, int fps) {
+	int len = snprintf(header, size, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps);
+	return ( len > 0 && (size_t)len < size ) ? len : 0;
+}
+
+// Full range BT.601 (JPEG) YCbCr with 2x2 averaged chroma
+bool ImageEncodeY4M(const uint8_t *rgb, int width, int height, IMAGE_BUFFER *out) {
+	static const char frameTag[] = "FRAME\n";
+	int chromaWidth = (width + 1) / 2;
+	int chromaHeight = (height + 1) / 2;
+	size_t lumaSize = (size_t)width * height;
+	size_t chromaSize = (size_t)chromaWidth * chromaHeight;
+
+	if( !PutData(out, frameTag, sizeof(frameTag) - 1) || !ImageBufferReserve(out, lumaSize + chromaSize * 2) ) {
+		return false;
+	}
+	uint8_t *lumaPlane = out->data + out->size;
+	uint8_t *cbPlane = lumaPlane + lumaSize;
+	uint8_t *crPlane = cbPlane + chromaSize;
+
+	for( int y = 0; y < height; ++y ) {
+		const uint8_t *src = rgb + y * width * 3;
+		uint8_t *dst = lumaPlane + y * width;
+		for( int x = 0; x < width; ++x, src += 3 ) {
+			dst[x] = (19595 * src[0] + 38470 * src[1] + 7471 * src[2] + 32768) >> 16;
+		}
+	}
+	for( int y = 0; y < chromaHeight; ++y ) {
+		int y0 = y * 2;
+		int y1 = ( y0 + 1 < height ) ? y0 + 1 : y0;
+		for( int x = 0; x < chromaWidth; ++x ) {
+			int x0 = x * 2;
+			int x1 = ( x0 + 1 < width ) ? x0 + 1 : x0;
+			const uint8_t *p[4] = {
+				rgb + (y0 * width + x0) * 3,
+				rgb + (y0 * width + x1) * 3,
+				rgb + (y1 * width + x0) * 3,
+				rgb + (y1 * width + x1) * 3,
+			};
+			int r = p[0][0] + p[1][0] + p[2][0] + p[3][0];
+			int g = p[0][1] + p[1][1] + p[2][1] + p[3][1];
+			int b = p[0][2] + p[1][2] + p[2][2] + p[3][2];
+			// the sums are four times bigger, so the fixed point shift is 18
+			int cb = (128 << 18) + (-11059 * r - 21709 * g + 32768 * b) + (1 << 17);
+			int cr = (128 << 18) + (32768 * r - 27439 * g - 5329 * b) + (1 << 17);
+			cbPlane[y * chromaWidth + x] = ( cb >> 18 > 255 ) ? 255 : cb >> 18;
+			crPlane[y * chromaWidth + x] = ( cr >> 18 > 255 ) ? 255 : cr >> 18;
+		}
+	}
+	out->size += lumaSize + chromaSize * 2;
+	return true;
+}
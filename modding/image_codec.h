@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IMAGE_CODEC_H_INCLUDED
+#define IMAGE_CODEC_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Image codec depends on the C library only, so it may be built and
+// benchmarked on any platform apart from the game. It is thread safe.
+
+typedef struct ImageFrame_t {
+	int width;
+	int height;
+	int pitch; // bytes per source line
+	int bpp; // 8, 16, 24 or 32
+	uint32_t rMask; // channel masks for 16, 24 and 32 bpp
+	uint32_t gMask;
+	uint32_t bMask;
+	const uint8_t *pixels;
+	const uint8_t *palette; // 256 RGB triplets for 8 bpp
+} IMAGE_FRAME;
+
+typedef struct ImageBuffer_t {
+	uint8_t *data;
+	size_t size;
+	size_t capacity;
+} IMAGE_BUFFER;
+
+/*
+ * Function list
+ */
+bool ImageBufferReserve(IMAGE_BUFFER *buffer, size_t size);
+void ImageBufferFree(IMAGE_BUFFER *buffer);
+
+bool ImageFrameToRGB(const IMAGE_FRAME *frame, uint8_t *rgb);
+
+size_t ImageEncodeLinePCX(const uint8_t *src, int width, uint8_t *dst);
+size_t ImageBoundPCX(int width, int height);
+size_t ImageWritePCX(const IMAGE_FRAME *frame, uint8_t *dst);
+bool ImageEncodePCX(const IMAGE_FRAME *frame, IMAGE_BUFFER *out);
+bool ImageEncodeTGA(const uint8_t *rgb, int width, int height, IMAGE_BUFFER *out);
+bool ImageEncodePNG(const uint8_t *rgb, int width, int height, IMAGE_BUFFER *out);
+
+size_t ImageHeaderY4M(char *header, size_t size, int width, int height, int fps);
+bool ImageEncodeY4M(const uint8_t *rgb, int width, int height, IMAGE_BUFFER *out);
+
+#endif // IMAGE_CODEC_H_INCLUDED
@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global/precompiled.h"
+#include "modding/level_cache.h"
+#include "modding/load_report.h"
+#include "modding/mod_utils.h"
+#include "specific/utils.h"
+#include "global/vars.h"
+
+#ifdef FEATURE_LOADING_IMPROVED
+#define LEVEL_CACHE_MAGIC		(0x31434454) // "TDC1"
+#define LEVEL_CACHE_VERSION		(1) // increase it when the derived data rules are changed
+#define LEVEL_CACHE_EXTENSION	".cache"
+
+typedef struct LevelCacheHeader_t {
+	DWORD magic;
+	DWORD version;
+	DWORD textureSize;
+	DWORD textureCount;
+	UINT64 key;
+} LEVEL_CACHE_HEADER;
+
+typedef struct LevelCache_t {
+	char fileName[MAX_PATH];
+	LEVEL_CACHE_HEADER header;
+	PHD_TEXTURE *textures; // texture infos before the UV adjustment
+	BYTE *uvFlags;
+	BYTE paletteFlags[256];
+	bool isActive;
+	bool isWarm;
+	bool isStored; // the cold load has got the textures
+	bool isComplete; // the cold load has got the marks
+	double keyTime;
+	double fileTime;
+} LEVEL_CACHE;
+
+bool LevelCacheEnabled = true;
+
+static LEVEL_CACHE Cache;
+
+// Two interleaved lanes of 32 bit words. It is a few times faster than a byte hash,
+// and the rotation lets the high bits of the words affect the whole result.
+static UINT64 HashData(UINT64 hash, LPCVOID data, DWORD size) {
+	const DWORD *words = (const DWORD *)data;
+	const BYTE *tail = (const BYTE *)data + (size & ~7);
+	DWORD lane0 = (DWORD)hash;
+	DWORD lane1 = (DWORD)(hash >> 32);
+
+	for( DWORD i = 0; i < size / 8; ++i ) {
+		lane0 = _rotl((lane0 ^ words[i * 2 + 0]) * 0x9E3779B1, 15);
+		lane1 = _rotl((lane1 ^ words[i * 2 + 1]) * 0x85EBCA77, 15);
+	}
+	for( DWORD i = 0; i < (size & 7); ++i ) {
+		lane0 = _rotl((lane0 ^ tail[i]) * 0x9E3779B1, 15);
+	}
+	lane0 ^= size;
+	lane1 ^= lane0;
+	lane1 = (lane1 ^ (lane1 >> 16)) * 0x85EBCA6B;
+	lane1 = (lane1 ^ (lane1 >> 13)) * 0xC2B2AE35;
+	lane1 ^= lane1 >> 16;
+	return ((UINT64)lane1 << 32) | lane0;
+}
+
+static UINT64 HashModConfig(UINT64 hash) {
+	HANDLE hFile = CreateFile(MOD_CONFIG_NAME, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN|FILE_ATTRIBUTE_NORMAL, NULL);
+	if( hFile == INVALID_HANDLE_VALUE ) {
+		return hash;
+	}
+	DWORD bytesRead = 0;
+	DWORD size = GetFileSize(hFile, NULL);
+	void *data = ( size != INVALID_FILE_SIZE ) ? malloc(size) : NULL;
+	if( data != NULL && ReadFile(hFile, data, size, &bytesRead, NULL) && bytesRead == size ) {
+		hash = HashData(hash, data, size);
+	}
+	free(data);
+	CloseHandle(hFile);
+	return hash;
+}
+
+static bool AllocCacheTables(DWORD textureCount) {
+	Cache.textures = (PHD_TEXTURE *)malloc(sizeof(PHD_TEXTURE) * MAX(textureCount, 1));
+	Cache.uvFlags = (BYTE *)malloc(MAX(textureCount, 1));
+	return ( Cache.textures != NULL && Cache.uvFlags != NULL );
+}
+
+static bool LoadCacheFile() {
+	LEVEL_CACHE_HEADER header;
+	DWORD bytesRead = 0;
+	bool result = false;
+
+	HANDLE hFile = CreateFile(Cache.fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN|FILE_ATTRIBUTE_NORMAL, NULL);
+	if( hFile == INVALID_HANDLE_VALUE ) {
+		return false;
+	}
+	if( !ReadFile(hFile, &header, sizeof(header), &bytesRead, NULL) || bytesRead != sizeof(header) ||
+		header.magic != Cache.header.magic || header.version != Cache.header.version ||
+		header.textureSize != Cache.header.textureSize || header.key != Cache.header.key ||
+		header.textureCount > ARRAY_SIZE(PhdTextureInfo) ||
+		GetFileSize(hFile, NULL) != sizeof(header) + header.textureCount * (sizeof(PHD_TEXTURE) + 1) + sizeof(Cache.paletteFlags) )
+	{
+		goto EXIT;
+	}
+	if( !AllocCacheTables(header.textureCount) ) {
+		goto EXIT;
+	}
+	result = ReadFile(hFile, Cache.textures, sizeof(PHD_TEXTURE) * header.textureCount, &bytesRead, NULL)
+		&& ReadFile(hFile, Cache.uvFlags, header.textureCount, &bytesRead, NULL)
+		&& ReadFile(hFile, Cache.paletteFlags, sizeof(Cache.paletteFlags), &bytesRead, NULL);
+	Cache.header.textureCount = header.textureCount;
+
+EXIT :
+	CloseHandle(hFile);
+	return result;
+}
+
+static bool SaveCacheFile() {
+	DWORD bytesWritten = 0;
+	HANDLE hFile = CreateFile(Cache.fileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if( hFile == INVALID_HANDLE_VALUE ) {
+		return false; // the level folder may be read only, it is not an error
+	}
+	bool result = WriteFile(hFile, &Cache.header, sizeof(Cache.header), &bytesWritten, NULL)
+		&& WriteFile(hFile, Cache.textures, sizeof(PHD_TEXTURE) * Cache.header.textureCount, &bytesWritten, NULL)
+		&& WriteFile(hFile, Cache.uvFlags, Cache.header.textureCount, &bytesWritten, NULL)
+		&& WriteFile(hFile, Cache.paletteFlags, sizeof(Cache.paletteFlags), &bytesWritten, NULL);
+	CloseHandle(hFile);
+	if( !result ) {
+		DeleteFile(Cache.fileName); // the broken file would be rejected anyway
+	}
+	return result;
+}
+
+void LevelCacheBegin(LPCTSTR levelPath, LPCVOID levelData, DWORD levelSize) {
+	LevelCacheReset();
+	if( !LevelCacheEnabled || levelPath == NULL || levelData == NULL
+		|| strlen(levelPath) + sizeof(LEVEL_CACHE_EXTENSION) > sizeof(Cache.fileName) )
+	{
+		return;
+	}
+	snprintf(Cache.fileName, sizeof(Cache.fileName), "%s%s", levelPath, LEVEL_CACHE_EXTENSION);
+
+	double startTime = UT_Microseconds();
+	Cache.header.magic = LEVEL_CACHE_MAGIC;
+	Cache.header.version = LEVEL_CACHE_VERSION;
+	Cache.header.textureSize = sizeof(PHD_TEXTURE);
+	Cache.header.key = HashModConfig(HashData(0, levelData, levelSize));
+	Cache.keyTime = UT_Microseconds() - startTime;
+
+	startTime = UT_Microseconds();
+	Cache.isWarm = LoadCacheFile();
+	Cache.fileTime = UT_Microseconds() - startTime;
+	if( !Cache.isWarm ) {
+		free(Cache.textures);
+		free(Cache.uvFlags);
+		Cache.textures = NULL;
+		Cache.uvFlags = NULL;
+	}
+	Cache.isActive = true;
+}
+
+void LevelCacheEnd(bool isLoaded, double derivedTime) {
+	if( !Cache.isActive ) {
+		return;
+	}
+	if( isLoaded && !Cache.isWarm && Cache.isStored ) {
+		// the marks are done after the texture setup, so the final draw types are taken now
+		for( DWORD i = 0; i < Cache.header.textureCount; ++i ) {
+			Cache.textures[i].drawtype = PhdTextureInfo[i].drawtype;
+		}
+		for( DWORD i = 0; i < 256; ++i ) {
+			Cache.paletteFlags[i] = GamePalette16[i].peFlags;
+		}
+		Cache.isComplete = true;
+		double startTime = UT_Microseconds();
+		SaveCacheFile();
+		Cache.fileTime += UT_Microseconds() - startTime;
+	}
+	LoadReportPrint("LevelCache(%s): %s, key %.3f ms, derived %.3f ms, file %.3f ms",
+		Cache.fileName, Cache.isWarm ? "warm" : "cold", Cache.keyTime * 1000.0, derivedTime * 1000.0, Cache.fileTime * 1000.0);
+	if( !isLoaded ) {
+		LevelCacheReset();
+	}
+}
+
+void LevelCacheReset() {
+	free(Cache.textures);
+	free(Cache.uvFlags);
+	memset(&Cache, 0, sizeof(Cache));
+}
+
+bool LevelCacheApplyTextures() {
+	if( !Cache.isActive || !Cache.isWarm || Cache.header.textureCount != TextureInfoCount ) {
+		return false;
+	}
+	memcpy(PhdTextureInfo, Cache.textures, sizeof(PHD_TEXTURE) * TextureInfoCount);
+	memcpy(LabTextureUVFlags, Cache.uvFlags, TextureInfoCount);
+	return true;
+}
+
+void LevelCacheStoreTextures() {
+	if( !Cache.isActive || Cache.isWarm || TextureInfoCount > ARRAY_SIZE(PhdTextureInfo) ) {
+		return;
+	}
+	free(Cache.textures);
+	free(Cache.uvFlags);
+	if( !AllocCacheTables(TextureInfoCount) ) {
+		Cache.isActive = false;
+		return;
+	}
+	Cache.header.textureCount = TextureInfoCount;
+	memcpy(Cache.textures, PhdTextureInfo, sizeof(PHD_TEXTURE) * TextureInfoCount);
+	memcpy(Cache.uvFlags, LabTextureUVFlags, TextureInfoCount);
+	Cache.isStored = true;
+}
+
+bool LevelCacheApplyPaletteFlags() {
+	// the completed cold load keeps the flags too, so the palette reload can restore them
+	if( !Cache.isActive || (!Cache.isWarm && !Cache.isComplete) ) {
+		return false;
+	}
+	for( DWORD i = 0; i < 256; ++i ) {
+		GamePalette16[i].peFlags = Cache.paletteFlags[i];
+	}
+	return true;
+}
+#endif // FEATURE_LOADING_IMPROVED
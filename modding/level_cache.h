@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LEVEL_CACHE_H_INCLUDED
+#define LEVEL_CACHE_H_INCLUDED
+
+#include "global/types.h"
+
+// Level cache keeps the data derived from the level file after the loading
+// (texture infos with their UV flags and semitransparency marks, palette flags)
+// in a file next to the level. The file is keyed by the level content and the
+// mod configuration, so a warm load copies the tables instead of computing them.
+// The UV adjustment depends on the render settings, so it is always done.
+
+/*
+ * Function list
+ */
+void LevelCacheBegin(LPCTSTR levelPath, LPCVOID levelData, DWORD levelSize);
+void LevelCacheEnd(bool isLoaded, double derivedTime);
+void LevelCacheReset();
+
+bool LevelCacheApplyTextures();
+void LevelCacheStoreTextures();
+bool LevelCacheApplyPaletteFlags();
+
+#endif // LEVEL_CACHE_H_INCLUDED
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "global/precompiled.h"
+#include "modding/level_prefetch.h"
+#include "global/vars.h"
+
+#define PREFETCH_BLOCK_SIZE	(0x100000) // 1 MB
+
+typedef struct LevelPrefetch_t {
+	char fullPath[MAX_PATH];
+	HANDLE hThread;
+	BYTE *data;
+	DWORD size;
+	bool isReady; // the whole file is read, it's checked only when the thread is joined
+	volatile LONG isCancelled; // the only field shared with the running thread
+} LEVEL_PREFETCH;
+
+static LEVEL_PREFETCH Prefetch;
+
+static DWORD WINAPI LevelPrefetchTask(CONST LPVOID lpParam) {
+	LEVEL_PREFETCH *prefetch = (LEVEL_PREFETCH *)lpParam;
+	DWORD bytesRead = 0;
+
+	HANDLE hFile = CreateFile(prefetch->fullPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN|FILE_ATTRIBUTE_NORMAL, NULL);
+	if( hFile == INVALID_HANDLE_VALUE ) {
+		return 0;
+	}
+	DWORD size = GetFileSize(hFile, NULL);
+	if( size == INVALID_FILE_SIZE || size == 0 ) {
+		goto CLEANUP;
+	}
+	prefetch->data = (BYTE *)malloc(size);
+	if( prefetch->data == NULL ) {
+		goto CLEANUP;
+	}
+	// the file is read by blocks, so the game thread may cancel the task quickly
+	for( DWORD offset = 0; offset < size; offset += bytesRead ) {
+		if( InterlockedCompareExchange(&prefetch->isCancelled, 0, 0) ||
+			!ReadFile(hFile, prefetch->data + offset, MIN(size - offset, PREFETCH_BLOCK_SIZE), &bytesRead, NULL) ||
+			bytesRead == 0 )
+		{
+			goto CLEANUP;
+		}
+	}
+	prefetch->size = size;
+	prefetch->isReady = true;
+
+CLEANUP :
+	CloseHandle(hFile);
+	return 0;
+}
+
+static void WaitLevelPrefetch() {
+	if( Prefetch.hThread != NULL ) {
+		WaitForSingleObject(Prefetch.hThread, INFINITE);
+		CloseHandle(Prefetch.hThread);
+		Prefetch.hThread = NULL;
+	}
+}
+
+void LevelPrefetchStart(LPCTSTR fullPath) {
+	if( fullPath == NULL || !*fullPath ) {
+		return;
+	}
+	// the same level is being prefetched already
+	if( (Prefetch.hThread != NULL || Prefetch.isReady) && !lstrcmpi(Prefetch.fullPath, fullPath) ) {
+		return;
+	}
+	LevelPrefetchCancel();
+	strncpy(Prefetch.fullPath, fullPath, sizeof(Prefetch.fullPath) - 1);
+	Prefetch.hThread = CreateThread(NULL, 0, &LevelPrefetchTask, &Prefetch, 0, NULL);
+	if( Prefetch.hThread == NULL ) {
+		// if failed to create a thread, the level is just loaded as usual
+		memset(&Prefetch, 0, sizeof(Prefetch));
+	}
+}
+
+void LevelPrefetchCancel() {
+	InterlockedExchange(&Prefetch.isCancelled, 1);
+	WaitLevelPrefetch();
+	LevelPrefetchRelease();
+}
+
+bool LevelPrefetchTake(LPCTSTR fullPath, FILE_VIEW *view) {
+	if( fullPath == NULL || view == NULL || (Prefetch.hThread == NULL && !Prefetch.isReady) ) {
+		return false;
+	}
+	// keep the prefetched level, since some other file (i.e. cutscene) may be loaded before it
+	if( lstrcmpi(Prefetch.fullPath, fullPath) ) {
+		return false;
+	}
+	WaitLevelPrefetch();
+	if( !Prefetch.isReady || !FileViewOpenMemory(view, Prefetch.data, Prefetch.size) ) {
+		LevelPrefetchRelease();
+		return false;
+	}
+	return true;
+}
+
+void LevelPrefetchRelease() {
+	// the task must be finished before this
+	if( Prefetch.hThread != NULL ) {
+		return;
+	}
+	if( Prefetch.data != NULL ) {
+		free(Prefetch.data);
+	}
+	memset(&Prefetch, 0, sizeof(Prefetch));
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LEVEL_PREFETCH_H_INCLUDED
+#define LEVEL_PREFETCH_H_INCLUDED
+
+#include "global/types.h"
+#include "modding/file_view.h"
+
+// Level prefetch reads the next level file into memory by a worker thread,
+// while the game thread shows FMVs, cutscenes or the level statistics.
+// The level is still parsed by the game thread, since the game_malloc arena,
+// textures and sound samples are not thread safe.
+
+/*
+ * Function list
+ */
+void LevelPrefetchStart(LPCTSTR fullPath);
+void LevelPrefetchCancel();
+bool LevelPrefetchTake(LPCTSTR fullPath, FILE_VIEW *view);
+void LevelPrefetchRelease();
+
+#endif // LEVEL_PREFETCH_H_INCLUDED
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global/precompiled.h"
+#include "modding/load_report.h"
+#include "modding/file_utils.h"
+#include "global/vars.h"
+#include <stdarg.h>
+
+#define LOAD_REPORT_PATH	".\\profiles\\loading.txt"
+
+bool LoadReportEnabled = false;
+
+// Appends one line to the loading report, which is shared by the level loader,
+// the sample bank, the level cache and the game memory arena
+void LoadReportPrint(LPCSTR format, ...) {
+	if( !LoadReportEnabled ) {
+		return;
+	}
+	CreateDirectories(LOAD_REPORT_PATH, true);
+	FILE *fp = fopen(LOAD_REPORT_PATH, "at");
+	if( fp == NULL ) {
+		return;
+	}
+	va_list args;
+	va_start(args, format);
+	vfprintf(fp, format, args);
+	va_end(args);
+	fputc('\n', fp);
+	fclose(fp);
+}
@@ -26,8 +26,6 @@
 #ifdef FEATURE_MOD_CONFIG
 #include "json-parser/json.h"
 
-#define MOD_CONFIG_NAME "TR2Main.json"
-
 typedef struct {
 	bool isLoaded;
 	bool isBarefoot;
@@ -30,6 +30,8 @@
 // If the first item has index=0 and number=0 then all polys of such type must be processed.
 #define POLYFILTER_SIZE 256
 
+#define MOD_CONFIG_NAME "TR2Main.json"
+
 typedef struct {__int16 idx; __int16 num;} POLYINDEX;
 
 typedef struct {
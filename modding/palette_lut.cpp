@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "global/precompiled.h"
+#include "modding/palette_lut.h"
+#include "global/vars.h"
+#include <limits.h>
+
+#define LUT_BITS		(4)
+#define LUT_SIDE		(1 << LUT_BITS) // cube cells per channel
+#define LUT_CELL		(256 >> LUT_BITS) // channel levels per cell
+#define LUT_CELLS		(LUT_SIDE * LUT_SIDE * LUT_SIDE)
+#define LUT_SLOTS		(4)
+#define LUT_THRESHOLD	(4096) // brute force queries before the cube is built
+#define REMAP_SLOTS		(8)
+
+typedef struct PaletteLut_t {
+	DWORD hash;
+	bool ignoreSysPalette;
+	bool isValid;
+	RGB888 palette[256];
+	DWORD queries;
+	DWORD lastUse;
+	DWORD *cellStart; // LUT_CELLS+1 offsets into the candidate list
+	BYTE *candidates; // candidate palette indexes of every cell in ascending order
+} PALETTE_LUT;
+
+typedef struct PaletteRemap_t {
+	DWORD srcHash;
+	DWORD dstHash;
+	bool ignoreSysPalette;
+	bool isValid;
+	RGB888 srcPalette[256];
+	RGB888 dstPalette[256];
+	BYTE remap[256];
+	DWORD lastUse;
+} PALETTE_REMAP;
+
+static PALETTE_LUT PaletteLuts[LUT_SLOTS];
+static PALETTE_LUT *LastPaletteLut = NULL;
+static PALETTE_REMAP PaletteRemaps[REMAP_SLOTS];
+static DWORD PaletteLutClock = 0;
+
+static DWORD GetPaletteHash(RGB888 *palette) {
+	// FNV-1a by 32 bit words, the palette size is multiple of 4
+	DWORD hash = 2166136261;
+	const DWORD *data = (const DWORD *)palette;
+	for( DWORD i = 0; i < 256 * sizeof(RGB888) / sizeof(DWORD); ++i ) {
+		hash = (hash ^ data[i]) * 16777619;
+	}
+	return hash;
+}
+
+static void GetPaletteRange(bool ignoreSysPalette, int *start, int *end) {
+	*start = ignoreSysPalette ? 10 : 0;
+	*end = ignoreSysPalette ? 246 : 256;
+}
+
+// The same search as in FindNearestPaletteEntry, so the same entry wins a tie
+static BYTE FindNearestEntry(RGB888 *palette, int start, int end, int red, int green, int blue) {
+	int diffMin = INT_MAX;
+	BYTE result = 0;
+	for( int i = start; i < end; ++i ) {
+		int diffRed   = red   - palette[i].red;
+		int diffGreen = green - palette[i].green;
+		int diffBlue  = blue  - palette[i].blue;
+		int diffTotal = diffRed*diffRed + diffGreen*diffGreen + diffBlue*diffBlue;
+		if( diffTotal < diffMin ) {
+			diffMin = diffTotal;
+			result = i;
+		}
+	}
+	return result;
+}
+
+static int GetAxisMinDist(int value, int lo, int hi) {
+	if( value < lo ) return lo - value;
+	if( value > hi ) return value - hi;
+	return 0;
+}
+
+static int GetAxisMaxDist(int value, int lo, int hi) {
+	return MAX(ABS(value - lo), ABS(value - hi));
+}
+
+static void FreeLut(PALETTE_LUT *lut) {
+	if( lut->cellStart != NULL ) {
+		delete[] lut->cellStart;
+	}
+	if( lut->candidates != NULL ) {
+		free(lut->candidates);
+	}
+	memset(lut, 0, sizeof(PALETTE_LUT));
+}
+
+static bool BuildLut(PALETTE_LUT *lut) {
+	int start, end;
+	int minDist[256];
+	DWORD count = 0;
+	DWORD capacity = LUT_CELLS * 8;
+
+	GetPaletteRange(lut->ignoreSysPalette, &start, &end);
+	lut->cellStart = new DWORD[LUT_CELLS + 1];
+	lut->candidates = (BYTE *)malloc(capacity);
+	if( lut->cellStart == NULL || lut->candidates == NULL ) {
+		return false;
+	}
+
+	// An entry may be the nearest one for some colour of the cell, only if its
+	// distance to the cell box is not greater than the smallest distance to the
+	// farthest box corner among all entries. Other entries are never the nearest
+	// and never tie with the nearest one, so the brute force result is kept.
+	for( int cell = 0; cell < LUT_CELLS; ++cell ) {
+		int rLo = (cell >> (LUT_BITS * 2)) * LUT_CELL;
+		int gLo = ((cell >> LUT_BITS) & (LUT_SIDE - 1)) * LUT_CELL;
+		int bLo = (cell & (LUT_SIDE - 1)) * LUT_CELL;
+		int rHi = rLo + LUT_CELL - 1;
+		int gHi = gLo + LUT_CELL - 1;
+		int bHi = bLo + LUT_CELL - 1;
+		int maxDistMin = INT_MAX;
+
+		for( int i = start; i < end; ++i ) {
+			RGB888 *color = &lut->palette[i];
+			int r = GetAxisMinDist(color->red, rLo, rHi);
+			int g = GetAxisMinDist(color->green, gLo, gHi);
+			int b = GetAxisMinDist(color->blue, bLo, bHi);
+			minDist[i] = r*r + g*g + b*b;
+			r = GetAxisMaxDist(color->red, rLo, rHi);
+			g = GetAxisMaxDist(color->green, gLo, gHi);
+			b = GetAxisMaxDist(color->blue, bLo, bHi);
+			CLAMPG(maxDistMin, r*r + g*g + b*b);
+		}
+
+		lut->cellStart[cell] = count;
+		for( int i = start; i < end; ++i ) {
+			if( minDist[i] > maxDistMin ) continue;
+			if( count >= capacity ) {
+				capacity *= 2;
+				BYTE *candidates = (BYTE *)realloc(lut->candidates, capacity);
+				if( candidates == NULL ) {
+					return false;
+				}
+				lut->candidates = candidates;
+			}
+			lut->candidates[count++] = i;
+		}
+	}
+	lut->cellStart[LUT_CELLS] = count;
+	return true;
+}
+
+static PALETTE_LUT *FindLut(RGB888 *palette, bool ignoreSysPalette) {
+	// the same palette is usually queried many times in a row, so check it before hashing
+	PALETTE_LUT *lut = LastPaletteLut;
+	if( lut != NULL && lut->isValid && lut->ignoreSysPalette == ignoreSysPalette &&
+		!memcmp(lut->palette, palette, sizeof(lut->palette)) )
+	{
+		return lut;
+	}
+
+	DWORD hash = GetPaletteHash(palette);
+	for( int i = 0; i < LUT_SLOTS; ++i ) {
+		if( PaletteLuts[i].isValid && PaletteLuts[i].hash == hash &&
+			PaletteLuts[i].ignoreSysPalette == ignoreSysPalette &&
+			!memcmp(PaletteLuts[i].palette, palette, sizeof(PaletteLuts[i].palette)) )
+		{
+			return &PaletteLuts[i];
+		}
+	}
+
+	// replace the least recently used slot
+	lut = &PaletteLuts[0];
+	for( int i = 1; i < LUT_SLOTS; ++i ) {
+		if( !PaletteLuts[i].isValid || PaletteLuts[i].lastUse < lut->lastUse ) {
+			lut = &PaletteLuts[i];
+			if( !lut->isValid ) break;
+		}
+	}
+	FreeLut(lut);
+	lut->hash = hash;
+	lut->ignoreSysPalette = ignoreSysPalette;
+	memcpy(lut->palette, palette, sizeof(lut->palette));
+	lut->isValid = true;
+	return lut;
+}
+
+static PALETTE_LUT *GetLut(RGB888 *palette, bool ignoreSysPalette, DWORD queries) {
+	PALETTE_LUT *lut = FindLut(palette, ignoreSysPalette);
+	LastPaletteLut = lut;
+	lut->lastUse = ++PaletteLutClock;
+	lut->queries += queries;
+	if( lut->cellStart == NULL && lut->queries >= LUT_THRESHOLD && !BuildLut(lut) ) {
+		// keep the palette slot, but go on with the brute force search
+		if( lut->cellStart != NULL ) delete[] lut->cellStart;
+		if( lut->candidates != NULL ) free(lut->candidates);
+		lut->cellStart = NULL;
+		lut->candidates = NULL;
+		lut->queries = 0;
+	}
+	return lut;
+}
+
+static BYTE LutFindNearest(PALETTE_LUT *lut, int red, int green, int blue) {
+	RGB888 *palette = lut->palette;
+	if( lut->cellStart == NULL ) {
+		int start, end;
+		GetPaletteRange(lut->ignoreSysPalette, &start, &end);
+		return FindNearestEntry(palette, start, end, red, green, blue);
+	}
+
+	int cell = ((red / LUT_CELL) << (LUT_BITS * 2)) | ((green / LUT_CELL) << LUT_BITS) | (blue / LUT_CELL);
+	int diffMin = INT_MAX;
+	BYTE result = 0;
+	for( DWORD i = lut->cellStart[cell]; i < lut->cellStart[cell + 1]; ++i ) {
+		BYTE index = lut->candidates[i];
+		int diffRed   = red   - palette[index].red;
+		int diffGreen = green - palette[index].green;
+		int diffBlue  = blue  - palette[index].blue;
+		int diffTotal = diffRed*diffRed + diffGreen*diffGreen + diffBlue*diffBlue;
+		if( diffTotal < diffMin ) {
+			diffMin = diffTotal;
+			result = index;
+		}
+	}
+	return result;
+}
+
+BYTE PaletteLutFindNearest(RGB888 *palette, int red, int green, int blue, bool ignoreSysPalette) {
+	if( red < 0 || red > 255 || green < 0 || green > 255 || blue < 0 || blue > 255 ) {
+		int start, end;
+		GetPaletteRange(ignoreSysPalette, &start, &end);
+		return FindNearestEntry(palette, start, end, red, green, blue);
+	}
+	return LutFindNearest(GetLut(palette, ignoreSysPalette, 1), red, green, blue);
+}
+
+void PaletteLutRemap(RGB888 *srcPalette, RGB888 *dstPalette, bool ignoreSysPalette, BYTE *remap) {
+	DWORD srcHash = GetPaletteHash(srcPalette);
+	DWORD dstHash = GetPaletteHash(dstPalette);
+	PALETTE_REMAP *slot = NULL;
+
+	for( int i = 0; i < REMAP_SLOTS; ++i ) {
+		PALETTE_REMAP *cached = &PaletteRemaps[i];
+		if( cached->isValid && cached->srcHash == srcHash && cached->dstHash == dstHash &&
+			cached->ignoreSysPalette == ignoreSysPalette &&
+			!memcmp(cached->srcPalette, srcPalette, sizeof(cached->srcPalette)) &&
+			!memcmp(cached->dstPalette, dstPalette, sizeof(cached->dstPalette)) )
+		{
+			cached->lastUse = ++PaletteLutClock;
+			memcpy(remap, cached->remap, sizeof(cached->remap));
+			return;
+		}
+		if( slot == NULL || !cached->isValid || (slot->isValid && cached->lastUse < slot->lastUse) ) {
+			slot = cached;
+		}
+	}
+
+	slot->srcHash = srcHash;
+	slot->dstHash = dstHash;
+	slot->ignoreSysPalette = ignoreSysPalette;
+	memcpy(slot->srcPalette, srcPalette, sizeof(slot->srcPalette));
+	memcpy(slot->dstPalette, dstPalette, sizeof(slot->dstPalette));
+	PALETTE_LUT *lut = GetLut(dstPalette, ignoreSysPalette, 256);
+	for( int i = 0; i < 256; ++i ) {
+		slot->remap[i] = LutFindNearest(lut, srcPalette[i].red, srcPalette[i].green, srcPalette[i].blue);
+	}
+	slot->isValid = true;
+	slot->lastUse = ++PaletteLutClock;
+	memcpy(remap, slot->remap, sizeof(slot->remap));
+}
+
+void PaletteLutFree() {
+	for( int i = 0; i < LUT_SLOTS; ++i ) {
+		FreeLut(&PaletteLuts[i]);
+	}
+	memset(PaletteRemaps, 0, sizeof(PaletteRemaps));
+	LastPaletteLut = NULL;
+}
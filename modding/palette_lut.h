@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef PALETTE_LUT_H_INCLUDED
+#define PALETTE_LUT_H_INCLUDED
+
+#include "global/types.h"
+
+// Palette lookup gives exactly the same nearest palette entries as the brute force
+// search, but the search goes through a few candidates of the colour cube cell only.
+// The cube is built for a palette when it is queried often enough.
+// The palette to palette remap tables are cached as well.
+
+/*
+ * Function list
+ */
+BYTE PaletteLutFindNearest(RGB888 *palette, int red, int green, int blue, bool ignoreSysPalette);
+void PaletteLutRemap(RGB888 *srcPalette, RGB888 *dstPalette, bool ignoreSysPalette, BYTE *remap);
+void PaletteLutFree();
+
+#endif // PALETTE_LUT_H_INCLUDED
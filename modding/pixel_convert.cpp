@@ -0,0 +1,321 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global/precompiled.h"
+#include "modding/pixel_convert.h"
+#include "modding/cpu_utils.h"
+#include "specific/winvid.h"
+#include "global/vars.h"
+
+typedef struct PixelChannel_t {
+	DWORD srcMask;
+	DWORD srcShift;
+	DWORD downShift;
+	DWORD upShift;
+	DWORD upMask; // all bits are set when the channel is expanded
+	DWORD dstShift;
+} PIXEL_CHANNEL;
+
+typedef struct PixelConverter_t {
+	DWORD srcFormat[5]; // bit count and masks the converter is compiled for
+	DWORD dstFormat[5];
+	DWORD srcBpp;
+	DWORD dstBpp;
+	DWORD dstAlpha;
+	PIXEL_CHANNEL channels[3];
+	DWORD *pixelLut; // every 16 bit source pixel, built when it is needed
+	DWORD byteLut[4][256]; // every source byte, when no channel crosses a byte
+	bool isByteLut;
+	bool isValid;
+} PIXEL_CONVERTER;
+
+static PIXEL_CONVERTER Converter;
+
+static void GetFormatKey(DWORD *key, LPDDPIXELFORMAT format) {
+	key[0] = format->dwRGBBitCount;
+	key[1] = format->dwRBitMask;
+	key[2] = format->dwGBitMask;
+	key[3] = format->dwBBitMask;
+	key[4] = format->dwRGBAlphaBitMask;
+}
+
+static void CompileChannel(PIXEL_CHANNEL *channel, DWORD srcMask, DWORD srcDepth, DWORD srcOffset, DWORD dstDepth, DWORD dstOffset) {
+	channel->srcMask = srcMask;
+	channel->srcShift = srcOffset;
+	channel->downShift = 0;
+	channel->upShift = 0;
+	channel->upMask = 0;
+	channel->dstShift = dstOffset;
+	if( srcDepth < dstDepth ) {
+		// the high bits are repeated in the low bits
+		DWORD high = dstDepth - srcDepth;
+		channel->upShift = high;
+		channel->upMask = ~0;
+		channel->downShift = (srcDepth > high) ? srcDepth - high : 0;
+	} else if( srcDepth > dstDepth ) {
+		channel->downShift = srcDepth - dstDepth;
+	}
+}
+
+static inline DWORD ConvertChannel(const PIXEL_CHANNEL *channel, DWORD color) {
+	DWORD value = (color & channel->srcMask) >> channel->srcShift;
+	return ((value >> channel->downShift) | ((value << channel->upShift) & channel->upMask)) << channel->dstShift;
+}
+
+static inline DWORD ConvertPixel(const PIXEL_CONVERTER *conv, DWORD color) {
+	return conv->dstAlpha // destination is opaque
+		| ConvertChannel(&conv->channels[0], color)
+		| ConvertChannel(&conv->channels[1], color)
+		| ConvertChannel(&conv->channels[2], color);
+}
+
+static bool IsByteChannel(DWORD mask) {
+	for( DWORD i = 0; i < 32; i += 8 ) {
+		if( (mask & (0xFF << i)) == mask ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void CompileConverter(PIXEL_CONVERTER *conv, LPDDPIXELFORMAT dstFormat, LPDDPIXELFORMAT srcFormat) {
+	COLOR_BIT_MASKS srcMask, dstMask;
+
+	WinVidGetColorBitMasks(&srcMask, srcFormat);
+	WinVidGetColorBitMasks(&dstMask, dstFormat);
+
+	GetFormatKey(conv->srcFormat, srcFormat);
+	GetFormatKey(conv->dstFormat, dstFormat);
+	conv->srcBpp = srcFormat->dwRGBBitCount / 8;
+	conv->dstBpp = dstFormat->dwRGBBitCount / 8;
+	conv->dstAlpha = dstMask.dwRGBAlphaBitMask;
+	CompileChannel(&conv->channels[0], srcMask.dwRBitMask, srcMask.dwRBitDepth, srcMask.dwRBitOffset, dstMask.dwRBitDepth, dstMask.dwRBitOffset);
+	CompileChannel(&conv->channels[1], srcMask.dwGBitMask, srcMask.dwGBitDepth, srcMask.dwGBitOffset, dstMask.dwGBitDepth, dstMask.dwGBitOffset);
+	CompileChannel(&conv->channels[2], srcMask.dwBBitMask, srcMask.dwBBitDepth, srcMask.dwBBitOffset, dstMask.dwBBitDepth, dstMask.dwBBitOffset);
+
+	if( conv->pixelLut != NULL ) {
+		free(conv->pixelLut);
+		conv->pixelLut = NULL;
+	}
+
+	// when every channel is inside of one byte, the bytes are converted independently
+	conv->isByteLut = IsByteChannel(srcMask.dwRBitMask) && IsByteChannel(srcMask.dwGBitMask) && IsByteChannel(srcMask.dwBBitMask);
+	if( conv->isByteLut ) {
+		for( DWORD i = 0; i < 4; ++i ) {
+			for( DWORD j = 0; j < 256; ++j ) {
+				DWORD color = j << (i * 8);
+				conv->byteLut[i][j] = ConvertChannel(&conv->channels[0], color)
+									| ConvertChannel(&conv->channels[1], color)
+									| ConvertChannel(&conv->channels[2], color);
+			}
+		}
+	}
+	conv->isValid = true;
+}
+
+static PIXEL_CONVERTER *GetConverter(LPDDPIXELFORMAT dstFormat, LPDDPIXELFORMAT srcFormat) {
+	DWORD srcKey[5], dstKey[5];
+
+	GetFormatKey(srcKey, srcFormat);
+	GetFormatKey(dstKey, dstFormat);
+	if( !Converter.isValid || memcmp(srcKey, Converter.srcFormat, sizeof(srcKey)) || memcmp(dstKey, Converter.dstFormat, sizeof(dstKey)) ) {
+		CompileConverter(&Converter, dstFormat, srcFormat);
+	}
+	return &Converter;
+}
+
+static void ConvertRectScalar(const PIXEL_CONVERTER *conv, BYTE *dstLine, int dstPitch, const BYTE *srcLine, int srcPitch, DWORD width, DWORD height) {
+	for( DWORD j = 0; j < height; ++j ) {
+		const BYTE *srcPtr = srcLine;
+		BYTE *dstPtr = dstLine;
+		for( DWORD i = 0; i < width; ++i ) {
+			DWORD color = 0;
+			memcpy(&color, srcPtr, conv->srcBpp);
+			color = ConvertPixel(conv, color);
+			memcpy(dstPtr, &color, conv->dstBpp);
+			srcPtr += conv->srcBpp;
+			dstPtr += conv->dstBpp;
+		}
+		srcLine += srcPitch;
+		dstLine += dstPitch;
+	}
+}
+
+static void ConvertRectPixelLut(const PIXEL_CONVERTER *conv, BYTE *dstLine, int dstPitch, const BYTE *srcLine, int srcPitch, DWORD width, DWORD height) {
+	for( DWORD j = 0; j < height; ++j ) {
+		const BYTE *srcPtr = srcLine;
+		BYTE *dstPtr = dstLine;
+		for( DWORD i = 0; i < width; ++i ) {
+			UINT16 color;
+			memcpy(&color, srcPtr, sizeof(color));
+			memcpy(dstPtr, &conv->pixelLut[color], conv->dstBpp);
+			srcPtr += sizeof(color);
+			dstPtr += conv->dstBpp;
+		}
+		srcLine += srcPitch;
+		dstLine += dstPitch;
+	}
+}
+
+static void ConvertRectByteLut(const PIXEL_CONVERTER *conv, BYTE *dstLine, int dstPitch, const BYTE *srcLine, int srcPitch, DWORD width, DWORD height) {
+	for( DWORD j = 0; j < height; ++j ) {
+		const BYTE *srcPtr = srcLine;
+		BYTE *dstPtr = dstLine;
+		for( DWORD i = 0; i < width; ++i ) {
+			DWORD color = conv->dstAlpha;
+			for( DWORD k = 0; k < conv->srcBpp; ++k ) {
+				color |= conv->byteLut[k][srcPtr[k]];
+			}
+			memcpy(dstPtr, &color, conv->dstBpp);
+			srcPtr += conv->srcBpp;
+			dstPtr += conv->dstBpp;
+		}
+		srcLine += srcPitch;
+		dstLine += dstPitch;
+	}
+}
+
+#ifdef FEATURE_BACKGROUND_IMPROVED
+bool SimdPixelEnabled = true;
+
+typedef struct PixelChannelSimd_t {
+	__m128i srcMask;
+	__m128i srcShift;
+	__m128i downShift;
+	__m128i upShift;
+	__m128i upMask;
+	__m128i dstShift;
+} PIXEL_CHANNEL_SIMD;
+
+SIMD_SSE2 static inline __m128i ConvertChannelSimd(__m128i color, const PIXEL_CHANNEL_SIMD *channel) {
+	__m128i value = _mm_srl_epi32(_mm_and_si128(color, channel->srcMask), channel->srcShift);
+	__m128i up = _mm_and_si128(_mm_sll_epi32(value, channel->upShift), channel->upMask);
+	value = _mm_or_si128(_mm_srl_epi32(value, channel->downShift), up);
+	return _mm_sll_epi32(value, channel->dstShift);
+}
+
+// Vectorised ConvertRectScalar() for 16 and 32 bit formats. It converts 8 pixels at once.
+SIMD_SSE2 static void ConvertRectSimd(const PIXEL_CONVERTER *conv, BYTE *dstLine, int dstPitch, const BYTE *srcLine, int srcPitch, DWORD width, DWORD height) {
+	PIXEL_CHANNEL_SIMD channels[3];
+	for( int i = 0; i < 3; ++i ) {
+		channels[i].srcMask = _mm_set1_epi32(conv->channels[i].srcMask);
+		channels[i].srcShift = _mm_cvtsi32_si128(conv->channels[i].srcShift);
+		channels[i].downShift = _mm_cvtsi32_si128(conv->channels[i].downShift);
+		channels[i].upShift = _mm_cvtsi32_si128(conv->channels[i].upShift);
+		channels[i].upMask = _mm_set1_epi32(conv->channels[i].upMask);
+		channels[i].dstShift = _mm_cvtsi32_si128(conv->channels[i].dstShift);
+	}
+	const __m128i alpha = _mm_set1_epi32(conv->dstAlpha);
+	const __m128i zero = _mm_setzero_si128();
+	DWORD blocks = width / 8;
+
+	for( DWORD j = 0; j < height; ++j ) {
+		const BYTE *srcPtr = srcLine;
+		BYTE *dstPtr = dstLine;
+		for( DWORD i = 0; i < blocks; ++i ) {
+			__m128i lo, hi;
+			if( conv->srcBpp == 2 ) {
+				__m128i pixels = _mm_loadu_si128((const __m128i *)srcPtr);
+				lo = _mm_unpacklo_epi16(pixels, zero);
+				hi = _mm_unpackhi_epi16(pixels, zero);
+				srcPtr += 16;
+			} else {
+				lo = _mm_loadu_si128((const __m128i *)srcPtr);
+				hi = _mm_loadu_si128((const __m128i *)(srcPtr + 16));
+				srcPtr += 32;
+			}
+			__m128i outLo = alpha, outHi = alpha;
+			for( int k = 0; k < 3; ++k ) {
+				outLo = _mm_or_si128(outLo, ConvertChannelSimd(lo, &channels[k]));
+				outHi = _mm_or_si128(outHi, ConvertChannelSimd(hi, &channels[k]));
+			}
+			if( conv->dstBpp == 2 ) {
+				// the low words are sign extended, so the signed packing keeps them as they are
+				outLo = _mm_srai_epi32(_mm_slli_epi32(outLo, 16), 16);
+				outHi = _mm_srai_epi32(_mm_slli_epi32(outHi, 16), 16);
+				_mm_storeu_si128((__m128i *)dstPtr, _mm_packs_epi32(outLo, outHi));
+				dstPtr += 16;
+			} else {
+				_mm_storeu_si128((__m128i *)dstPtr, outLo);
+				_mm_storeu_si128((__m128i *)(dstPtr + 16), outHi);
+				dstPtr += 32;
+			}
+		}
+		ConvertRectScalar(conv, dstPtr, dstPitch, srcPtr, srcPitch, width % 8, 1);
+		srcLine += srcPitch;
+		dstLine += dstPitch;
+	}
+}
+
+static bool IsSimdPixelAvailable() {
+	return ( SimdPixelEnabled && IsSse2Available() );
+}
+#endif // FEATURE_BACKGROUND_IMPROVED
+
+static bool IsPixelLutAvailable(PIXEL_CONVERTER *conv) {
+	if( conv->srcBpp != 2 ) {
+		return false;
+	}
+	if( conv->pixelLut == NULL ) {
+		conv->pixelLut = (DWORD *)malloc(sizeof(DWORD) * 0x10000);
+		if( conv->pixelLut == NULL ) {
+			return false;
+		}
+		for( DWORD i = 0; i < 0x10000; ++i ) {
+			conv->pixelLut[i] = ConvertPixel(conv, i);
+		}
+	}
+	return true;
+}
+
+void PixelConvertRect(LPDDSDESC dst, DWORD dstX, DWORD dstY, LPDDSDESC src, LPRECT srcRect) {
+	PIXEL_CONVERTER *conv = GetConverter(&dst->ddpfPixelFormat, &src->ddpfPixelFormat);
+
+	DWORD srcX = srcRect->left;
+	DWORD srcY = srcRect->top;
+	DWORD width = srcRect->right - srcRect->left;
+	DWORD height = srcRect->bottom - srcRect->top;
+
+	const BYTE *srcLine = (const BYTE *)src->lpSurface + srcY * src->lPitch  + srcX * conv->srcBpp;
+	BYTE *dstLine = (BYTE *)dst->lpSurface + dstY * dst->lPitch  + dstX * conv->dstBpp;
+
+#ifdef FEATURE_BACKGROUND_IMPROVED
+	if( (conv->srcBpp == 2 || conv->srcBpp == 4) && (conv->dstBpp == 2 || conv->dstBpp == 4) && IsSimdPixelAvailable() ) {
+		ConvertRectSimd(conv, dstLine, dst->lPitch, srcLine, src->lPitch, width, height);
+		return;
+	}
+#endif // FEATURE_BACKGROUND_IMPROVED
+	if( IsPixelLutAvailable(conv) ) {
+		ConvertRectPixelLut(conv, dstLine, dst->lPitch, srcLine, src->lPitch, width, height);
+	} else if( conv->isByteLut ) {
+		ConvertRectByteLut(conv, dstLine, dst->lPitch, srcLine, src->lPitch, width, height);
+	} else {
+		ConvertRectScalar(conv, dstLine, dst->lPitch, srcLine, src->lPitch, width, height);
+	}
+}
+
+void PixelConvertFree() {
+	if( Converter.pixelLut != NULL ) {
+		free(Converter.pixelLut);
+		Converter.pixelLut = NULL;
+	}
+	Converter.isValid = false;
+}
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global/precompiled.h"
+#include "modding/profiler.h"
+#include "game/text.h"
+#include "modding/file_utils.h"
+#include "specific/utils.h"
+#include "global/vars.h"
+
+#ifdef FEATURE_PROFILER
+#define PROFILER_EVENTS		(1024) // must be power of two
+#define PROFILER_FRAMES		(60)
+#define PROFILER_TRACE_PATH	".\\profiles"
+
+#define OVERLAY_X			(8)
+#define OVERLAY_Y			(24)
+#define OVERLAY_LINE		(14)
+
+typedef struct ProfileEvent_t {
+	double start;
+	double duration;
+} PROFILE_EVENT;
+
+// Every scope has its own ring of the latest events, so the frequent
+// scopes don't push the rare ones out of the trace
+typedef struct ProfileScopeInfo_t {
+	double enterTime;
+	double frameTime; // accumulated time of the current frame
+	double history[PROFILER_FRAMES];
+	DWORD eventCount;
+	PROFILE_EVENT events[PROFILER_EVENTS];
+} PROFILE_SCOPE_INFO;
+
+static LPCTSTR ProfileScopeNames[PROF_NumberOf] = {
+	"Frame",
+	"Control",
+	"Draw",
+	"DrawRooms",
+	"OutputPolyList",
+	"DrawPolyList",
+	"Sync",
+};
+
+static PROFILE_SCOPE_INFO ProfileScopes[PROF_NumberOf];
+static DWORD ProfileCounters[PROF_CounterNumberOf];
+
+static TEXT_STR_INFO *OverlayText[PROF_NumberOf + 4]; // the last lines are for the render, animation, LOS and room counters
+static bool IsOverlayEnabled = false;
+static bool IsFrameStarted = false;
+static DWORD FrameCount = 0;
+
+static void SetOverlayLine(int line, const char *str) {
+	if( OverlayText[line] == NULL ) {
+		OverlayText[line] = T_Print(OVERLAY_X, OVERLAY_Y + OVERLAY_LINE * line, 0, str);
+	} else {
+		T_ChangeText(OverlayText[line], str);
+	}
+}
+
+static void UpdateOverlay() {
+	char str[64];
+
+	for( int i = 0; i < PROF_NumberOf; ++i ) {
+		double sum = 0.0;
+		double max = 0.0;
+		DWORD count = MIN(FrameCount, PROFILER_FRAMES);
+		for( DWORD j = 0; j < count; ++j ) {
+			sum += ProfileScopes[i].history[j];
+			CLAMPL(max, ProfileScopes[i].history[j]);
+		}
+		snprintf(str, sizeof(str), "%s %.2f max %.2f", ProfileScopeNames[i],
+				 count ? sum * 1000.0 / count : 0.0, max * 1000.0);
+		SetOverlayLine(i, str);
+	}
+	DWORD *cnt = ProfileCounters;
+#ifdef FEATURE_RENDER_IMPROVED
+	if( SavedAppSettings.RenderMode == RM_Hardware ) {
+		snprintf(str, sizeof(str), "Draws %d States %d Binds %d",
+				 cnt[PROF_HwrDrawCalls], cnt[PROF_HwrStateChanges], cnt[PROF_HwrTexBinds]);
+		SetOverlayLine(PROF_NumberOf, str);
+	}
+	DWORD bones = cnt[PROF_AnimCacheHits] + cnt[PROF_AnimCacheMisses];
+	snprintf(str, sizeof(str), "Anim cache %d%% saved %.3f", bones ? cnt[PROF_AnimCacheHits] * 100 / bones : 0,
+			 cnt[PROF_AnimCacheSavedNs] / 1000000.0);
+	SetOverlayLine(PROF_NumberOf + 1, str);
+#endif // FEATURE_RENDER_IMPROVED
+	snprintf(str, sizeof(str), "LOS %d sectors %d", cnt[PROF_LosCalls], cnt[PROF_LosBoundaries]);
+	SetOverlayLine(PROF_NumberOf + 2, str);
+	snprintf(str, sizeof(str), "Rooms %d drawn %d reused %d%%", cnt[PROF_RoomWalkTraversed], cnt[PROF_RoomWalkDrawn],
+			 cnt[PROF_RoomWalkFrames] ? cnt[PROF_RoomWalkReused] * 100 / cnt[PROF_RoomWalkFrames] : 0);
+	SetOverlayLine(PROF_NumberOf + 3, str);
+}
+
+static void RemoveOverlay() {
+	for( DWORD i = 0; i < ARRAY_SIZE(OverlayText); ++i ) {
+		if( OverlayText[i] != NULL ) {
+			T_RemovePrint(OverlayText[i]);
+			OverlayText[i] = NULL;
+		}
+	}
+}
+
+void ProfilerEnter(PROFILE_SCOPE scope) {
+	ProfileScopes[scope].enterTime = UT_Microseconds();
+}
+
+void ProfilerLeave(PROFILE_SCOPE scope) {
+	PROFILE_SCOPE_INFO *info = &ProfileScopes[scope];
+	PROFILE_EVENT *event = &info->events[info->eventCount++ & (PROFILER_EVENTS - 1)];
+	event->start = info->enterTime;
+	event->duration = UT_Microseconds() - info->enterTime;
+	info->frameTime += event->duration;
+}
+
+void ProfilerFrame() {
+	if( IsFrameStarted ) {
+		ProfilerLeave(PROF_Frame);
+		DWORD index = FrameCount++ % PROFILER_FRAMES;
+		for( int i = 0; i < PROF_NumberOf; ++i ) {
+			ProfileScopes[i].history[index] = ProfileScopes[i].frameTime;
+			ProfileScopes[i].frameTime = 0.0;
+		}
+		if( IsOverlayEnabled ) {
+			UpdateOverlay();
+		}
+		memset(ProfileCounters, 0, sizeof(ProfileCounters));
+	}
+	IsFrameStarted = true;
+	ProfilerEnter(PROF_Frame);
+}
+
+void ProfilerCount(PROFILE_COUNTER counter, DWORD value) {
+	ProfileCounters[counter] += value;
+}
+
+void ProfilerToggleOverlay() {
+	IsOverlayEnabled = !IsOverlayEnabled;
+	if( !IsOverlayEnabled ) {
+		RemoveOverlay();
+	}
+}
+
+void ProfilerResetOverlay() {
+	// T_InitPrint() has already freed the texts, so just forget them
+	memset(OverlayText, 0, sizeof(OverlayText));
+}
+
+bool ProfilerDumpTrace() {
+	static SYSTEMTIME lastTime = {0, 0, 0, 0, 0, 0, 0, 0};
+	static int lastIndex = 0;
+	char fileName[MAX_PATH];
+	bool isFirst = true;
+
+	CreateDateTimeFilename(fileName, sizeof(fileName), PROFILER_TRACE_PATH, ".json", &lastTime, &lastIndex);
+	CreateDirectories(fileName, true);
+	FILE *fp = fopen(fileName, "wt");
+	if( fp == NULL ) {
+		return false;
+	}
+
+	// Chrome trace event format, the timestamps are in microseconds
+	fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	for( int i = 0; i < PROF_NumberOf; ++i ) {
+		PROFILE_SCOPE_INFO *info = &ProfileScopes[i];
+		DWORD count = MIN(info->eventCount, PROFILER_EVENTS);
+		for( DWORD j = info->eventCount - count; j != info->eventCount; ++j ) {
+			PROFILE_EVENT *event = &info->events[j & (PROFILER_EVENTS - 1)];
+			fprintf(fp, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+					isFirst ? "" : ",", ProfileScopeNames[i], event->start * 1000000.0, event->duration * 1000000.0);
+			isFirst = false;
+		}
+	}
+	fprintf(fp, "\n]}\n");
+	fclose(fp);
+	return true;
+}
+
+#endif // FEATURE_PROFILER
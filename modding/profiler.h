@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROFILER_H_INCLUDED
+#define PROFILER_H_INCLUDED
+
+#include "global/types.h"
+
+typedef enum {
+	PROF_Frame,
+	PROF_Control,
+	PROF_Draw,
+	PROF_DrawRooms,
+	PROF_OutputPolyList,
+	PROF_DrawPolyList,
+	PROF_Sync,
+	PROF_NumberOf,
+} PROFILE_SCOPE;
+
+// Per frame counters reported by the modules for the overlay
+typedef enum {
+	PROF_HwrDrawCalls,
+	PROF_HwrStateChanges,
+	PROF_HwrTexBinds,
+	PROF_AnimCacheHits,
+	PROF_AnimCacheMisses,
+	PROF_AnimCacheSavedNs, // estimated decoding time saved by the cache hits
+	PROF_LosCalls,
+	PROF_LosBoundaries,
+	PROF_RoomWalkFrames,
+	PROF_RoomWalkReused,
+	PROF_RoomWalkTraversed,
+	PROF_RoomWalkDrawn,
+	PROF_CounterNumberOf,
+} PROFILE_COUNTER;
+
+// Scoped timers for the frame breakdown and the counters. These macros
+// are empty when the profiler is compiled out, so the game code stays as is.
+#ifdef FEATURE_PROFILER
+#define PROFILE_ENTER(scope)			ProfilerEnter(scope)
+#define PROFILE_LEAVE(scope)			ProfilerLeave(scope)
+#define PROFILE_FRAME()					ProfilerFrame()
+#define PROFILE_COUNT(counter, value)	ProfilerCount(counter, value)
+#else // !FEATURE_PROFILER
+#define PROFILE_ENTER(scope)
+#define PROFILE_LEAVE(scope)
+#define PROFILE_FRAME()
+#define PROFILE_COUNT(counter, value)
+#endif // FEATURE_PROFILER
+
+/*
+ * Function list
+ */
+void ProfilerEnter(PROFILE_SCOPE scope);
+void ProfilerLeave(PROFILE_SCOPE scope);
+void ProfilerFrame();
+void ProfilerCount(PROFILE_COUNTER counter, DWORD value);
+
+void ProfilerToggleOverlay();
+void ProfilerResetOverlay();
+bool ProfilerDumpTrace();
+
+#endif // PROFILER_H_INCLUDED
@@ -0,0 +1,516 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global/precompiled.h"
+#include "modding/render_snapshot.h"
+#include "3dsystem/3d_gen.h"
+#include "modding/file_utils.h"
+#include "specific/output.h"
+#include "specific/screenshot.h"
+#include "specific/utils.h"
+#include "global/vars.h"
+
+#define SNAPSHOT_MAGIC		(0x50414E53) // "SNAP"
+#define SNAPSHOT_VERSION	(1)
+#define SNAPSHOT_PATH		".\\profiles"
+#define SNAPSHOT_EXT		".snap"
+#define SNAPSHOT_GOLDEN_EXT	".pcx"
+#define BENCHMARK_FRAMES	(100)
+
+typedef struct RenderSnapshotHeader_t {
+	DWORD magic;
+	DWORD version;
+	int level;
+	int screenWidth;
+	int screenHeight;
+	int winWidth;
+	int winHeight;
+	__int16 winMinX;
+	__int16 winMinY;
+	__int16 winMaxX;
+	__int16 winMaxY;
+	DWORD isWindowedVga;
+	DWORD surfaceCount;
+	DWORD info3dSize; // in 16 bit words
+} RENDER_SNAPSHOT_HEADER;
+
+// Sorted software poly list of one frame and the render state it depends on.
+// Textures are not stored, so the snapshot is valid for the same level only.
+typedef struct RenderSnapshot_t {
+	RENDER_SNAPSHOT_HEADER header;
+	RGB888 palette[256];
+	DEPTHQ_ENTRY depthQ[32];
+	GOURAUD_ENTRY gouraud[256];
+	DWORD *sortOffsets; // poly offsets in the info3d buffer, in the painter's order
+	__int16 *info3d;
+} RENDER_SNAPSHOT;
+
+// The game state replaced by the snapshot replay
+typedef struct RenderSnapshotState_t {
+	int screenWidth;
+	int screenHeight;
+	int winWidth;
+	int winHeight;
+	__int16 winMinX;
+	__int16 winMinY;
+	__int16 winMaxX;
+	__int16 winMaxY;
+	bool isWindowedVga;
+	DEPTHQ_ENTRY depthQ[32];
+	GOURAUD_ENTRY gouraud[256];
+} RENDER_SNAPSHOT_STATE;
+
+static bool IsSnapshotRequested = false;
+
+static void FreeSnapshot(RENDER_SNAPSHOT *snap) {
+	if( snap->sortOffsets != NULL ) {
+		delete[] snap->sortOffsets;
+	}
+	if( snap->info3d != NULL ) {
+		delete[] snap->info3d;
+	}
+	memset(snap, 0, sizeof(RENDER_SNAPSHOT));
+}
+
+static bool IsSnapshotValid(RENDER_SNAPSHOT_HEADER *header) {
+	return ( header->magic == SNAPSHOT_MAGIC && header->version == SNAPSHOT_VERSION &&
+			 header->screenWidth > 0 && header->screenHeight > 0 &&
+			 header->screenHeight <= (int)(ARRAY_SIZE(XBuffer) / 10) && // the same row limit as the XBuffer has
+			 header->winWidth > 0 && header->winHeight > 0 &&
+			 header->winMinX >= 0 && header->winMinX + header->winWidth <= header->screenWidth &&
+			 header->winMinY >= 0 && header->winMinY + header->winHeight <= header->screenHeight &&
+			 header->winMaxX == header->winWidth - 1 && header->winMaxY == header->winHeight - 1 &&
+			 header->surfaceCount <= ARRAY_SIZE(SortBuffer) &&
+			 header->info3dSize <= ARRAY_SIZE(Info3dBuffer) );
+}
+
+// Checks the poly layout the rasterizer expects and clamps polygon vertices
+// into the window, so a broken snapshot cannot draw outside the surface.
+// A valid snapshot is not changed by this.
+// Lines and sprites are clipped by the rasterizer itself.
+static bool FixSnapshotPoly(RENDER_SNAPSHOT *snap, DWORD offset) {
+	UINT16 *bufPtr = (UINT16 *)snap->info3d + offset;
+	DWORD bufSize = snap->header.info3dSize - offset;
+	DWORD ptSize, ptCount;
+	__int16 sprIdx, shade;
+
+	switch( (__int16)bufPtr[0] ) {
+		case POLY_GTmap :
+		case POLY_WGTmap :
+			ptSize = 5; // x, y, g, u, v
+			break;
+		case POLY_GTmap_persp :
+		case POLY_WGTmap_persp :
+			ptSize = 9; // x, y, g, and float rhw, u, v
+			break;
+		case POLY_flat :
+		case POLY_trans :
+			ptSize = 2; // x, y
+			break;
+		case POLY_gouraud :
+			ptSize = 3; // x, y, g
+			break;
+		case POLY_line :
+			return ( bufSize >= 6 ); // type, x0, y0, x1, y1, color
+		case POLY_sprite :
+			if( bufSize < 7 ) // type, x1, y1, x2, y2, sprite, shade
+				return false;
+			sprIdx = bufPtr[5];
+			shade = bufPtr[6];
+			return ( sprIdx >= 0 && sprIdx < (int)ARRAY_SIZE(PhdSpriteInfo) &&
+					 shade >= 0 && (shade >> 8) < (int)ARRAY_SIZE(DepthQTable) );
+		default :
+			return false;
+	}
+
+	// type, texture page or color, vertex count, vertices
+	if( bufSize < 3 ) {
+		return false;
+	}
+	ptCount = bufPtr[2];
+	if( ptCount < 3 || 3 + ptCount * ptSize > bufSize ) {
+		return false;
+	}
+	if( (__int16)bufPtr[0] <= POLY_WGTmap_persp && bufPtr[1] >= ARRAY_SIZE(TexturePageBuffer8) ) {
+		return false;
+	}
+	// the vertices are in surface coordinates, so the window offset is included
+	UINT16 maxX = snap->header.winMinX + snap->header.winMaxX;
+	UINT16 maxY = snap->header.winMinY + snap->header.winMaxY;
+	bufPtr += 3;
+	for( DWORD i = 0; i < ptCount; ++i, bufPtr += ptSize ) {
+		CLAMPG(bufPtr[0], maxX);
+		CLAMPG(bufPtr[1], maxY);
+	}
+	return true;
+}
+
+static bool SaveSnapshot(RENDER_SNAPSHOT *snap, LPCSTR fileName) {
+	FILE *fp = fopen(fileName, "wb");
+	if( fp == NULL ) {
+		return false;
+	}
+	bool result = ( fwrite(&snap->header, sizeof(snap->header), 1, fp) == 1 &&
+					fwrite(snap->palette, sizeof(snap->palette), 1, fp) == 1 &&
+					fwrite(snap->depthQ, sizeof(snap->depthQ), 1, fp) == 1 &&
+					fwrite(snap->gouraud, sizeof(snap->gouraud), 1, fp) == 1 &&
+					fwrite(snap->sortOffsets, sizeof(DWORD), snap->header.surfaceCount, fp) == snap->header.surfaceCount &&
+					fwrite(snap->info3d, sizeof(__int16), snap->header.info3dSize, fp) == snap->header.info3dSize );
+	fclose(fp);
+	if( !result ) {
+		DeleteFile(fileName);
+	}
+	return result;
+}
+
+static bool LoadSnapshot(RENDER_SNAPSHOT *snap, LPCSTR fileName) {
+	memset(snap, 0, sizeof(RENDER_SNAPSHOT));
+	FILE *fp = fopen(fileName, "rb");
+	if( fp == NULL ) {
+		return false;
+	}
+	if( fread(&snap->header, sizeof(snap->header), 1, fp) != 1 || !IsSnapshotValid(&snap->header) ) {
+		goto FAIL;
+	}
+	snap->sortOffsets = new DWORD[snap->header.surfaceCount + 1];
+	snap->info3d = new __int16[snap->header.info3dSize + 1];
+	if( snap->sortOffsets == NULL || snap->info3d == NULL ||
+		fread(snap->palette, sizeof(snap->palette), 1, fp) != 1 ||
+		fread(snap->depthQ, sizeof(snap->depthQ), 1, fp) != 1 ||
+		fread(snap->gouraud, sizeof(snap->gouraud), 1, fp) != 1 ||
+		fread(snap->sortOffsets, sizeof(DWORD), snap->header.surfaceCount, fp) != snap->header.surfaceCount ||
+		fread(snap->info3d, sizeof(__int16), snap->header.info3dSize, fp) != snap->header.info3dSize )
+	{
+		goto FAIL;
+	}
+	for( DWORD i = 0; i < snap->header.surfaceCount; ++i ) {
+		if( snap->sortOffsets[i] >= snap->header.info3dSize || !FixSnapshotPoly(snap, snap->sortOffsets[i]) ) {
+			goto FAIL;
+		}
+	}
+	fclose(fp);
+	return true;
+
+FAIL :
+	fclose(fp);
+	FreeSnapshot(snap);
+	return false;
+}
+
+static void ApplySnapshot(RENDER_SNAPSHOT *snap, RENDER_SNAPSHOT_STATE *saved) {
+	saved->screenWidth = PhdScreenWidth;
+	saved->screenHeight = PhdScreenHeight;
+	saved->winWidth = PhdWinWidth;
+	saved->winHeight = PhdWinHeight;
+	saved->winMinX = PhdWinMinX;
+	saved->winMinY = PhdWinMinY;
+	saved->winMaxX = PhdWinMaxX;
+	saved->winMaxY = PhdWinMaxY;
+	saved->isWindowedVga = GameVid_IsWindowedVga;
+	memcpy(saved->depthQ, DepthQTable, sizeof(saved->depthQ));
+	memcpy(saved->gouraud, GouraudTable, sizeof(saved->gouraud));
+
+	PhdScreenWidth = snap->header.screenWidth;
+	PhdScreenHeight = snap->header.screenHeight;
+	PhdWinWidth = snap->header.winWidth;
+	PhdWinHeight = snap->header.winHeight;
+	PhdWinMinX = snap->header.winMinX;
+	PhdWinMinY = snap->header.winMinY;
+	PhdWinMaxX = snap->header.winMaxX;
+	PhdWinMaxY = snap->header.winMaxY;
+	GameVid_IsWindowedVga = ( snap->header.isWindowedVga != 0 );
+	memcpy(DepthQTable, snap->depthQ, sizeof(snap->depthQ));
+	memcpy(GouraudTable, snap->gouraud, sizeof(snap->gouraud));
+
+	// the live poly list is rebuilt every frame, so it is safe to replace it here
+	memcpy(Info3dBuffer, snap->info3d, sizeof(__int16) * snap->header.info3dSize);
+	for( DWORD i = 0; i < snap->header.surfaceCount; ++i ) {
+		SortBuffer[i]._0 = (int)(Info3dBuffer + snap->sortOffsets[i]);
+	}
+	SurfaceCount = snap->header.surfaceCount;
+}
+
+static void RestoreSnapshotState(RENDER_SNAPSHOT_STATE *saved) {
+	PhdScreenWidth = saved->screenWidth;
+	PhdScreenHeight = saved->screenHeight;
+	PhdWinWidth = saved->winWidth;
+	PhdWinHeight = saved->winHeight;
+	PhdWinMinX = saved->winMinX;
+	PhdWinMinY = saved->winMinY;
+	PhdWinMaxX = saved->winMaxX;
+	PhdWinMaxY = saved->winMaxY;
+	GameVid_IsWindowedVga = saved->isWindowedVga;
+	memcpy(DepthQTable, saved->depthQ, sizeof(saved->depthQ));
+	memcpy(GouraudTable, saved->gouraud, sizeof(saved->gouraud));
+	SurfaceCount = 0;
+}
+
+static void DrawSnapshotFrame(NULL_SURFACE *surface) {
+	memset(surface->bitmap, 0, surface->width * surface->height);
+	phd_PrintPolyList(surface->bitmap);
+}
+
+static void GetGoldenFileName(LPSTR goldenName, DWORD goldenSize, LPCSTR snapName) {
+	snprintf(goldenName, goldenSize, "%s", snapName);
+	char *ext = PathFindExtension(goldenName);
+	snprintf(ext, goldenSize - (ext - goldenName), SNAPSHOT_GOLDEN_EXT);
+}
+
+// Returns the number of pixels that differ from the golden image, or -1 if it cannot be read
+static int CompareWithGolden(NULL_SURFACE *surface, LPCSTR goldenName) {
+	PCX_HEADER *header;
+	int result = -1;
+
+	HANDLE hFile = CreateFile(goldenName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if( hFile == INVALID_HANDLE_VALUE ) {
+		return -1;
+	}
+	DWORD bytesRead = 0;
+	DWORD pcxSize = GetFileSize(hFile, NULL);
+	BYTE *pcx = ( pcxSize > sizeof(PCX_HEADER) + sizeof(RGB888) * 256 && pcxSize != INVALID_FILE_SIZE ) ? new BYTE[pcxSize] : NULL;
+	BYTE *golden = new BYTE[surface->width * surface->height + 1];
+	if( pcx == NULL || golden == NULL ) {
+		goto CLEANUP;
+	}
+	if( !ReadFile(hFile, pcx, pcxSize, &bytesRead, NULL) || bytesRead != pcxSize ) {
+		goto CLEANUP;
+	}
+	header = (PCX_HEADER *)pcx;
+	if( (DWORD)(header->xMax - header->xMin + 1) != surface->width ||
+		(DWORD)(header->yMax - header->yMin + 1) != surface->height ||
+		!DecompPCX(pcx, pcxSize, golden, NULL) )
+	{
+		goto CLEANUP;
+	}
+	result = 0;
+	for( DWORD i = 0; i < surface->width * surface->height; ++i ) {
+		if( golden[i] != surface->bitmap[i] ) ++result;
+	}
+
+CLEANUP :
+	CloseHandle(hFile);
+	if( pcx != NULL ) delete[] pcx;
+	if( golden != NULL ) delete[] golden;
+	return result;
+}
+
+bool NullSurfaceCreate(NULL_SURFACE *surface, DWORD width, DWORD height) {
+	if( surface == NULL || width == 0 || height == 0 ) {
+		return false;
+	}
+	memset(surface, 0, sizeof(NULL_SURFACE));
+	surface->bitmap = new BYTE[width * height];
+	if( surface->bitmap == NULL ) {
+		return false;
+	}
+	surface->width = width;
+	surface->height = height;
+	memset(surface->bitmap, 0, width * height);
+	return true;
+}
+
+void NullSurfaceFree(NULL_SURFACE *surface) {
+	if( surface == NULL ) {
+		return;
+	}
+	if( surface->bitmap != NULL ) {
+		delete[] surface->bitmap;
+	}
+	memset(surface, 0, sizeof(NULL_SURFACE));
+}
+
+bool NullSurfaceSavePCX(NULL_SURFACE *surface, LPCSTR fileName) {
+	BYTE *pcxData = NULL;
+
+	if( surface == NULL || surface->bitmap == NULL ) {
+		return false;
+	}
+	DWORD pcxSize = CompPCX(surface->bitmap, surface->width, surface->height, surface->palette, &pcxData);
+	if( pcxSize == 0 || pcxData == NULL ) {
+		return false;
+	}
+	FILE *fp = fopen(fileName, "wb");
+	bool result = ( fp != NULL && fwrite(pcxData, pcxSize, 1, fp) == 1 );
+	if( fp != NULL ) {
+		fclose(fp);
+	}
+	GlobalFree(pcxData);
+	return result;
+}
+
+void RenderSnapshotRequest() {
+	IsSnapshotRequested = ( SavedAppSettings.RenderMode == RM_Software );
+}
+
+// Must be called after the poly list is sorted and before it is printed.
+// Saves the snapshot and its golden image drawn by the null surface backend.
+void RenderSnapshotCapture() {
+	static SYSTEMTIME lastTime = {0, 0, 0, 0, 0, 0, 0, 0};
+	static int lastIndex = 0;
+	RENDER_SNAPSHOT snap;
+	RENDER_SNAPSHOT_STATE saved;
+	NULL_SURFACE surface;
+	char fileName[MAX_PATH];
+	char goldenName[MAX_PATH];
+
+	if( !IsSnapshotRequested ) {
+		return;
+	}
+	IsSnapshotRequested = false;
+
+	memset(&snap, 0, sizeof(snap));
+	snap.header.magic = SNAPSHOT_MAGIC;
+	snap.header.version = SNAPSHOT_VERSION;
+	snap.header.level = CurrentLevel;
+	snap.header.screenWidth = PhdScreenWidth;
+	snap.header.screenHeight = PhdScreenHeight;
+	snap.header.winWidth = PhdWinWidth;
+	snap.header.winHeight = PhdWinHeight;
+	snap.header.winMinX = PhdWinMinX;
+	snap.header.winMinY = PhdWinMinY;
+	snap.header.winMaxX = PhdWinMaxX;
+	snap.header.winMaxY = PhdWinMaxY;
+	snap.header.isWindowedVga = GameVid_IsWindowedVga;
+	snap.header.surfaceCount = SurfaceCount;
+	snap.header.info3dSize = Info3dPtr - Info3dBuffer;
+	if( !IsSnapshotValid(&snap.header) ) {
+		return;
+	}
+	memcpy(snap.palette, GamePalette8, sizeof(snap.palette));
+	memcpy(snap.depthQ, DepthQTable, sizeof(snap.depthQ));
+	memcpy(snap.gouraud, GouraudTable, sizeof(snap.gouraud));
+
+	// keep a private copy, the replay below overwrites the live buffers
+	snap.sortOffsets = new DWORD[snap.header.surfaceCount + 1];
+	snap.info3d = new __int16[snap.header.info3dSize + 1];
+	if( snap.sortOffsets == NULL || snap.info3d == NULL ) {
+		FreeSnapshot(&snap);
+		return;
+	}
+	for( DWORD i = 0; i < snap.header.surfaceCount; ++i ) {
+		snap.sortOffsets[i] = (__int16 *)SortBuffer[i]._0 - Info3dBuffer;
+	}
+	memcpy(snap.info3d, Info3dBuffer, sizeof(__int16) * snap.header.info3dSize);
+
+	CreateDateTimeFilename(fileName, sizeof(fileName), SNAPSHOT_PATH, SNAPSHOT_EXT, &lastTime, &lastIndex);
+	CreateDirectories(fileName, true);
+	if( SaveSnapshot(&snap, fileName) &&
+		NullSurfaceCreate(&surface, snap.header.screenWidth, snap.header.screenHeight) )
+	{
+		memcpy(surface.palette, snap.palette, sizeof(surface.palette));
+		ApplySnapshot(&snap, &saved);
+		DrawSnapshotFrame(&surface);
+		RestoreSnapshotState(&saved);
+		GetGoldenFileName(goldenName, sizeof(goldenName), fileName);
+		NullSurfaceSavePCX(&surface, goldenName);
+		NullSurfaceFree(&surface);
+	}
+
+	// the replayed list is the same as the live one, so the caller prints it as usual
+	SurfaceCount = snap.header.surfaceCount;
+	FreeSnapshot(&snap);
+}
+
+// Replays every snapshot of the current level into the null surface.
+// Each frame is compared with its golden image and then timed, the report is
+// saved next to the snapshots. A missing golden image is created from the replay.
+bool RenderBenchmarkRun() {
+	static SYSTEMTIME lastTime = {0, 0, 0, 0, 0, 0, 0, 0};
+	static int lastIndex = 0;
+	WIN32_FIND_DATA findData;
+	RENDER_SNAPSHOT snap;
+	RENDER_SNAPSHOT_STATE saved;
+	NULL_SURFACE surface;
+	char pattern[MAX_PATH];
+	char fileName[MAX_PATH];
+	char goldenName[MAX_PATH];
+	char reportName[MAX_PATH];
+	DWORD total = 0, failed = 0;
+
+	if( SavedAppSettings.RenderMode != RM_Software ) {
+		return false;
+	}
+	CreateDateTimeFilename(reportName, sizeof(reportName), SNAPSHOT_PATH, ".txt", &lastTime, &lastIndex);
+	CreateDirectories(reportName, true);
+	FILE *fp = fopen(reportName, "wt");
+	if( fp == NULL ) {
+		return false;
+	}
+
+	snprintf(pattern, sizeof(pattern), "%s\\*%s", SNAPSHOT_PATH, SNAPSHOT_EXT);
+	HANDLE hFind = FindFirstFile(pattern, &findData);
+	if( hFind != INVALID_HANDLE_VALUE ) {
+		do {
+			snprintf(fileName, sizeof(fileName), "%s\\%s", SNAPSHOT_PATH, findData.cFileName);
+			if( !LoadSnapshot(&snap, fileName) ) {
+				fprintf(fp, "%s: cannot load\n", findData.cFileName);
+				continue;
+			}
+			if( snap.header.level != CurrentLevel ) {
+				fprintf(fp, "%s: skipped, level %d\n", findData.cFileName, snap.header.level);
+				FreeSnapshot(&snap);
+				continue;
+			}
+			if( !NullSurfaceCreate(&surface, snap.header.screenWidth, snap.header.screenHeight) ) {
+				FreeSnapshot(&snap);
+				continue;
+			}
+			memcpy(surface.palette, snap.palette, sizeof(surface.palette));
+			ApplySnapshot(&snap, &saved);
+
+			DrawSnapshotFrame(&surface);
+			GetGoldenFileName(goldenName, sizeof(goldenName), fileName);
+			int diff = CompareWithGolden(&surface, goldenName);
+			if( diff < 0 ) {
+				NullSurfaceSavePCX(&surface, goldenName);
+			}
+
+			double minTime = 0.0, sumTime = 0.0;
+			for( int i = 0; i < BENCHMARK_FRAMES; ++i ) {
+				double startTime = UT_Microseconds();
+				DrawSnapshotFrame(&surface);
+				double frameTime = UT_Microseconds() - startTime;
+				sumTime += frameTime;
+				if( i == 0 || frameTime < minTime ) minTime = frameTime;
+			}
+			RestoreSnapshotState(&saved);
+
+			fprintf(fp, "%s: %dx%d polys %d avg %.3f ms min %.3f ms ", findData.cFileName,
+					snap.header.screenWidth, snap.header.screenHeight, snap.header.surfaceCount,
+					sumTime * 1000.0 / BENCHMARK_FRAMES, minTime * 1000.0);
+			if( diff < 0 ) {
+				fprintf(fp, "golden created\n");
+			} else if( diff > 0 ) {
+				fprintf(fp, "FAILED %d pixels differ\n", diff);
+				++failed;
+			} else {
+				fprintf(fp, "OK\n");
+			}
+			++total;
+			NullSurfaceFree(&surface);
+			FreeSnapshot(&snap);
+		} while( FindNextFile(hFind, &findData) );
+		FindClose(hFind);
+	}
+	fprintf(fp, "Total %d snapshots, %d failed\n", total, failed);
+	fclose(fp);
+	return ( failed == 0 );
+}
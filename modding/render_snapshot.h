@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RENDER_SNAPSHOT_H_INCLUDED
+#define RENDER_SNAPSHOT_H_INCLUDED
+
+#include "global/types.h"
+
+// Null surface is a plain 8 bit bitmap in memory. The software renderer can
+// draw the poly list into it without DirectDraw, so the frames can be timed
+// and compared with golden images pixel by pixel.
+typedef struct NullSurface_t {
+	BYTE *bitmap;
+	DWORD width;
+	DWORD height;
+	RGB888 palette[256];
+} NULL_SURFACE;
+
+/*
+ * Function list
+ */
+bool NullSurfaceCreate(NULL_SURFACE *surface, DWORD width, DWORD height);
+void NullSurfaceFree(NULL_SURFACE *surface);
+bool NullSurfaceSavePCX(NULL_SURFACE *surface, LPCSTR fileName);
+
+void RenderSnapshotRequest();
+void RenderSnapshotCapture();
+bool RenderBenchmarkRun();
+
+#endif // RENDER_SNAPSHOT_H_INCLUDED
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global/precompiled.h"
+#include "modding/room_visibility.h"
+#include "global/vars.h"
+
+typedef struct RoomVisibilityEntry_t {
+	DOOR_INFOS *doors; // the flip map swaps the room data, so the doors tell the rooms apart
+	__int16 flags;
+	__int16 boundLeft;
+	__int16 boundRight;
+	__int16 boundTop;
+	__int16 boundBotom;
+	__int16 boundActive;
+	__int16 left;
+	__int16 right;
+	__int16 top;
+	__int16 bottom;
+} ROOM_VISIBILITY_ENTRY;
+
+typedef struct RoomVisibilityView_t {
+	ROOM_INFO *rooms;
+	__int16 roomID;
+	__int16 winMaxX;
+	__int16 winMaxY;
+	int winCenterX;
+	int winCenterY;
+	int persp;
+	int farZ;
+	int cameraX;
+	int cameraY;
+	int cameraZ;
+	PHD_MATRIX matrix;
+} ROOM_VISIBILITY_VIEW;
+
+static ROOM_VISIBILITY_VIEW LastView;
+static ROOM_VISIBILITY_ENTRY LastRooms[ARRAY_SIZE(DrawRoomsArray)];
+static __int16 LastDrawRooms[ARRAY_SIZE(DrawRoomsArray)];
+static int LastDrawRoomsCount = 0;
+static int LastOutsideLeft, LastOutsideTop, LastOutsideRight, LastOutsideBottom;
+static DWORD LastMidSort = 0;
+static bool IsLastViewValid = false;
+
+bool RoomWalkReuseEnabled = true;
+
+static void GetView(ROOM_VISIBILITY_VIEW *view, __int16 roomID) {
+	// the structure is compared as a whole, so the padding must be zeroed too
+	memset(view, 0, sizeof(ROOM_VISIBILITY_VIEW));
+	view->rooms = RoomInfo;
+	view->roomID = roomID;
+	view->winMaxX = PhdWinMaxX;
+	view->winMaxY = PhdWinMaxY;
+	view->winCenterX = PhdWinCenterX;
+	view->winCenterY = PhdWinCenterY;
+	view->persp = PhdPersp;
+	view->farZ = PhdFarZ;
+	view->cameraX = MatrixW2V._03;
+	view->cameraY = MatrixW2V._13;
+	view->cameraZ = MatrixW2V._23;
+	view->matrix = *PhdMatrixPtr;
+}
+
+bool RoomVisibilityRestore(__int16 roomID) {
+	ROOM_VISIBILITY_VIEW view;
+
+	if( !RoomWalkReuseEnabled || !IsLastViewValid ) {
+		return false;
+	}
+	GetView(&view, roomID);
+	if( memcmp(&view, &LastView, sizeof(ROOM_VISIBILITY_VIEW)) ) {
+		return false;
+	}
+	for( int i = 0; i < LastDrawRoomsCount; ++i ) {
+		ROOM_INFO *room = &RoomInfo[LastDrawRooms[i]];
+		if( room->doors != LastRooms[i].doors || room->flags != LastRooms[i].flags ) {
+			return false;
+		}
+	}
+
+	for( int i = 0; i < LastDrawRoomsCount; ++i ) {
+		ROOM_INFO *room = &RoomInfo[LastDrawRooms[i]];
+		ROOM_VISIBILITY_ENTRY *entry = &LastRooms[i];
+		room->boundLeft = entry->boundLeft;
+		room->boundRight = entry->boundRight;
+		room->boundTop = entry->boundTop;
+		room->boundBotom = entry->boundBotom;
+		room->boundActive = entry->boundActive;
+		room->left = entry->left;
+		room->right = entry->right;
+		room->top = entry->top;
+		room->bottom = entry->bottom;
+		DrawRoomsArray[i] = LastDrawRooms[i];
+	}
+	DrawRoomsCount = LastDrawRoomsCount;
+	OutsideLeft = LastOutsideLeft;
+	OutsideTop = LastOutsideTop;
+	OutsideRight = LastOutsideRight;
+	OutsideBottom = LastOutsideBottom;
+	MidSort = LastMidSort;
+	return true;
+}
+
+void RoomVisibilityStore(__int16 roomID) {
+	IsLastViewValid = false;
+	if( !RoomWalkReuseEnabled || DrawRoomsCount <= 0 || DrawRoomsCount > (int)ARRAY_SIZE(LastDrawRooms) ) {
+		return;
+	}
+	GetView(&LastView, roomID);
+	for( int i = 0; i < DrawRoomsCount; ++i ) {
+		ROOM_INFO *room = &RoomInfo[DrawRoomsArray[i]];
+		ROOM_VISIBILITY_ENTRY *entry = &LastRooms[i];
+		entry->doors = room->doors;
+		entry->flags = room->flags;
+		entry->boundLeft = room->boundLeft;
+		entry->boundRight = room->boundRight;
+		entry->boundTop = room->boundTop;
+		entry->boundBotom = room->boundBotom;
+		entry->boundActive = room->boundActive;
+		entry->left = room->left;
+		entry->right = room->right;
+		entry->top = room->top;
+		entry->bottom = room->bottom;
+		LastDrawRooms[i] = DrawRoomsArray[i];
+	}
+	LastDrawRoomsCount = DrawRoomsCount;
+	LastOutsideLeft = OutsideLeft;
+	LastOutsideTop = OutsideTop;
+	LastOutsideRight = OutsideRight;
+	LastOutsideBottom = OutsideBottom;
+	LastMidSort = MidSort;
+	IsLastViewValid = true;
+}
+
+void RoomVisibilityReset() {
+	IsLastViewValid = false;
+	LastDrawRoomsCount = 0;
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ROOM_VISIBILITY_H_INCLUDED
+#define ROOM_VISIBILITY_H_INCLUDED
+
+#include "global/types.h"
+
+// Room visibility keeps the result of the last portal walk: the room drawing
+// order, the screen bounds of each room and the outside window. When the next
+// frame has the same camera room, view matrix and viewport, and the walked rooms
+// are not flipped, the result is restored instead of walking the doors again.
+
+/*
+ * Function list
+ */
+bool RoomVisibilityRestore(__int16 roomID);
+void RoomVisibilityStore(__int16 roomID);
+void RoomVisibilityReset();
+
+#endif // ROOM_VISIBILITY_H_INCLUDED
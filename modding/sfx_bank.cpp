@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global/precompiled.h"
+#include "modding/sfx_bank.h"
+#include "specific/utils.h"
+#include "global/vars.h"
+
+#define SFX_INDEX_MAGIC		(0x49584653) // "SFXI"
+#define SFX_INDEX_VERSION	(1)
+#define SFX_INDEX_EXT		".idx"
+
+typedef struct SfxIndexHeader_t {
+	DWORD magic;
+	DWORD version;
+	DWORD fileSize;
+	FILETIME lastWrite;
+	DWORD count;
+} SFX_INDEX_HEADER;
+
+static bool IsWaveHeaderValid(const WAVEPCM_HEADER *header) {
+	return ( header->dwRiffChunkID == 0x46464952 && // "RIFF"
+			 header->dwFormat == 0x45564157 && // "WAVE"
+			 header->dwDataSubchunkID == 0x61746164 ); // "data"
+}
+
+static DWORD ScanSfxFile(FILE_VIEW *view, SFX_BANK_ENTRY *entries) {
+	DWORD count = 0;
+	const WAVEPCM_HEADER *header;
+
+	FileViewSeek(view, 0);
+	while( NULL != (header = (const WAVEPCM_HEADER *)FileViewPtr(view, sizeof(WAVEPCM_HEADER))) ) {
+		if( !IsWaveHeaderValid(header) ) {
+			break;
+		}
+		DWORD dataSize = (header->dwDataSubchunkSize + 1) & ~1; // aligned data size
+		DWORD dataOffset = FileViewTell(view);
+		if( !FileViewSkip(view, dataSize) ) {
+			// the last sample may be not aligned at the end of file
+			if( header->dwDataSubchunkSize > view->size - dataOffset ) break;
+			FileViewSeek(view, view->size);
+		}
+		if( entries != NULL ) {
+			SFX_BANK_ENTRY *entry = &entries[count];
+			entry->dataOffset = dataOffset;
+			entry->dataSize = dataSize;
+			entry->wFormatTag = header->wFormatTag;
+			entry->nChannels = header->nChannels;
+			entry->nSamplesPerSec = header->nSamplesPerSec;
+			entry->nAvgBytesPerSec = header->nAvgBytesPerSec;
+			entry->nBlockAlign = header->nBlockAlign;
+			entry->wBitsPerSample = header->wBitsPerSample;
+		}
+		++count;
+	}
+	return count;
+}
+
+static bool BuildSfxIndex(SFX_BANK *bank) {
+	DWORD count = ScanSfxFile(&bank->view, NULL);
+	if( count == 0 ) {
+		return false;
+	}
+	bank->entries = (SFX_BANK_ENTRY *)malloc(sizeof(SFX_BANK_ENTRY) * count);
+	if( bank->entries == NULL ) {
+		return false;
+	}
+	bank->count = ScanSfxFile(&bank->view, bank->entries);
+	return true;
+}
+
+static bool LoadSfxIndexCache(SFX_BANK *bank, LPCTSTR cacheName) {
+	SFX_INDEX_HEADER header;
+	DWORD bytesRead = 0;
+	bool result = false;
+
+	HANDLE hFile = CreateFile(cacheName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if( hFile == INVALID_HANDLE_VALUE ) {
+		return false;
+	}
+
+	if( !ReadFile(hFile, &header, sizeof(header), &bytesRead, NULL) || bytesRead != sizeof(header) ||
+		header.magic != SFX_INDEX_MAGIC || header.version != SFX_INDEX_VERSION ||
+		header.fileSize != bank->fileSize || CompareFileTime(&header.lastWrite, &bank->lastWrite) ||
+		header.count == 0 || header.count > bank->fileSize / sizeof(WAVEPCM_HEADER) )
+	{
+		goto CLEANUP;
+	}
+
+	bank->entries = (SFX_BANK_ENTRY *)malloc(sizeof(SFX_BANK_ENTRY) * header.count);
+	if( bank->entries == NULL ) {
+		goto CLEANUP;
+	}
+	if( !ReadFile(hFile, bank->entries, sizeof(SFX_BANK_ENTRY) * header.count, &bytesRead, NULL) ||
+		bytesRead != sizeof(SFX_BANK_ENTRY) * header.count )
+	{
+		free(bank->entries);
+		bank->entries = NULL;
+		goto CLEANUP;
+	}
+	bank->count = header.count;
+	result = true;
+
+CLEANUP :
+	CloseHandle(hFile);
+	return result;
+}
+
+static void SaveSfxIndexCache(SFX_BANK *bank, LPCTSTR cacheName) {
+	SFX_INDEX_HEADER header;
+	DWORD bytesWritten = 0;
+
+	header.magic = SFX_INDEX_MAGIC;
+	header.version = SFX_INDEX_VERSION;
+	header.fileSize = bank->fileSize;
+	header.lastWrite = bank->lastWrite;
+	header.count = bank->count;
+
+	// NOTE: the cache is optional, so if the data folder is read only we just keep the index in memory
+	HANDLE hFile = CreateFile(cacheName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if( hFile == INVALID_HANDLE_VALUE ) {
+		return;
+	}
+	if( !WriteFile(hFile, &header, sizeof(header), &bytesWritten, NULL) || bytesWritten != sizeof(header) ||
+		!WriteFile(hFile, bank->entries, sizeof(SFX_BANK_ENTRY) * bank->count, &bytesWritten, NULL) ||
+		bytesWritten != sizeof(SFX_BANK_ENTRY) * bank->count )
+	{
+		CloseHandle(hFile);
+		DeleteFile(cacheName);
+		return;
+	}
+	CloseHandle(hFile);
+}
+
+bool SfxBankOpen(SFX_BANK *bank, LPCTSTR fileName) {
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	char cacheName[MAX_PATH];
+
+	if( bank == NULL || fileName == NULL || !*fileName ) {
+		return false;
+	}
+	if( !GetFileAttributesEx(fileName, GetFileExInfoStandard, &attributes) ) {
+		return false;
+	}
+
+	// the index is already in memory and it is still valid, just map the file
+	if( bank->entries != NULL && !lstrcmpi(bank->fileName, fileName) &&
+		bank->fileSize == attributes.nFileSizeLow && !CompareFileTime(&bank->lastWrite, &attributes.ftLastWriteTime) )
+	{
+		bank->indexTime = 0.0;
+		return ( bank->view.data != NULL || FileViewOpen(&bank->view, fileName) );
+	}
+
+	SfxBankFree(bank);
+	strncpy(bank->fileName, fileName, sizeof(bank->fileName) - 1);
+	bank->fileSize = attributes.nFileSizeLow;
+	bank->lastWrite = attributes.ftLastWriteTime;
+	snprintf(cacheName, sizeof(cacheName), "%s%s", fileName, SFX_INDEX_EXT);
+
+	double startTime = UT_Microseconds();
+	if( !FileViewOpen(&bank->view, fileName) ) {
+		SfxBankFree(bank);
+		return false;
+	}
+	bank->isCached = LoadSfxIndexCache(bank, cacheName);
+	if( !bank->isCached ) {
+		if( !BuildSfxIndex(bank) ) {
+			SfxBankFree(bank);
+			return false;
+		}
+		SaveSfxIndexCache(bank, cacheName);
+	}
+	bank->indexTime = UT_Microseconds() - startTime;
+	return true;
+}
+
+void SfxBankClose(SFX_BANK *bank) {
+	// keep the index in memory for the next level, but release the file mapping
+	if( bank != NULL ) {
+		FileViewClose(&bank->view);
+	}
+}
+
+void SfxBankFree(SFX_BANK *bank) {
+	if( bank == NULL ) {
+		return;
+	}
+	FileViewClose(&bank->view);
+	free(bank->entries);
+	memset(bank, 0, sizeof(SFX_BANK));
+}
+
+LPCVOID SfxBankGetSample(SFX_BANK *bank, DWORD index, LPWAVEFORMATEX format, DWORD *dataSize) {
+	if( bank == NULL || bank->view.data == NULL || index >= bank->count ) {
+		return NULL;
+	}
+	SFX_BANK_ENTRY *entry = &bank->entries[index];
+	DWORD size = entry->dataSize;
+	if( entry->dataOffset > bank->view.size ) {
+		return NULL;
+	}
+	CLAMPG(size, bank->view.size - entry->dataOffset);
+
+	if( format != NULL ) {
+		format->wFormatTag = entry->wFormatTag;
+		format->nChannels = entry->nChannels;
+		format->nSamplesPerSec = entry->nSamplesPerSec;
+		format->nAvgBytesPerSec = entry->nAvgBytesPerSec;
+		format->nBlockAlign = entry->nBlockAlign;
+		format->wBitsPerSample = entry->wBitsPerSample;
+		format->cbSize = 0;
+	}
+	if( dataSize != NULL ) {
+		*dataSize = size;
+	}
+	return bank->view.data + entry->dataOffset;
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SFX_BANK_H_INCLUDED
+#define SFX_BANK_H_INCLUDED
+
+#include "global/types.h"
+#include "modding/file_view.h"
+
+typedef struct SfxBankEntry_t {
+	DWORD dataOffset;
+	DWORD dataSize; // aligned data size
+	UINT16 wFormatTag;
+	__int16 nChannels;
+	int nSamplesPerSec;
+	int nAvgBytesPerSec;
+	__int16 nBlockAlign;
+	UINT16 wBitsPerSample;
+} SFX_BANK_ENTRY;
+
+// SFX bank is an index of RIFF samples stored one by one in MAIN.SFX like files.
+// The index is built once per SFX file and cached on disk next to it.
+// The cache is valid while the SFX file size and modification time are the same.
+typedef struct SfxBank_t {
+	char fileName[MAX_PATH];
+	DWORD fileSize;
+	FILETIME lastWrite;
+	DWORD count;
+	SFX_BANK_ENTRY *entries;
+	FILE_VIEW view;
+	double indexTime; // how long it took to get the index (scan or cache load)
+	bool isCached; // the index was taken from the disk cache
+} SFX_BANK;
+
+/*
+ * Function list
+ */
+bool SfxBankOpen(SFX_BANK *bank, LPCTSTR fileName);
+void SfxBankClose(SFX_BANK *bank);
+void SfxBankFree(SFX_BANK *bank);
+LPCVOID SfxBankGetSample(SFX_BANK *bank, DWORD index, LPWAVEFORMATEX format, DWORD *dataSize);
+
+#endif // SFX_BANK_H_INCLUDED
@@ -0,0 +1,653 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global/precompiled.h"
+#include "modding/sound_mixer.h"
+#include "modding/cpu_utils.h"
+#include "modding/file_utils.h"
+#include "global/vars.h"
+#include <math.h>
+
+#ifdef FEATURE_AUDIO_IMPROVED
+#define MIXER_RATE				(44100)
+#define MIXER_PERIOD			(512) // frames mixed at once, must be a multiple of 4
+#define MIXER_BUFFER_PERIODS	(8) // the streaming buffer size
+#define MIXER_LATENCY_PERIODS	(3) // how far the mixed data goes ahead of the play cursor
+#define MIXER_SAMPLES			(256)
+#define MIXER_REPORT_PATH		".\\profiles"
+
+typedef struct MixerSample_t {
+	__int16 *data; // mono frames
+	DWORD length;
+	DWORD rate;
+} MIXER_SAMPLE;
+
+typedef struct MixerVoice_t {
+	volatile bool isPlaying;
+	bool isLooped;
+	bool isRamped; // the first period takes the target gains at once
+	DWORD sampleIdx;
+	DWORD position;
+	DWORD fraction; // 16 bit fraction of the position
+	DWORD step; // 16.16 sample frames per mixer frame
+	float gainL; // the gains at the end of the previous period
+	float gainR;
+	float targetL;
+	float targetR;
+} MIXER_VOICE;
+
+typedef struct MixerStats_t {
+	DWORD periods;
+	DWORD periodsLate; // the period took longer to mix than to play
+	double mixTimeSum;
+	double mixTimeMax;
+	DWORD voicesPeak;
+	DWORD voicesStolen;
+	DWORD voicesDropped;
+	DWORD underruns;
+} MIXER_STATS;
+
+bool SoundMixerEnabled = true;
+DWORD SoundMixerOutput = MIXOUT_DirectSound;
+
+static MIXER_SAMPLE Samples[MIXER_SAMPLES];
+static MIXER_VOICE Voices[MIXER_VOICES];
+static MIXER_STATS Stats;
+static CRITICAL_SECTION MixerLock;
+static bool IsMixerLockReady = false;
+static const MIXER_SINK *Sink = NULL;
+static HANDLE hMixerThread = NULL;
+static volatile bool IsMixerStopping = false;
+
+// Mixer thread buffers
+static float MonoBuffer[MIXER_PERIOD];
+static float MixBuffer[MIXER_PERIOD * 2];
+static __int16 OutBuffer[MIXER_PERIOD * 2];
+
+static double GetCurrentTicks() {
+	LARGE_INTEGER counter, frequency;
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+}
+
+/*
+ * DirectSound sink: the mixed periods go to one looped streaming buffer
+ */
+static LPDIRECTSOUND SinkDSound = NULL;
+static LPDIRECTSOUNDBUFFER StreamBuffer = NULL;
+static DWORD StreamSize = 0;
+static DWORD StreamOffset = 0;
+
+static void SetPcmFormat(WAVEFORMATEX *format, DWORD rate) {
+	memset(format, 0, sizeof(WAVEFORMATEX));
+	format->wFormatTag = WAVE_FORMAT_PCM;
+	format->nChannels = 2;
+	format->nSamplesPerSec = rate;
+	format->wBitsPerSample = 16;
+	format->nBlockAlign = 4;
+	format->nAvgBytesPerSec = rate * 4;
+}
+
+static bool StreamWrite(const void *data, DWORD offset, DWORD size) {
+	LPVOID ptr1, ptr2;
+	DWORD size1, size2;
+	HRESULT rc = StreamBuffer->Lock(offset, size, &ptr1, &size1, &ptr2, &size2, 0);
+	if( rc == DSERR_BUFFERLOST ) {
+		StreamBuffer->Restore();
+		rc = StreamBuffer->Lock(offset, size, &ptr1, &size1, &ptr2, &size2, 0);
+	}
+	if FAILED(rc) {
+		return false;
+	}
+	if( data == NULL ) {
+		memset(ptr1, 0, size1);
+		if( ptr2 != NULL ) memset(ptr2, 0, size2);
+	} else {
+		memcpy(ptr1, data, size1);
+		if( ptr2 != NULL ) memcpy(ptr2, (const BYTE *)data + size1, size2);
+	}
+	StreamBuffer->Unlock(ptr1, size1, ptr2, size2);
+	return true;
+}
+
+static bool DSoundSinkOpen(DWORD rate) {
+	WAVEFORMATEX format;
+	DSBUFFERDESC desc;
+	LPDIRECTSOUNDBUFFER primary = NULL;
+
+	if( SinkDSound == NULL ) {
+		return false;
+	}
+	SetPcmFormat(&format, rate);
+	// the old systems resample everything to the primary buffer format
+	memset(&desc, 0, sizeof(desc));
+	desc.dwSize = sizeof(desc);
+	desc.dwFlags = DSBCAPS_PRIMARYBUFFER;
+	if SUCCEEDED(SinkDSound->CreateSoundBuffer(&desc, &primary, NULL)) {
+		primary->SetFormat(&format);
+		primary->Release();
+	}
+
+	StreamSize = MIXER_PERIOD * MIXER_BUFFER_PERIODS * 4;
+	StreamOffset = 0;
+	desc.dwFlags = DSBCAPS_GETCURRENTPOSITION2;
+	desc.dwBufferBytes = StreamSize;
+	desc.lpwfxFormat = &format;
+	if FAILED(SinkDSound->CreateSoundBuffer(&desc, &StreamBuffer, NULL)) {
+		StreamBuffer = NULL;
+		return false;
+	}
+	if( !StreamWrite(NULL, 0, StreamSize) || FAILED(StreamBuffer->Play(0, 0, DSBPLAY_LOOPING)) ) {
+		StreamBuffer->Release();
+		StreamBuffer = NULL;
+		return false;
+	}
+	return true;
+}
+
+static void DSoundSinkClose() {
+	if( StreamBuffer != NULL ) {
+		StreamBuffer->Stop();
+		StreamBuffer->Release();
+		StreamBuffer = NULL;
+	}
+}
+
+static DWORD DSoundSinkWait() {
+	DWORD playCursor, writeCursor;
+	DWORD latency = MIXER_PERIOD * MIXER_LATENCY_PERIODS * 4;
+
+	Sleep(MIXER_PERIOD * 1000 / MIXER_RATE / 2);
+	HRESULT rc = StreamBuffer->GetCurrentPosition(&playCursor, &writeCursor);
+	if( rc == DSERR_BUFFERLOST ) {
+		if SUCCEEDED(StreamBuffer->Restore()) {
+			StreamBuffer->Play(0, 0, DSBPLAY_LOOPING);
+		}
+		return 0;
+	}
+	if FAILED(rc) {
+		return 0;
+	}
+	DWORD ahead = (StreamOffset + StreamSize - playCursor) % StreamSize;
+	if( ahead > latency + MIXER_PERIOD * 4 ) {
+		// the play cursor has overtaken the mixed data, so we start over from the write cursor
+		++Stats.underruns;
+		StreamOffset = writeCursor & ~3;
+		ahead = (StreamOffset + StreamSize - playCursor) % StreamSize;
+	}
+	return ( ahead < latency ) ? (latency - ahead) / 4 : 0;
+}
+
+static bool DSoundSinkWrite(const __int16 *data, DWORD frames) {
+	if( !StreamWrite(data, StreamOffset, frames * 4) ) {
+		return false;
+	}
+	StreamOffset = (StreamOffset + frames * 4) % StreamSize;
+	return true;
+}
+
+static const MIXER_SINK DSoundSink = {DSoundSinkOpen, DSoundSinkClose, DSoundSinkWait, DSoundSinkWrite};
+
+/*
+ * Real time sinks: the periods are taken by the clock, and written to a WAV file or dropped
+ */
+static FILE *WaveFile = NULL;
+static DWORD WaveDataSize = 0;
+static double RealtimeStart = 0.0;
+static DWORD RealtimeFrames = 0;
+
+static bool NullSinkOpen(DWORD rate) {
+	RealtimeStart = GetCurrentTicks();
+	RealtimeFrames = 0;
+	return true;
+}
+
+static void NullSinkClose() {
+}
+
+static DWORD RealtimeSinkWait() {
+	Sleep(MIXER_PERIOD * 1000 / MIXER_RATE / 2);
+	DWORD due = (DWORD)((GetCurrentTicks() - RealtimeStart) * MIXER_RATE);
+	return ( due > RealtimeFrames ) ? due - RealtimeFrames : 0;
+}
+
+static bool NullSinkWrite(const __int16 *data, DWORD frames) {
+	RealtimeFrames += frames;
+	return true;
+}
+
+static void PutWaveHeader(DWORD rate, DWORD dataSize) {
+	WAVEFORMATEX format;
+	DWORD riffSize = 36 + dataSize;
+	DWORD fmtSize = 16;
+
+	SetPcmFormat(&format, rate);
+	fseek(WaveFile, 0, SEEK_SET);
+	fwrite("RIFF", 4, 1, WaveFile);
+	fwrite(&riffSize, 4, 1, WaveFile);
+	fwrite("WAVEfmt ", 8, 1, WaveFile);
+	fwrite(&fmtSize, 4, 1, WaveFile);
+	fwrite(&format, fmtSize, 1, WaveFile); // PCM format has no cbSize field
+	fwrite("data", 4, 1, WaveFile);
+	fwrite(&dataSize, 4, 1, WaveFile);
+}
+
+static bool WaveSinkOpen(DWORD rate) {
+	static SYSTEMTIME lastTime = {0, 0, 0, 0, 0, 0, 0, 0};
+	static int lastIndex = 0;
+	char fileName[MAX_PATH];
+
+	CreateDateTimeFilename(fileName, sizeof(fileName), MIXER_REPORT_PATH, ".wav", &lastTime, &lastIndex);
+	CreateDirectories(fileName, true);
+	WaveFile = fopen(fileName, "wb");
+	if( WaveFile == NULL ) {
+		return false;
+	}
+	WaveDataSize = 0;
+	PutWaveHeader(rate, 0); // the sizes are set on close
+	return NullSinkOpen(rate);
+}
+
+static void WaveSinkClose() {
+	if( WaveFile != NULL ) {
+		PutWaveHeader(MIXER_RATE, WaveDataSize);
+		fclose(WaveFile);
+		WaveFile = NULL;
+	}
+}
+
+static bool WaveSinkWrite(const __int16 *data, DWORD frames) {
+	RealtimeFrames += frames;
+	if( fwrite(data, 4, frames, WaveFile) != frames ) {
+		return false;
+	}
+	WaveDataSize += frames * 4;
+	return true;
+}
+
+static const MIXER_SINK WaveSink = {WaveSinkOpen, WaveSinkClose, RealtimeSinkWait, WaveSinkWrite};
+static const MIXER_SINK NullSink = {NullSinkOpen, NullSinkClose, RealtimeSinkWait, NullSinkWrite};
+
+/*
+ * Mixing
+ */
+// Linear interpolation resampler. Returns the number of frames, it is less
+// than the period if the sample is over.
+static int ResampleVoice(MIXER_VOICE *voice, float *mono) {
+	MIXER_SAMPLE *sample = &Samples[voice->sampleIdx];
+	const __int16 *data = sample->data;
+	DWORD length = sample->length;
+	DWORD position = voice->position;
+	DWORD fraction = voice->fraction;
+	int i;
+
+	for( i = 0; i < MIXER_PERIOD; ++i ) {
+		if( position >= length ) {
+			if( !voice->isLooped ) break;
+			position %= length;
+		}
+		int a = data[position];
+		int b = ( position + 1 < length ) ? data[position + 1] : ( voice->isLooped ? data[0] : 0 );
+		mono[i] = (float)(a + (((b - a) * (int)fraction) >> 16));
+		fraction += voice->step;
+		position += fraction >> 16;
+		fraction &= 0xFFFF;
+	}
+	voice->position = position;
+	voice->fraction = fraction;
+	return i;
+}
+
+// The gains go linearly from the previous ones to the target ones during the period,
+// so the volume and pan changes do not click
+static void AccumulateVoice(const float *mono, int count, float gainL, float gainR, float stepL, float stepR) {
+	for( int i = 0; i < count; ++i ) {
+		MixBuffer[i * 2 + 0] += mono[i] * gainL;
+		MixBuffer[i * 2 + 1] += mono[i] * gainR;
+		gainL += stepL;
+		gainR += stepR;
+	}
+}
+
+SIMD_SSE2 static void AccumulateVoiceSimd(const float *mono, int count, float gainL, float gainR, float stepL, float stepR) {
+	__m128 vecL = _mm_setr_ps(gainL, gainL + stepL, gainL + stepL * 2, gainL + stepL * 3);
+	__m128 vecR = _mm_setr_ps(gainR, gainR + stepR, gainR + stepR * 2, gainR + stepR * 3);
+	const __m128 step4L = _mm_set1_ps(stepL * 4);
+	const __m128 step4R = _mm_set1_ps(stepR * 4);
+	int blocks = count / 4;
+
+	for( int i = 0; i < blocks * 4; i += 4 ) {
+		__m128 samples = _mm_loadu_ps(&mono[i]);
+		__m128 left = _mm_mul_ps(samples, vecL);
+		__m128 right = _mm_mul_ps(samples, vecR);
+		// interleave to L0 R0 L1 R1 and L2 R2 L3 R3
+		__m128 *dst = (__m128 *)&MixBuffer[i * 2];
+		_mm_storeu_ps((float *)&dst[0], _mm_add_ps(_mm_loadu_ps((float *)&dst[0]), _mm_unpacklo_ps(left, right)));
+		_mm_storeu_ps((float *)&dst[1], _mm_add_ps(_mm_loadu_ps((float *)&dst[1]), _mm_unpackhi_ps(left, right)));
+		vecL = _mm_add_ps(vecL, step4L);
+		vecR = _mm_add_ps(vecR, step4R);
+	}
+	gainL += stepL * blocks * 4;
+	gainR += stepR * blocks * 4;
+	for( int i = blocks * 4; i < count; ++i ) {
+		MixBuffer[i * 2 + 0] += mono[i] * gainL;
+		MixBuffer[i * 2 + 1] += mono[i] * gainR;
+		gainL += stepL;
+		gainR += stepR;
+	}
+}
+
+static void ConvertOutput() {
+	for( int i = 0; i < MIXER_PERIOD * 2; ++i ) {
+		float value = MixBuffer[i];
+		CLAMP(value, -32768.0f, 32767.0f);
+		OutBuffer[i] = (__int16)lrintf(value);
+	}
+}
+
+SIMD_SSE2 static void ConvertOutputSimd() {
+	// the saturating pack clamps the values to 16 bit
+	for( int i = 0; i < MIXER_PERIOD * 2; i += 8 ) {
+		__m128i lo = _mm_cvtps_epi32(_mm_loadu_ps(&MixBuffer[i]));
+		__m128i hi = _mm_cvtps_epi32(_mm_loadu_ps(&MixBuffer[i + 4]));
+		_mm_storeu_si128((__m128i *)&OutBuffer[i], _mm_packs_epi32(lo, hi));
+	}
+}
+
+static void MixPeriod() {
+	bool isSimd = IsSse2Available();
+	DWORD voicesCount = 0;
+
+	memset(MixBuffer, 0, sizeof(MixBuffer));
+	EnterCriticalSection(&MixerLock);
+	for( int i = 0; i < MIXER_VOICES; ++i ) {
+		MIXER_VOICE *voice = &Voices[i];
+		if( !voice->isPlaying ) {
+			continue;
+		}
+		++voicesCount;
+		if( !voice->isRamped ) {
+			voice->gainL = voice->targetL;
+			voice->gainR = voice->targetR;
+			voice->isRamped = true;
+		}
+		int count = ResampleVoice(voice, MonoBuffer);
+		float stepL = (voice->targetL - voice->gainL) / MIXER_PERIOD;
+		float stepR = (voice->targetR - voice->gainR) / MIXER_PERIOD;
+		if( isSimd ) {
+			AccumulateVoiceSimd(MonoBuffer, count, voice->gainL, voice->gainR, stepL, stepR);
+		} else {
+			AccumulateVoice(MonoBuffer, count, voice->gainL, voice->gainR, stepL, stepR);
+		}
+		voice->gainL = voice->targetL;
+		voice->gainR = voice->targetR;
+		if( count < MIXER_PERIOD ) {
+			voice->isPlaying = false;
+		}
+	}
+	LeaveCriticalSection(&MixerLock);
+	CLAMPL(Stats.voicesPeak, voicesCount);
+
+	if( isSimd ) {
+		ConvertOutputSimd();
+	} else {
+		ConvertOutput();
+	}
+}
+
+static DWORD WINAPI MixerTask(CONST LPVOID lpParam) {
+	const double periodTime = (double)MIXER_PERIOD / MIXER_RATE;
+
+	while( !IsMixerStopping ) {
+		for( DWORD frames = Sink->wait(); frames >= MIXER_PERIOD && !IsMixerStopping; frames -= MIXER_PERIOD ) {
+			double startTime = GetCurrentTicks();
+			MixPeriod();
+			double mixTime = GetCurrentTicks() - startTime;
+			++Stats.periods;
+			Stats.mixTimeSum += mixTime;
+			CLAMPL(Stats.mixTimeMax, mixTime);
+			if( mixTime > periodTime ) {
+				++Stats.periodsLate;
+			}
+			if( !Sink->write(OutBuffer, MIXER_PERIOD) ) {
+				break;
+			}
+		}
+	}
+	ExitThread(0);
+}
+
+static void SetVoiceGains(MIXER_VOICE *voice, int volume, int pan) {
+	// DirectSound units: hundredths of decibel of attenuation
+	float gain = ( volume <= DSBVOLUME_MIN ) ? 0.0f : (float)pow(10.0, (double)volume / 2000.0);
+	voice->targetL = ( pan > 0 ) ? gain * (float)pow(10.0, (double)-pan / 2000.0) : gain;
+	voice->targetR = ( pan < 0 ) ? gain * (float)pow(10.0, (double)pan / 2000.0) : gain;
+}
+
+static void SetVoicePitch(MIXER_VOICE *voice, DWORD pitch) {
+	// the sample frequency is multiplied by pitch/PHD_ONE, the step is in 16.16 format
+	voice->step = (DWORD)((unsigned __int64)Samples[voice->sampleIdx].rate * pitch / MIXER_RATE);
+}
+
+/*
+ * Public functions
+ */
+bool IsMixerActive() {
+	return ( hMixerThread != NULL );
+}
+
+bool MixerStart(LPDIRECTSOUND dsound) {
+	static const MIXER_SINK *sinks[] = {&DSoundSink, &WaveSink, &NullSink};
+
+	if( IsMixerActive() ) {
+		return true;
+	}
+	if( !IsMixerLockReady ) {
+		InitializeCriticalSection(&MixerLock);
+		IsMixerLockReady = true;
+	}
+	memset(Voices, 0, sizeof(Voices));
+	memset(&Stats, 0, sizeof(Stats));
+	SinkDSound = dsound;
+	Sink = sinks[MIN(SoundMixerOutput, ARRAY_SIZE(sinks) - 1)];
+	if( !Sink->open(MIXER_RATE) ) {
+		return false;
+	}
+	IsMixerStopping = false;
+	hMixerThread = CreateThread(NULL, 0, &MixerTask, NULL, 0, NULL);
+	if( hMixerThread == NULL ) {
+		Sink->close();
+		return false;
+	}
+	SetThreadPriority(hMixerThread, THREAD_PRIORITY_HIGHEST);
+	return true;
+}
+
+void MixerStop() {
+	if( !IsMixerActive() ) {
+		return;
+	}
+	IsMixerStopping = true;
+	WaitForSingleObject(hMixerThread, INFINITE);
+	CloseHandle(hMixerThread);
+	hMixerThread = NULL;
+	Sink->close();
+	SinkDSound = NULL;
+	MixerFreeAllSamples();
+}
+
+bool MixerMakeSample(DWORD sampleIdx, LPWAVEFORMATEX format, LPCVOID data, DWORD dataSize) {
+	if( sampleIdx >= MIXER_SAMPLES || format == NULL || data == NULL || format->wFormatTag != WAVE_FORMAT_PCM ||
+		(format->wBitsPerSample != 8 && format->wBitsPerSample != 16) || format->nChannels < 1 )
+	{
+		return false;
+	}
+	int channels = format->nChannels;
+	int bytes = format->wBitsPerSample / 8;
+	DWORD length = dataSize / (bytes * channels);
+	__int16 *mono = (__int16 *)malloc(sizeof(__int16) * MAX(length, 1));
+	if( mono == NULL ) {
+		return false;
+	}
+	// the samples are stored as 16 bit mono, the stereo ones are downmixed
+	for( DWORD i = 0; i < length; ++i ) {
+		int sum = 0;
+		for( int j = 0; j < channels; ++j ) {
+			if( bytes == 1 ) {
+				sum += (((const BYTE *)data)[i * channels + j] - 0x80) << 8;
+			} else {
+				sum += ((const __int16 *)data)[i * channels + j];
+			}
+		}
+		mono[i] = sum / channels;
+	}
+
+	EnterCriticalSection(&MixerLock);
+	for( int i = 0; i < MIXER_VOICES; ++i ) {
+		if( Voices[i].sampleIdx == sampleIdx ) {
+			Voices[i].isPlaying = false;
+		}
+	}
+	free(Samples[sampleIdx].data);
+	Samples[sampleIdx].data = mono;
+	Samples[sampleIdx].length = length;
+	Samples[sampleIdx].rate = format->nSamplesPerSec;
+	LeaveCriticalSection(&MixerLock);
+	return true;
+}
+
+void MixerFreeAllSamples() {
+	if( !IsMixerLockReady ) {
+		return;
+	}
+	EnterCriticalSection(&MixerLock);
+	for( int i = 0; i < MIXER_VOICES; ++i ) {
+		Voices[i].isPlaying = false;
+	}
+	for( int i = 0; i < MIXER_SAMPLES; ++i ) {
+		free(Samples[i].data);
+	}
+	memset(Samples, 0, sizeof(Samples));
+	LeaveCriticalSection(&MixerLock);
+}
+
+int MixerPlaySample(DWORD sampleIdx, int volume, DWORD pitch, int pan, bool isLooped) {
+	if( sampleIdx >= MIXER_SAMPLES || Samples[sampleIdx].data == NULL || Samples[sampleIdx].length == 0 ) {
+		return -2;
+	}
+	MIXER_VOICE voice;
+	memset(&voice, 0, sizeof(voice));
+	voice.sampleIdx = sampleIdx;
+	voice.isLooped = isLooped;
+	SetVoiceGains(&voice, volume, pan);
+	SetVoicePitch(&voice, pitch);
+
+	int index = -1;
+	EnterCriticalSection(&MixerLock);
+	for( int i = 0; i < MIXER_VOICES; ++i ) {
+		if( !Voices[i].isPlaying ) {
+			index = i;
+			break;
+		}
+	}
+	if( index < 0 ) {
+		// all voices are busy, so the quietest one shot sound gives way, if it is not louder
+		float newGain = MAX(voice.targetL, voice.targetR);
+		for( int i = 0; i < MIXER_VOICES; ++i ) {
+			float gain = MAX(Voices[i].targetL, Voices[i].targetR);
+			if( !Voices[i].isLooped && gain <= newGain ) {
+				index = i;
+				newGain = gain;
+			}
+		}
+		if( index < 0 ) {
+			++Stats.voicesDropped;
+		} else {
+			++Stats.voicesStolen;
+		}
+	}
+	if( index >= 0 ) {
+		voice.isPlaying = true;
+		Voices[index] = voice;
+	}
+	LeaveCriticalSection(&MixerLock);
+	return index;
+}
+
+bool MixerIsVoicePlaying(int voice) {
+	return ( voice >= 0 && voice < MIXER_VOICES && Voices[voice].isPlaying );
+}
+
+void MixerAdjustVolumeAndPan(int voice, int volume, int pan) {
+	if( voice >= 0 && voice < MIXER_VOICES ) {
+		EnterCriticalSection(&MixerLock);
+		SetVoiceGains(&Voices[voice], volume, pan);
+		LeaveCriticalSection(&MixerLock);
+	}
+}
+
+void MixerAdjustPitch(int voice, DWORD pitch) {
+	if( voice >= 0 && voice < MIXER_VOICES ) {
+		EnterCriticalSection(&MixerLock);
+		SetVoicePitch(&Voices[voice], pitch);
+		LeaveCriticalSection(&MixerLock);
+	}
+}
+
+void MixerStopSample(int voice) {
+	if( voice >= 0 && voice < MIXER_VOICES ) {
+		Voices[voice].isPlaying = false;
+	}
+}
+
+void MixerStopAllSamples() {
+	for( int i = 0; i < MIXER_VOICES; ++i ) {
+		Voices[i].isPlaying = false;
+	}
+}
+
+bool MixerDumpReport() {
+	static LPCTSTR outputNames[] = {"DirectSound", "WAV file", "null"};
+	static SYSTEMTIME lastTime = {0, 0, 0, 0, 0, 0, 0, 0};
+	static int lastIndex = 0;
+	char fileName[MAX_PATH];
+
+	if( !IsMixerActive() ) {
+		return false;
+	}
+	CreateDateTimeFilename(fileName, sizeof(fileName), MIXER_REPORT_PATH, "_mixer.txt", &lastTime, &lastIndex);
+	CreateDirectories(fileName, true);
+	FILE *fp = fopen(fileName, "wt");
+	if( fp == NULL ) {
+		return false;
+	}
+	fprintf(fp, "Sound mixer: %s, %d Hz, %d frames per period, %s\n", outputNames[MIN(SoundMixerOutput, ARRAY_SIZE(outputNames) - 1)],
+			MIXER_RATE, MIXER_PERIOD, IsSse2Available() ? "SSE2" : "scalar");
+	fprintf(fp, "Periods %lu, avg mix %.3f ms, max mix %.3f ms, late %lu, underruns %lu\n",
+			Stats.periods, Stats.periods ? Stats.mixTimeSum * 1000.0 / Stats.periods : 0.0,
+			Stats.mixTimeMax * 1000.0, Stats.periodsLate, Stats.underruns);
+	fprintf(fp, "Voices %d, peak %lu, stolen %lu, dropped %lu\n",
+			MIXER_VOICES, Stats.voicesPeak, Stats.voicesStolen, Stats.voicesDropped);
+	fclose(fp);
+	return true;
+}
+#endif // FEATURE_AUDIO_IMPROVED
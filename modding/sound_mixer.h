@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SOUND_MIXER_H_INCLUDED
+#define SOUND_MIXER_H_INCLUDED
+
+#include "global/types.h"
+
+#define MIXER_VOICES	(64)
+
+typedef enum {
+	MIXOUT_DirectSound,	// one streaming DirectSound buffer
+	MIXOUT_WaveFile,	// WAV file in real time, for the runs without a sound card
+	MIXOUT_Null,		// mixed and dropped in real time, for timing runs
+} MIXER_OUTPUT;
+
+// The output sink takes the mixed periods of 16 bit stereo frames.
+// wait() blocks for a while and returns how many frames may be written.
+typedef struct MixerSink_t {
+	bool (*open)(DWORD rate);
+	void (*close)();
+	DWORD (*wait)();
+	bool (*write)(const __int16 *data, DWORD frames);
+} MIXER_SINK;
+
+/*
+ * Function list
+ */
+bool IsMixerActive();
+bool MixerStart(LPDIRECTSOUND dsound);
+void MixerStop();
+bool MixerMakeSample(DWORD sampleIdx, LPWAVEFORMATEX format, LPCVOID data, DWORD dataSize);
+void MixerFreeAllSamples();
+int MixerPlaySample(DWORD sampleIdx, int volume, DWORD pitch, int pan, bool isLooped);
+bool MixerIsVoicePlaying(int voice);
+void MixerAdjustVolumeAndPan(int voice, int volume, int pan);
+void MixerAdjustPitch(int voice, DWORD pitch);
+void MixerStopSample(int voice);
+void MixerStopAllSamples();
+bool MixerDumpReport();
+
+#endif // SOUND_MIXER_H_INCLUDED
@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global/precompiled.h"
+#include "modding/texture_atlas.h"
+#include "specific/texture.h"
+#include "global/vars.h"
+
+#define ATLAS_PAGE_SIZE		(256)
+#define ATLAS_PADDING		(4) // edge texels copied around each page
+#define ATLAS_CELL_SIZE		(ATLAS_PAGE_SIZE + ATLAS_PADDING * 2)
+#define ATLAS_MIN_SIZE		(1024)
+
+typedef struct AtlasPage_t {
+	int x; // page origin inside of the atlas in texels
+	int y;
+	int shift; // log2(atlasSize / ATLAS_PAGE_SIZE)
+	int standalone; // separate page texture for page space consumers
+} ATLAS_PAGE;
+
+bool TextureAtlasEnabled = true;
+
+static ATLAS_PAGE AtlasPages[ARRAY_SIZE(HWR_TexturePageIndexes)];
+static int AtlasPagesCount = 0; // zero if the atlas is not active
+
+static int AtlasCellsPerRow(DWORD atlasSize) {
+	return atlasSize / ATLAS_CELL_SIZE;
+}
+
+static void CopyPagePadded(BYTE *dst, int dstPitch, const BYTE *src, int bpp) {
+	int rowSize = ATLAS_PAGE_SIZE * bpp;
+
+	for( int y = 0; y < ATLAS_CELL_SIZE; ++y ) {
+		int srcY = y - ATLAS_PADDING;
+		CLAMP(srcY, 0, ATLAS_PAGE_SIZE - 1);
+		const BYTE *srcRow = src + srcY * rowSize;
+		BYTE *dstRow = dst + y * dstPitch;
+
+		for( int x = 0; x < ATLAS_PADDING; ++x ) {
+			memcpy(dstRow + x * bpp, srcRow, bpp);
+			memcpy(dstRow + (ATLAS_PADDING + ATLAS_PAGE_SIZE + x) * bpp, srcRow + rowSize - bpp, bpp);
+		}
+		memcpy(dstRow + ATLAS_PADDING * bpp, srcRow, rowSize);
+	}
+}
+
+static inline int MapCoord(int origin, int shift, int value) {
+	return ((origin << 8) + value) >> shift;
+}
+
+static inline int UnmapCoord(int origin, int shift, int value) {
+	// the middle of the truncated range, so the round trip gives the same atlas value
+	return ((value << shift) | (1 << (shift - 1))) - (origin << 8);
+}
+
+bool AtlasLoadTexturePages(int pagesCount, BYTE *pagesBuffer, bool is8bit, int palIndex, int *pageIndexes) {
+	DWORD maxSize = GetMaxTextureSize();
+	int bpp = is8bit ? 1 : 2;
+	int pageSize = ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE * bpp;
+
+	AtlasFreeTexturePages();
+	if( !TextureAtlasEnabled || maxSize < ATLAS_MIN_SIZE || pagesCount < 2 || pagesCount > (int)ARRAY_SIZE(AtlasPages) ) {
+		return false;
+	}
+
+	BYTE *atlasBuffer = (BYTE *)malloc(maxSize * maxSize * bpp);
+	if( atlasBuffer == NULL ) {
+		return false;
+	}
+
+	for( int first = 0; first < pagesCount; ) {
+		int rest = pagesCount - first;
+		int shift = 2;
+		DWORD atlasSize = ATLAS_MIN_SIZE;
+		// the smallest atlas that fits the rest of the pages, or the biggest one
+		while( atlasSize < maxSize && AtlasCellsPerRow(atlasSize) * AtlasCellsPerRow(atlasSize) < rest ) {
+			atlasSize <<= 1;
+			++shift;
+		}
+		int perRow = AtlasCellsPerRow(atlasSize);
+		int count = MIN(perRow * perRow, rest);
+
+		memset(atlasBuffer, 0, atlasSize * atlasSize * bpp);
+		for( int i = 0; i < count; ++i ) {
+			ATLAS_PAGE *page = &AtlasPages[first + i];
+			int cellX = (i % perRow) * ATLAS_CELL_SIZE;
+			int cellY = (i / perRow) * ATLAS_CELL_SIZE;
+			CopyPagePadded(atlasBuffer + (cellY * atlasSize + cellX) * bpp, atlasSize * bpp, pagesBuffer + (first + i) * pageSize, bpp);
+			page->x = cellX + ATLAS_PADDING;
+			page->y = cellY + ATLAS_PADDING;
+			page->shift = shift;
+			page->standalone = -1;
+		}
+
+		int atlasIndex = is8bit ? AddTexturePage8(atlasSize, atlasSize, atlasBuffer, palIndex) : AddTexturePage16(atlasSize, atlasSize, atlasBuffer);
+		if( atlasIndex < 0 ) {
+			// fall back to separate pages
+			for( int i = 0; i < first; ++i ) {
+				SafeFreeTexturePage(pageIndexes[i]);
+				pageIndexes[i] = -1;
+			}
+			free(atlasBuffer);
+			return false;
+		}
+		// all pages of the atlas share the same texture, so their handles are the same too
+		for( int i = 0; i < count; ++i ) {
+			pageIndexes[first + i] = atlasIndex;
+		}
+		first += count;
+	}
+	free(atlasBuffer);
+
+	AtlasPagesCount = pagesCount;
+	// the texture infos are already loaded if the texture pages are reloaded for another video mode
+	AtlasMapTextureUVs();
+	return true;
+}
+
+void AtlasFreeTexturePages() {
+	if( !IsAtlasActive() ) {
+		return;
+	}
+	AtlasUnmapTextureUVs();
+	for( int i = 0; i < AtlasPagesCount; ++i ) {
+		SafeFreeTexturePage(AtlasPages[i].standalone);
+		AtlasPages[i].standalone = -1;
+	}
+	AtlasPagesCount = 0;
+}
+
+bool IsAtlasActive() {
+	return ( AtlasPagesCount > 0 );
+}
+
+void AtlasMapTextureUVs() {
+	if( !IsAtlasActive() ) {
+		return;
+	}
+	for( DWORD i = 0; i < TextureInfoCount; ++i ) {
+		PHD_TEXTURE *texture = &PhdTextureInfo[i];
+		if( texture->tpage >= AtlasPagesCount ) continue;
+		ATLAS_PAGE *page = &AtlasPages[texture->tpage];
+		for( int j = 0; j < 4; ++j ) {
+			texture->uv[j].u = MapCoord(page->x, page->shift, texture->uv[j].u);
+			texture->uv[j].v = MapCoord(page->y, page->shift, texture->uv[j].v);
+		}
+	}
+}
+
+void AtlasUnmapTextureUVs() {
+	if( !IsAtlasActive() ) {
+		return;
+	}
+	for( DWORD i = 0; i < TextureInfoCount; ++i ) {
+		AtlasUnmapUVs(PhdTextureInfo[i].tpage, PhdTextureInfo[i].uv, 4);
+	}
+}
+
+void AtlasUnmapUVs(int page, PHD_UV *uv, int count) {
+	if( page < 0 || page >= AtlasPagesCount ) {
+		return;
+	}
+	ATLAS_PAGE *atlasPage = &AtlasPages[page];
+	for( int i = 0; i < count; ++i ) {
+		int u = UnmapCoord(atlasPage->x, atlasPage->shift, uv[i].u);
+		int v = UnmapCoord(atlasPage->y, atlasPage->shift, uv[i].v);
+		CLAMP(u, 0, 0xFFFF);
+		CLAMP(v, 0, 0xFFFF);
+		uv[i].u = u;
+		uv[i].v = v;
+	}
+}
+
+double AtlasMapU(int page, double u) {
+	if( page < 0 || page >= AtlasPagesCount ) {
+		return u;
+	}
+	return ((double)(AtlasPages[page].x << 8) + u) / (double)(1 << AtlasPages[page].shift);
+}
+
+double AtlasMapV(int page, double v) {
+	if( page < 0 || page >= AtlasPagesCount ) {
+		return v;
+	}
+	return ((double)(AtlasPages[page].y << 8) + v) / (double)(1 << AtlasPages[page].shift);
+}
+
+HWR_TEXHANDLE AtlasGetPageHandle(int page) {
+	if( page < 0 || page >= AtlasPagesCount ) {
+		return ( page >= 0 && page < (int)ARRAY_SIZE(HWR_PageHandles) ) ? HWR_PageHandles[page] : 0;
+	}
+	ATLAS_PAGE *atlasPage = &AtlasPages[page];
+	if( atlasPage->standalone < 0 ) {
+		// the page is copied out of the system memory copy of the atlas
+		TEXPAGE_DESC *atlas = &TexturePages[HWR_TexturePageIndexes[page]];
+		int pageIndex = CreateTexturePage(ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE, atlas->palette);
+		if( pageIndex < 0 ) {
+			return 0;
+		}
+		RECT rect = {
+			.left	= atlasPage->x,
+			.top	= atlasPage->y,
+			.right	= atlasPage->x + ATLAS_PAGE_SIZE,
+			.bottom	= atlasPage->y + ATLAS_PAGE_SIZE,
+		};
+		if( FAILED(TexturePages[pageIndex].sysMemSurface->Blt(NULL, atlas->sysMemSurface, &rect, DDBLT_WAIT, NULL)) ||
+			!LoadTexturePage(pageIndex, false) )
+		{
+			SafeFreeTexturePage(pageIndex);
+			return 0;
+		}
+		atlasPage->standalone = pageIndex;
+	}
+	return GetTexturePageHandle(atlasPage->standalone);
+}
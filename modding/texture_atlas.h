@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEXTURE_ATLAS_H_INCLUDED
+#define TEXTURE_ATLAS_H_INCLUDED
+
+#include "global/types.h"
+
+// Texture atlas packs the level texture pages into a few big hardware textures,
+// so polys of different pages may be drawn without texture switches.
+// Each page is surrounded by a copy of its edge texels to keep bilinear filtering clean.
+// The level page numbers are kept, while PhdTextureInfo UVs are moved into the atlas space.
+// The UV insets of AdjustTextureUVs are still applied in the page space.
+
+/*
+ * Function list
+ */
+bool AtlasLoadTexturePages(int pagesCount, BYTE *pagesBuffer, bool is8bit, int palIndex, int *pageIndexes);
+void AtlasFreeTexturePages();
+bool IsAtlasActive();
+void AtlasMapTextureUVs();
+void AtlasUnmapTextureUVs();
+void AtlasUnmapUVs(int page, PHD_UV *uv, int count);
+double AtlasMapU(int page, double u);
+double AtlasMapV(int page, double v);
+HWR_TEXHANDLE AtlasGetPageHandle(int page);
+
+#endif // TEXTURE_ATLAS_H_INCLUDED
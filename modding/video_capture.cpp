@@ -0,0 +1,496 @@
+/*
+ * Copyright (c) 2017-2020 Michael Chaban. All rights reserved.
+ * Original game is written by Core Design Ltd. in 1997.
+ * Lara Croft and Tomb Raider are trademarks of Square Enix Ltd.
+ *
+ * This file is part of TR2Main.
+ *
+ * TR2Main is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * TR2Main is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with TR2Main.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "global/precompiled.h"
+#include "modding/video_capture.h"
+#include "modding/file_utils.h"
+#include "modding/image_codec.h"
+#include "global/vars.h"
+
+#ifdef FEATURE_SCREENSHOT_IMPROVED
+#define CAPTURE_SLOTS		(8) // staging buffers between the game thread and the encoders
+#define CAPTURE_MAX_WORKERS	(4)
+
+typedef enum {
+	SLOT_Free,
+	SLOT_Queued,
+	SLOT_Encoding,
+	SLOT_Encoded,
+} SLOT_STATE;
+
+typedef struct CaptureSlot_t {
+	SLOT_STATE state;
+	DWORD index; // capture frame number
+	DWORD repeat; // game frames this image lasts
+	IMAGE_FRAME frame;
+	BYTE *pixels; // raw surface lines without the pitch gaps
+	DWORD pixelsSize;
+	BYTE palette[256 * 3];
+	IMAGE_BUFFER encoded;
+} CAPTURE_SLOT;
+
+typedef struct VideoCapture_t {
+	bool isActive;
+	DWORD format;
+	char baseName[MAX_PATH]; // the folder of images, or the stream name without extension
+	HANDLE hStream;
+	CAPTURE_SLOT slots[CAPTURE_SLOTS];
+	CRITICAL_SECTION slotLock;
+	CRITICAL_SECTION writeLock; // the stream frames are written in order
+	HANDLE hSemaphore; // counts the queued slots and the stop signals
+	HANDLE hWorkers[CAPTURE_MAX_WORKERS];
+	DWORD workersCount;
+	volatile bool isStopping;
+	int width;
+	int height;
+	int bpp;
+	DWORD nextIndex;
+	DWORD nextWrite;
+	DWORD pendingTicks;
+	DWORD droppedRepeat;
+	// statistics
+	DWORD framesQueued;
+	DWORD framesDropped;
+	DWORD framesWritten;
+	DWORD videoFrames;
+	DWORD errors;
+	double copyTime;
+	double copyTimeMax;
+	double encodeTime; // the sum of all workers
+	double startTime;
+} VIDEO_CAPTURE;
+
+extern char ScreenshotPath[MAX_PATH];
+
+DWORD VideoCaptureFormat = CAPTURE_PNG;
+
+static VIDEO_CAPTURE Capture;
+static bool IsCaptureLockReady = false;
+
+static double GetCurrentTicks() {
+	LARGE_INTEGER counter, frequency;
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+}
+
+static bool EncodeSlot(CAPTURE_SLOT *slot, BYTE **rgb, DWORD *rgbSize) {
+	slot->encoded.size = 0;
+	if( Capture.format == CAPTURE_Sequence && slot->frame.bpp == 8 ) {
+		return ImageEncodePCX(&slot->frame, &slot->encoded);
+	}
+	// the RGB buffer belongs to the worker, so it is reused between the frames
+	DWORD size = slot->frame.width * slot->frame.height * 3;
+	if( *rgbSize < size ) {
+		free(*rgb);
+		*rgb = (BYTE *)malloc(size);
+		*rgbSize = ( *rgb != NULL ) ? size : 0;
+	}
+	if( *rgb == NULL || !ImageFrameToRGB(&slot->frame, *rgb) ) {
+		return false;
+	}
+	switch( Capture.format ) {
+		case CAPTURE_Sequence :
+			return ImageEncodeTGA(*rgb, slot->frame.width, slot->frame.height, &slot->encoded);
+		case CAPTURE_Y4M :
+			return ImageEncodeY4M(*rgb, slot->frame.width, slot->frame.height, &slot->encoded);
+		default :
+			return ImageEncodePNG(*rgb, slot->frame.width, slot->frame.height, &slot->encoded);
+	}
+}
+
+static bool WriteImageFile(CAPTURE_SLOT *slot) {
+	static LPCSTR extensions[] = {".tga", ".png", ".pcx"};
+	char fileName[MAX_PATH];
+	DWORD bytesWritten = 0;
+	int ext = ( Capture.format == CAPTURE_PNG ) ? 1 : ( slot->frame.bpp == 8 ) ? 2 : 0;
+
+	snprintf(fileName, sizeof(fileName), "%s\\%06lu%s", Capture.baseName, slot->index, extensions[ext]);
+	HANDLE hFile = CreateFile(fileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if( hFile == INVALID_HANDLE_VALUE ) {
+		return false;
+	}
+	WriteFile(hFile, slot->encoded.data, slot->encoded.size, &bytesWritten, NULL);
+	CloseHandle(hFile);
+	return ( bytesWritten == slot->encoded.size );
+}
+
+// Writes all encoded stream frames which follow the written ones
+static void WriteStreamFrames() {
+	EnterCriticalSection(&Capture.writeLock);
+	for(;;) {
+		CAPTURE_SLOT *slot = NULL;
+		EnterCriticalSection(&Capture.slotLock);
+		for( int i = 0; i < CAPTURE_SLOTS; ++i ) {
+			if( Capture.slots[i].state == SLOT_Encoded && Capture.slots[i].index == Capture.nextWrite ) {
+				slot = &Capture.slots[i];
+				break;
+			}
+		}
+		LeaveCriticalSection(&Capture.slotLock);
+		if( slot == NULL ) {
+			break;
+		}
+		// the stream has a fixed frame rate, so the image is repeated for the game frames it lasts
+		for( DWORD i = 0; i < slot->repeat && slot->encoded.size > 0; ++i ) {
+			DWORD bytesWritten = 0;
+			WriteFile(Capture.hStream, slot->encoded.data, slot->encoded.size, &bytesWritten, NULL);
+			if( bytesWritten != slot->encoded.size ) {
+				++Capture.errors;
+				break;
+			}
+			++Capture.videoFrames;
+		}
+		EnterCriticalSection(&Capture.slotLock);
+		if( slot->encoded.size > 0 ) {
+			++Capture.framesWritten;
+		}
+		slot->state = SLOT_Free;
+		++Capture.nextWrite;
+		LeaveCriticalSection(&Capture.slotLock);
+	}
+	LeaveCriticalSection(&Capture.writeLock);
+}
+
+static DWORD WINAPI CaptureWorkerTask(CONST LPVOID lpParam) {
+	BYTE *rgb = NULL;
+	DWORD rgbSize = 0;
+
+	for(;;) {
+		WaitForSingleObject(Capture.hSemaphore, INFINITE);
+		// the oldest queued frame goes first
+		CAPTURE_SLOT *slot = NULL;
+		EnterCriticalSection(&Capture.slotLock);
+		for( int i = 0; i < CAPTURE_SLOTS; ++i ) {
+			if( Capture.slots[i].state == SLOT_Queued && (slot == NULL || Capture.slots[i].index < slot->index) ) {
+				slot = &Capture.slots[i];
+			}
+		}
+		if( slot != NULL ) {
+			slot->state = SLOT_Encoding;
+		}
+		LeaveCriticalSection(&Capture.slotLock);
+
+		if( slot == NULL ) {
+			// the queue is drained, so the stop signal may be taken
+			if( Capture.isStopping ) break;
+			continue;
+		}
+
+		double startTime = GetCurrentTicks();
+		bool isEncoded = EncodeSlot(slot, &rgb, &rgbSize);
+		bool isWritten = isEncoded && ( Capture.format == CAPTURE_Y4M || WriteImageFile(slot) );
+		double encodeTime = GetCurrentTicks() - startTime;
+
+		EnterCriticalSection(&Capture.slotLock);
+		Capture.encodeTime += encodeTime;
+		if( !isEncoded ) {
+			slot->encoded.size = 0;
+		}
+		if( !isWritten ) {
+			++Capture.errors;
+		}
+		if( Capture.format == CAPTURE_Y4M ) {
+			slot->state = SLOT_Encoded;
+		} else {
+			if( isWritten ) {
+				++Capture.framesWritten;
+			}
+			slot->state = SLOT_Free;
+		}
+		LeaveCriticalSection(&Capture.slotLock);
+
+		if( Capture.format == CAPTURE_Y4M ) {
+			WriteStreamFrames();
+		}
+	}
+	free(rgb);
+	ExitThread(0);
+}
+
+static bool CopySurface(CAPTURE_SLOT *slot, bool *isFormatChanged) {
+	LPDDS surface = ( SavedAppSettings.RenderMode == RM_Software ) ? RenderBufferSurface : BackBufferSurface;
+	RECT rect = GameVidRect;
+	DDSDESC desc;
+	HRESULT rc;
+	bool result = false;
+
+	if( surface == NULL ) {
+		return false;
+	}
+	memset(&desc, 0, sizeof(desc));
+	desc.dwSize = sizeof(desc);
+	do {
+		rc = surface->Lock(&rect, &desc, DDLOCK_READONLY|DDLOCK_WAIT, NULL);
+	} while( rc == DDERR_WASSTILLDRAWING );
+	if FAILED(rc) {
+		return false;
+	}
+
+	int width = MIN((DWORD)(rect.right - rect.left), desc.dwWidth);
+	int height = MIN((DWORD)(rect.bottom - rect.top), desc.dwHeight);
+	int bpp = desc.ddpfPixelFormat.dwRGBBitCount;
+	DWORD lineSize = width * (bpp / 8);
+	DWORD size = lineSize * height;
+
+	// the capture is stopped if the frame format changes
+	if( Capture.width == 0 ) {
+		Capture.width = width;
+		Capture.height = height;
+		Capture.bpp = bpp;
+	}
+	if( width != Capture.width || height != Capture.height || bpp != Capture.bpp ||
+		(bpp != 8 && bpp != 16 && bpp != 24 && bpp != 32) )
+	{
+		*isFormatChanged = true;
+		goto CLEANUP;
+	}
+	if( slot->pixelsSize < size ) {
+		free(slot->pixels);
+		slot->pixels = (BYTE *)malloc(size);
+		slot->pixelsSize = ( slot->pixels != NULL ) ? size : 0;
+		if( slot->pixels == NULL ) goto CLEANUP;
+	}
+	for( int i = 0; i < height; ++i ) {
+		memcpy(slot->pixels + i * lineSize, (BYTE *)desc.lpSurface + i * desc.lPitch, lineSize);
+	}
+	if( bpp == 8 ) {
+		memcpy(slot->palette, GamePalette8, sizeof(slot->palette));
+	}
+
+	slot->frame.width = width;
+	slot->frame.height = height;
+	slot->frame.pitch = lineSize;
+	slot->frame.bpp = bpp;
+	slot->frame.rMask = desc.ddpfPixelFormat.dwRBitMask;
+	slot->frame.gMask = desc.ddpfPixelFormat.dwGBitMask;
+	slot->frame.bMask = desc.ddpfPixelFormat.dwBBitMask;
+	slot->frame.pixels = slot->pixels;
+	slot->frame.palette = slot->palette;
+	result = true;
+
+CLEANUP :
+#if (DIRECT3D_VERSION >= 0x700)
+	surface->Unlock(&rect);
+#else // (DIRECT3D_VERSION >= 0x700)
+	surface->Unlock(desc.lpSurface);
+#endif // (DIRECT3D_VERSION >= 0x700)
+	return result;
+}
+
+static bool DumpCaptureReport() {
+	char fileName[MAX_PATH];
+	double totalTime = GetCurrentTicks() - Capture.startTime;
+	DWORD copied = Capture.framesQueued;
+
+	snprintf(fileName, sizeof(fileName), "%s.txt", Capture.baseName);
+	FILE *fp = fopen(fileName, "wt");
+	if( fp == NULL ) {
+		return false;
+	}
+	fprintf(fp, "Video capture: %dx%d %d bpp, %.1f s\n", Capture.width, Capture.height, Capture.bpp, totalTime);
+	fprintf(fp, "Frames queued %lu, written %lu, dropped %lu, errors %lu, workers %lu\n",
+			Capture.framesQueued, Capture.framesWritten, Capture.framesDropped, Capture.errors, Capture.workersCount);
+	if( Capture.format == CAPTURE_Y4M ) {
+		fprintf(fp, "Stream frames %lu (%d fps)\n", Capture.videoFrames, FRAMES_PER_SECOND);
+	}
+	fprintf(fp, "Copy avg %.3f ms, max %.3f ms\n",
+			copied ? Capture.copyTime * 1000.0 / copied : 0.0, Capture.copyTimeMax * 1000.0);
+	fprintf(fp, "Encode avg %.3f ms per frame\n", copied ? Capture.encodeTime * 1000.0 / copied : 0.0);
+	fclose(fp);
+	return true;
+}
+
+bool IsVideoCaptureActive() {
+	return Capture.isActive;
+}
+
+bool VideoCaptureStart() {
+	static SYSTEMTIME lastTime = {0, 0, 0, 0, 0, 0, 0, 0};
+	static int lastIndex = 0;
+	SYSTEM_INFO info;
+	DWORD workersCount;
+
+	if( Capture.isActive ) {
+		return true;
+	}
+	if( !IsCaptureLockReady ) {
+		// the locks live until the game exit, the workers never outlive a capture
+		InitializeCriticalSection(&Capture.slotLock);
+		InitializeCriticalSection(&Capture.writeLock);
+		IsCaptureLockReady = true;
+	}
+
+	Capture.format = MIN(VideoCaptureFormat, CAPTURE_Y4M);
+	Capture.hStream = INVALID_HANDLE_VALUE;
+	CreateDateTimeFilename(Capture.baseName, sizeof(Capture.baseName), ScreenshotPath, NULL, &lastTime, &lastIndex);
+	if( Capture.format == CAPTURE_Y4M ) {
+		char fileName[MAX_PATH];
+		snprintf(fileName, sizeof(fileName), "%s.y4m", Capture.baseName);
+		CreateDirectories(fileName, true);
+		Capture.hStream = CreateFile(fileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL|FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if( Capture.hStream == INVALID_HANDLE_VALUE ) {
+			return false;
+		}
+	} else {
+		CreateDirectories(Capture.baseName, false);
+	}
+
+	Capture.hSemaphore = CreateSemaphore(NULL, 0, CAPTURE_SLOTS + CAPTURE_MAX_WORKERS, NULL);
+	if( Capture.hSemaphore == NULL ) {
+		goto FAILURE;
+	}
+	// one processor is left for the game thread
+	GetSystemInfo(&info);
+	Capture.workersCount = 0;
+	workersCount = info.dwNumberOfProcessors - 1;
+	CLAMP(workersCount, 1, CAPTURE_MAX_WORKERS);
+	Capture.isStopping = false;
+	for( DWORD i = 0; i < workersCount; ++i ) {
+		HANDLE hThread = CreateThread(NULL, 0, &CaptureWorkerTask, NULL, 0, NULL);
+		if( hThread == NULL ) break;
+		SetThreadPriority(hThread, THREAD_PRIORITY_BELOW_NORMAL);
+		Capture.hWorkers[Capture.workersCount++] = hThread;
+	}
+	if( Capture.workersCount == 0 ) {
+		goto FAILURE;
+	}
+
+	Capture.width = Capture.height = Capture.bpp = 0;
+	Capture.nextIndex = Capture.nextWrite = 0;
+	Capture.pendingTicks = Capture.droppedRepeat = 0;
+	Capture.framesQueued = Capture.framesDropped = Capture.framesWritten = 0;
+	Capture.videoFrames = Capture.errors = 0;
+	Capture.copyTime = Capture.copyTimeMax = Capture.encodeTime = 0.0;
+	Capture.startTime = GetCurrentTicks();
+	Capture.isActive = true;
+	return true;
+
+FAILURE :
+	if( Capture.hSemaphore != NULL ) {
+		CloseHandle(Capture.hSemaphore);
+		Capture.hSemaphore = NULL;
+	}
+	if( Capture.hStream != INVALID_HANDLE_VALUE ) {
+		CloseHandle(Capture.hStream);
+		Capture.hStream = INVALID_HANDLE_VALUE;
+	}
+	return false;
+}
+
+void VideoCaptureStop() {
+	if( !Capture.isActive ) {
+		return;
+	}
+	// the workers drain the queue before they take the stop signals
+	Capture.isStopping = true;
+	ReleaseSemaphore(Capture.hSemaphore, Capture.workersCount, NULL);
+	WaitForMultipleObjects(Capture.workersCount, Capture.hWorkers, TRUE, INFINITE);
+	for( DWORD i = 0; i < Capture.workersCount; ++i ) {
+		CloseHandle(Capture.hWorkers[i]);
+		Capture.hWorkers[i] = NULL;
+	}
+	CloseHandle(Capture.hSemaphore);
+	Capture.hSemaphore = NULL;
+	if( Capture.hStream != INVALID_HANDLE_VALUE ) {
+		CloseHandle(Capture.hStream);
+		Capture.hStream = INVALID_HANDLE_VALUE;
+	}
+	DumpCaptureReport();
+
+	for( int i = 0; i < CAPTURE_SLOTS; ++i ) {
+		free(Capture.slots[i].pixels);
+		ImageBufferFree(&Capture.slots[i].encoded);
+		memset(&Capture.slots[i], 0, sizeof(CAPTURE_SLOT));
+	}
+	Capture.isActive = false;
+}
+
+void VideoCaptureToggle() {
+	if( Capture.isActive ) {
+		VideoCaptureStop();
+	} else {
+		VideoCaptureStart();
+	}
+}
+
+void VideoCaptureFrame(DWORD ticks) {
+	if( !Capture.isActive ) {
+		return;
+	}
+	// interpolated frames between the control ticks take no time of the stream
+	Capture.pendingTicks += ticks;
+	DWORD repeat = Capture.pendingTicks / TICKS_PER_FRAME;
+	if( repeat == 0 ) {
+		return;
+	}
+	Capture.pendingTicks %= TICKS_PER_FRAME;
+
+	CAPTURE_SLOT *slot = NULL;
+	EnterCriticalSection(&Capture.slotLock);
+	for( int i = 0; i < CAPTURE_SLOTS; ++i ) {
+		if( Capture.slots[i].state == SLOT_Free ) {
+			slot = &Capture.slots[i];
+			break;
+		}
+	}
+	LeaveCriticalSection(&Capture.slotLock);
+
+	// the encoders are behind, so the frame is dropped and the next one lasts longer
+	if( slot == NULL ) {
+		++Capture.framesDropped;
+		Capture.droppedRepeat += repeat;
+		return;
+	}
+
+	bool isFormatChanged = false;
+	double startTime = GetCurrentTicks();
+	if( !CopySurface(slot, &isFormatChanged) ) {
+		if( isFormatChanged ) {
+			// the stream cannot change its frame size or format
+			VideoCaptureStop();
+		} else {
+			++Capture.framesDropped;
+			Capture.droppedRepeat += repeat;
+		}
+		return;
+	}
+	double copyTime = GetCurrentTicks() - startTime;
+	Capture.copyTime += copyTime;
+	CLAMPL(Capture.copyTimeMax, copyTime);
+
+	if( Capture.format == CAPTURE_Y4M && Capture.nextIndex == 0 ) {
+		char header[64];
+		DWORD bytesWritten = 0;
+		DWORD size = ImageHeaderY4M(header, sizeof(header), Capture.width, Capture.height, FRAMES_PER_SECOND);
+		WriteFile(Capture.hStream, header, size, &bytesWritten, NULL);
+	}
+
+	EnterCriticalSection(&Capture.slotLock);
+	slot->index = Capture.nextIndex++;
+	slot->repeat = repeat + Capture.droppedRepeat;
+	slot->state = SLOT_Queued;
+	++Capture.framesQueued;
+	LeaveCriticalSection(&Capture.slotLock);
+	Capture.droppedRepeat = 0;
+	ReleaseSemaphore(Capture.hSemaphore, 1, NULL);
+}
+#endif // FEATURE_SCREENSHOT_IMPROVED
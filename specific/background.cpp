@@ -34,6 +34,10 @@
 DWORD InvBackgroundMode;
 #endif // FEATURE_BACKGROUND_IMPROVED
 
+#ifdef FEATURE_RENDER_IMPROVED
+#include "modding/texture_atlas.h"
+#endif // FEATURE_RENDER_IMPROVED
+
 void __cdecl BGND_Make640x480(BYTE *bitmap, RGB888 *palette) {
 	// NOTE: 8 bit bitmap may be converted to 16 bit right in the tmpBuffer
 	// so we need to allocate memory for 16 bit bitmap anyway
@@ -177,6 +181,16 @@ BLACK : // NOTE: some additional checks are absent in the original code, so I've
 
 	texSource = HWR_PageHandles[PhdTextureInfo[textureIndex].tpage];
 	textureInfo = &PhdTextureInfo[textureIndex];
+#ifdef FEATURE_RENDER_IMPROVED
+	// the background tiles are positioned in the page texels, so the page is taken out of the atlas
+	PHD_TEXTURE pageTexture;
+	if( IsAtlasActive() ) {
+		pageTexture = *textureInfo;
+		AtlasUnmapUVs(pageTexture.tpage, pageTexture.uv, 4);
+		texSource = AtlasGetPageHandle(pageTexture.tpage);
+		textureInfo = &pageTexture;
+	}
+#endif // FEATURE_RENDER_IMPROVED
 
 	tu = textureInfo->uv[0].u / PHD_HALF;
 	tv = textureInfo->uv[0].v / PHD_HALF;
@@ -57,6 +57,44 @@ extern bool LoadingScreensEnabled;
 #include "modding/mod_utils.h"
 #endif // defined(FEATURE_MOD_CONFIG) || defined(FEATURE_VIDEOFX_IMPROVED)
 
+#ifdef FEATURE_LOADING_IMPROVED
+#include "modding/file_view.h"
+#include "modding/floor_table.h"
+#include "modding/level_cache.h"
+#include "modding/level_prefetch.h"
+#include "modding/load_report.h"
+#include "modding/sfx_bank.h"
+#include "specific/utils.h"
+
+// The level file is mapped once, and the loaders read it through ReadFileSync
+// with the view address passed as the file handle, so there are no hundreds
+// of small ReadFile calls per level.
+bool LevelFileViewEnabled = true;
+bool LevelPrefetchEnabled = true;
+
+static FILE_VIEW LevelView;
+static bool IsLevelViewOpen = false;
+static bool IsLevelViewPrefetched = false;
+static bool IsLevelViewTruncated = false;
+
+#define LEVEL_VIEW_HANDLE ((HANDLE)&LevelView)
+
+static SFX_BANK MainSfxBank;
+// the texture setup and the semitransparency marks, computed or taken from the level cache
+static double DerivedDataTime = 0.0;
+#ifdef FEATURE_MOD_CONFIG
+static SFX_BANK BarefootSfxBank;
+#endif // FEATURE_MOD_CONFIG
+#endif // FEATURE_LOADING_IMPROVED
+
+#ifdef FEATURE_RENDER_IMPROVED
+#include "modding/anim_cache.h"
+#include "modding/room_visibility.h"
+#include "modding/texture_atlas.h"
+
+extern void S_ResetRoomLightGrids();
+#endif // FEATURE_RENDER_IMPROVED
+
 #ifdef FEATURE_VIDEOFX_IMPROVED
 static bool MarkSemitransPoly(__int16 *ptrObj, int vtxCount, bool colored, LPVOID param) {
 	UINT16 index = ptrObj[vtxCount];
@@ -145,10 +183,24 @@ static void LoadBareFootSFX(int *sampleIndexes, int sampleCount) {
 	LPCTSTR sfxFileName = GetFullPath("data\\barefoot.sfx");
 	if( !PathFileExists(sfxFileName) ) return;
 
+	int i;
+#ifdef FEATURE_LOADING_IMPROVED
+	if( !SfxBankOpen(&BarefootSfxBank, sfxFileName) ) return;
+
+	for( i=0; i < sampleCount; ++i ) {
+		DWORD dataSize;
+		WAVEFORMATEX waveFormat;
+		LPCVOID waveData = SfxBankGetSample(&BarefootSfxBank, sampleIndexes[i], &waveFormat, &dataSize);
+		// sample indexes are sorted, so there are no more samples in the barefoot bank
+		if( waveData == NULL ) break;
+		WinSndMakeSample(i, &waveFormat, (LPVOID)waveData, dataSize);
+	}
+	SfxBankClose(&BarefootSfxBank);
+#else // FEATURE_LOADING_IMPROVED
 	HANDLE hSfxFile = CreateFile(sfxFileName, GENERIC_READ, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
 	if( hSfxFile == INVALID_HANDLE_VALUE ) return;
 
-	int i, j;
+	int j;
 	for( i=0, j=0; i < sampleCount; ++j ) {
 		DWORD bytesRead;
 		WAVEPCM_HEADER waveHeader;
@@ -176,6 +228,8 @@ static void LoadBareFootSFX(int *sampleIndexes, int sampleCount) {
 			SetFilePointer(hSfxFile, dataSize, NULL, FILE_CURRENT);
 		}
 	}
+	CloseHandle(hSfxFile);
+#endif // FEATURE_LOADING_IMPROVED
 	for( i=0; i<4; ++i ) { // there are no more than 4 barefoot step samples
 		if( SampleInfos[i].sfxID >= 4 ) break;
 		// SFX parameters are taken from the PlayStation version
@@ -183,12 +237,87 @@ static void LoadBareFootSFX(int *sampleIndexes, int sampleCount) {
 		SampleInfos[i].randomness = 0;
 		SampleInfos[i].flags = 0x6010;
 	}
-	CloseHandle(hSfxFile);
 }
 #endif // FEATURE_MOD_CONFIG
 
 static GF_LEVEL_TYPE LoadLevelType = GFL_NOLEVEL;
 
+static void ExpandGamePalette() {
+	GamePalette8[0].red = 0;
+	GamePalette8[0].green = 0;
+	GamePalette8[0].blue = 0;
+
+	for( int i=1; i<256; ++i ) {
+		// NOTE: the original code just shifts left 2 bits. But this way is slightly better
+		GamePalette8[i].red   = (GamePalette8[i].red   << 2) | (GamePalette8[i].red   >> 4);
+		GamePalette8[i].green = (GamePalette8[i].green << 2) | (GamePalette8[i].green >> 4);
+		GamePalette8[i].blue  = (GamePalette8[i].blue  << 2) | (GamePalette8[i].blue  >> 4);
+	}
+}
+
+static void SetupDepthQ() {
+	int i, j;
+	RGB888 paletteBuffer[256];
+
+	for( i=0; i<32; ++i )
+		DepthQTable[i].index[0] = 0;
+
+	if( GameVid_IsWindowedVga ) {
+		CopyBitmapPalette(GamePalette8, DepthQTable[0].index, 32*sizeof(DEPTHQ_ENTRY), paletteBuffer);
+		SyncSurfacePalettes(DepthQTable, 256, 32, 256, GamePalette8, DepthQTable, 256, paletteBuffer, true);
+		memcpy(GamePalette8, paletteBuffer, sizeof(GamePalette8));
+		for( i=0; i<256; ++i ) {
+			DepthQIndex[i] = S_COLOUR(GamePalette8[i].red, GamePalette8[i].green, GamePalette8[i].blue);
+		}
+	} else {
+		memcpy(DepthQIndex, &DepthQTable[24], 256);
+	}
+
+	for( i=0; i<32; ++i ) {
+		for( j=0; j<256; ++j ) {
+			GouraudTable[j].index[i] = DepthQTable[i].index[j];
+		}
+	}
+
+	IsWet = 0;
+	for( i=0; i<256; ++i ) {
+		WaterPalette[i].red   = GamePalette8[i].red   * 2 / 3;
+		WaterPalette[i].green = GamePalette8[i].green * 2 / 3;
+		WaterPalette[i].blue  = GamePalette8[i].blue;
+	}
+}
+
+static void SetupTextureInfos() {
+	DWORD i, j;
+	UINT16 *uv;
+
+#ifdef FEATURE_LOADING_IMPROVED
+	double startTime = UT_Microseconds();
+	if( LevelCacheApplyTextures() ) {
+		DerivedDataTime += UT_Microseconds() - startTime;
+		AdjustTextureUVs(true);
+		return;
+	}
+#endif // FEATURE_LOADING_IMPROVED
+	for( i = 0; i < TextureInfoCount; ++i ) {
+		LabTextureUVFlags[i] = 0;
+		uv = &PhdTextureInfo[i].uv[0].u;
+		for( j = 0; j < 8; ++j ) {
+			if( (uv[j] & 0x0080) != 0 ) {
+				uv[j] |= 0x00FF;
+				LabTextureUVFlags[i] |= (1 << j);
+			} else {
+				uv[j] &= 0xFF00;
+			}
+		}
+	}
+#ifdef FEATURE_LOADING_IMPROVED
+	LevelCacheStoreTextures();
+	DerivedDataTime += UT_Microseconds() - startTime;
+#endif // FEATURE_LOADING_IMPROVED
+	AdjustTextureUVs(true);
+}
+
 BOOL __cdecl ReadFileSync(HANDLE hFile, LPVOID lpBuffer, DWORD nBytesToRead, LPDWORD lpnBytesRead, LPOVERLAPPED lpOverlapped) {
 	ReadFileBytesCounter += nBytesToRead;
 
@@ -196,9 +325,45 @@ BOOL __cdecl ReadFileSync(HANDLE hFile, LPVOID lpBuffer, DWORD nBytesToRead, LPD
 		ReadFileBytesCounter = 0;
 		WinVidSpinMessageLoop(false);
 	}
+#ifdef FEATURE_LOADING_IMPROVED
+	if( IsLevelViewOpen && hFile == LEVEL_VIEW_HANDLE ) {
+		if( !FileViewRead(&LevelView, lpBuffer, nBytesToRead) ) {
+			lstrcpy(StringToShow, "LoadLevel(): Unexpected end of level file");
+			IsLevelViewTruncated = true;
+			// zeroed counts keep the loader from allocating anything before the section is failed
+			memset(lpBuffer, 0, nBytesToRead);
+			*lpnBytesRead = 0;
+			return FALSE;
+		}
+		*lpnBytesRead = nBytesToRead;
+		return TRUE;
+	}
+#endif // FEATURE_LOADING_IMPROVED
 	return ReadFile(hFile, lpBuffer, nBytesToRead, lpnBytesRead, lpOverlapped);
 }
 
+static DWORD TellFileSync(HANDLE hFile) {
+#ifdef FEATURE_LOADING_IMPROVED
+	if( IsLevelViewOpen && hFile == LEVEL_VIEW_HANDLE ) {
+		return FileViewTell(&LevelView);
+	}
+#endif // FEATURE_LOADING_IMPROVED
+	return SetFilePointer(hFile, 0, NULL, FILE_CURRENT);
+}
+
+static void SkipFileSync(HANDLE hFile, DWORD nBytesToSkip) {
+#ifdef FEATURE_LOADING_IMPROVED
+	if( IsLevelViewOpen && hFile == LEVEL_VIEW_HANDLE ) {
+		if( !FileViewSkip(&LevelView, nBytesToSkip) ) {
+			lstrcpy(StringToShow, "LoadLevel(): Unexpected end of level file");
+			IsLevelViewTruncated = true;
+		}
+		return;
+	}
+#endif // FEATURE_LOADING_IMPROVED
+	SetFilePointer(hFile, nBytesToSkip, NULL, FILE_CURRENT);
+}
+
 BOOL __cdecl LoadTexturePages(HANDLE hFile) {
 	int i, pageCount;
 	DWORD bytesRead;
@@ -216,9 +381,28 @@ BOOL __cdecl LoadTexturePages(HANDLE hFile) {
 			}
 			ReadFileSync(hFile, TexturePageBuffer8[i], 256*256*1, &bytesRead, NULL);
 		}
-		SetFilePointer(hFile, pageCount*(256*256*2), NULL, FILE_CURRENT);
+		SkipFileSync(hFile, pageCount*(256*256*2));
+		return TRUE;
+	}
+
+#ifdef FEATURE_LOADING_IMPROVED
+	// hardware renderer uploads texture pages right from the mapping, no intermediate buffer is required
+	if( IsLevelViewOpen && hFile == LEVEL_VIEW_HANDLE ) {
+		LPCVOID pages8 = FileViewPtr(&LevelView, pageCount*(256*256*1));
+		LPCVOID pages16 = FileViewPtr(&LevelView, pageCount*(256*256*2));
+		if( pages8 == NULL || pages16 == NULL ) {
+			lstrcpy(StringToShow, "LoadLevel(): Unexpected end of level file");
+			return FALSE;
+		}
+		if( TextureFormat.bpp < 16 ) {
+			HWR_LoadTexturePages(pageCount, (LPVOID)pages8, GamePalette8);
+		} else {
+			HWR_LoadTexturePages(pageCount, (LPVOID)pages16, NULL);
+		}
+		HwrTexturePagesCount = pageCount;
 		return TRUE;
 	}
+#endif // FEATURE_LOADING_IMPROVED
 
 	// for hardware renderer do BPP check and load 8 bit or 16 bit texture pages to GLOBAL allocated memory and skip others
 	pageSize = ( TextureFormat.bpp < 16 ) ? 256*256*1 : 256*256*2;
@@ -235,11 +419,11 @@ BOOL __cdecl LoadTexturePages(HANDLE hFile) {
 			ReadFileSync(hFile, texPagePtr, pageSize, &bytesRead, NULL);
 			texPagePtr += pageSize;
 		}
-		SetFilePointer(hFile, pageCount*(256*256*2), NULL, FILE_CURRENT);
+		SkipFileSync(hFile, pageCount*(256*256*2));
 		HWR_LoadTexturePages(pageCount, texPageBuffer, GamePalette8);
 	} else {
 		// skip 8 bit texture pages and load 16 bit texture pages
-		SetFilePointer(hFile, pageCount*(256*256*1), NULL, FILE_CURRENT);
+		SkipFileSync(hFile, pageCount*(256*256*1));
 		for( i=0; i<pageCount; ++i ) {
 			ReadFileSync(hFile, texPagePtr, pageSize, &bytesRead, NULL);
 			texPagePtr += pageSize;
@@ -348,6 +532,9 @@ BOOL __cdecl LoadRooms(HANDLE hFile) {
 	ReadFileSync(hFile, &dwCount, sizeof(DWORD), &bytesRead, NULL);
 	FloorData = (__int16 *)game_malloc(sizeof(__int16)*dwCount, GBUF_FloorData);
 	ReadFileSync(hFile, FloorData, sizeof(__int16)*dwCount, &bytesRead, NULL);
+#ifdef FEATURE_LOADING_IMPROVED
+	FloorTableBuild();
+#endif // FEATURE_LOADING_IMPROVED
 	return TRUE;
 }
 
@@ -372,6 +559,13 @@ void __cdecl AdjustTextureUVs(bool resetUvAdd) {
 
 	UvAdd = adjustment;
 
+#ifdef FEATURE_RENDER_IMPROVED
+	// UV insets are in the page space, so atlas UVs are moved back for a while
+	if( !resetUvAdd ) {
+		AtlasUnmapTextureUVs();
+	}
+#endif // FEATURE_RENDER_IMPROVED
+
 	for( i=0; i<TextureInfoCount; ++i ) {
 
 		uvFlags = LabTextureUVFlags[i];
@@ -383,16 +577,18 @@ void __cdecl AdjustTextureUVs(bool resetUvAdd) {
 			uvFlags >>= 2;
 		}
 	}
+#ifdef FEATURE_RENDER_IMPROVED
+	AtlasMapTextureUVs();
+#endif // FEATURE_RENDER_IMPROVED
 }
 
 BOOL __cdecl LoadObjects(HANDLE hFile) {
-	DWORD i, j;
+	DWORD i;
 	DWORD bytesRead;
 	DWORD dwCount;
 	DWORD animCount;
 	DWORD animOffset;
 	DWORD objNumber;
-	UINT16 *uv;
 
 	// Load mesh base data
 	ReadFileSync(hFile, &dwCount, sizeof(DWORD), &bytesRead, NULL);
@@ -446,6 +642,10 @@ BOOL __cdecl LoadObjects(HANDLE hFile) {
 	ReadFileSync(hFile, &dwCount, sizeof(DWORD), &bytesRead, NULL);
 	for( i = 0; i < dwCount; ++i ) {
 		ReadFileSync(hFile, &objNumber, sizeof(DWORD), &bytesRead, NULL);
+		if( objNumber >= ID_NUMBER_OBJECTS ) {
+			wsprintf(StringToShow, "LoadObjects(): Bad Object number (%d)", objNumber);
+			return FALSE;
+		}
 		ReadFileSync(hFile, &Objects[objNumber].nMeshes, sizeof(__int16), &bytesRead, NULL);
 		ReadFileSync(hFile, &Objects[objNumber].meshIndex, sizeof(__int16), &bytesRead, NULL);
 		ReadFileSync(hFile, &Objects[objNumber].boneIndex, sizeof(int), &bytesRead, NULL);
@@ -465,6 +665,10 @@ BOOL __cdecl LoadObjects(HANDLE hFile) {
 #endif // FEATURE_VIDEOFX_IMPROVED
 	for( i = 0; i < dwCount; ++i ) {
 		ReadFileSync(hFile, &objNumber, sizeof(DWORD), &bytesRead, NULL);
+		if( objNumber >= ARRAY_SIZE(StaticObjects) ) {
+			wsprintf(StringToShow, "LoadObjects(): Bad Static Object number (%d)", objNumber);
+			return FALSE;
+		}
 		ReadFileSync(hFile, &StaticObjects[objNumber].meshIndex, sizeof(__int16), &bytesRead, NULL);
 		ReadFileSync(hFile, &StaticObjects[objNumber].drawBounds, sizeof(STATIC_BOUNDS), &bytesRead, NULL);
 		ReadFileSync(hFile, &StaticObjects[objNumber].collisionBounds, sizeof(STATIC_BOUNDS), &bytesRead, NULL);
@@ -478,20 +682,7 @@ BOOL __cdecl LoadObjects(HANDLE hFile) {
 		return FALSE;
 	}
 	ReadFileSync(hFile, PhdTextureInfo, sizeof(PHD_TEXTURE)*TextureInfoCount, &bytesRead, NULL);
-	for( i = 0; i < TextureInfoCount; ++i ) {
-		LabTextureUVFlags[i] = 0;
-		uv = &PhdTextureInfo[i].uv[0].u;
-		for( j = 0; j < 8; ++j ) {
-			if( (uv[j] & 0x0080) != 0 ) {
-				uv[j] |= 0x00FF;
-				LabTextureUVFlags[i] |= (1 << j);
-			} else {
-				uv[j] &= 0xFF00;
-			}
-		}
-	}
-	AdjustTextureUVs(true);
-
+	SetupTextureInfos();
 	return TRUE;
 }
 
@@ -502,6 +693,10 @@ BOOL __cdecl LoadSprites(HANDLE hFile) {
 
 	// Load sprite infos
 	ReadFileSync(hFile, &dwCount, sizeof(DWORD), &bytesRead, NULL);
+	if( dwCount > ARRAY_SIZE(PhdSpriteInfo) ) {
+		lstrcpy(StringToShow, "Too many Sprites in level");
+		return FALSE;
+	}
 	ReadFileSync(hFile, PhdSpriteInfo, sizeof(PHD_SPRITE)*dwCount, &bytesRead, NULL);
 
 	// Assign sprites to objects
@@ -514,7 +709,7 @@ BOOL __cdecl LoadSprites(HANDLE hFile) {
 			Objects[objNumber].loaded = 1;
 		} else {
 			objNumber -= ID_NUMBER_OBJECTS;
-			SetFilePointer(hFile, sizeof(__int16), NULL, FILE_CURRENT); // StaticObjects don't have nMeshes (just one mesh)
+			SkipFileSync(hFile, sizeof(__int16)); // StaticObjects don't have nMeshes (just one mesh)
 			ReadFileSync(hFile, &StaticObjects[objNumber].meshIndex, sizeof(__int16), &bytesRead, NULL);
 		}
 	}
@@ -562,39 +757,10 @@ BOOL __cdecl LoadItems(HANDLE hFile) {
 }
 
 BOOL __cdecl LoadDepthQ(HANDLE hFile) {
-	int i, j;
 	DWORD bytesRead;
-	RGB888 paletteBuffer[256];
 
 	ReadFileSync(hFile, DepthQTable, 32*sizeof(DEPTHQ_ENTRY), &bytesRead, NULL);
-
-	for( i=0; i<32; ++i )
-		DepthQTable[i].index[0] = 0;
-
-	if( GameVid_IsWindowedVga ) {
-		CopyBitmapPalette(GamePalette8, DepthQTable[0].index, 32*sizeof(DEPTHQ_ENTRY), paletteBuffer);
-		SyncSurfacePalettes(DepthQTable, 256, 32, 256, GamePalette8, DepthQTable, 256, paletteBuffer, true);
-		memcpy(GamePalette8, paletteBuffer, sizeof(GamePalette8));
-		for( i=0; i<256; ++i ) {
-			DepthQIndex[i] = S_COLOUR(GamePalette8[i].red, GamePalette8[i].green, GamePalette8[i].blue);
-		}
-	} else {
-		memcpy(DepthQIndex, &DepthQTable[24], 256);
-	}
-
-	for( i=0; i<32; ++i ) {
-		for( j=0; j<256; ++j ) {
-			GouraudTable[j].index[i] = DepthQTable[i].index[j];
-		}
-	}
-
-	IsWet = 0;
-	for( i=0; i<256; ++i ) {
-		WaterPalette[i].red   = GamePalette8[i].red   * 2 / 3;
-		WaterPalette[i].green = GamePalette8[i].green * 2 / 3;
-		WaterPalette[i].blue  = GamePalette8[i].blue;
-	}
-
+	SetupDepthQ();
 	return TRUE;
 }
 
@@ -602,18 +768,7 @@ BOOL __cdecl LoadPalettes(HANDLE hFile) {
 	DWORD bytesRead;
 
 	ReadFileSync(hFile, GamePalette8, 256*sizeof(RGB888), &bytesRead, NULL);
-
-	GamePalette8[0].red = 0;
-	GamePalette8[0].green = 0;
-	GamePalette8[0].blue = 0;
-
-	for( int i=1; i<256; ++i ) {
-		// NOTE: the original code just shifts left 2 bits. But this way is slightly better
-		GamePalette8[i].red   = (GamePalette8[i].red   << 2) | (GamePalette8[i].red   >> 4);
-		GamePalette8[i].green = (GamePalette8[i].green << 2) | (GamePalette8[i].green >> 4);
-		GamePalette8[i].blue  = (GamePalette8[i].blue  << 2) | (GamePalette8[i].blue  >> 4);
-	}
-
+	ExpandGamePalette();
 	ReadFileSync(hFile, GamePalette16, 256*sizeof(PALETTEENTRY), &bytesRead, NULL);
 	return TRUE;
 }
@@ -674,7 +829,7 @@ BOOL __cdecl LoadBoxes(HANDLE hFile) {
 				(j == 1 && !Objects[ID_SPIDER_or_WOLF].loaded && !Objects[ID_SKIDOO_ARMED].loaded) ||
 				(j == 3 && !Objects[ID_YETI].loaded && !Objects[ID_WORKER3].loaded) )
 			{
-				SetFilePointer(hFile, sizeof(__int16)*BoxesCount, NULL, FILE_CURRENT); // skip some GroundZones
+				SkipFileSync(hFile, sizeof(__int16)*BoxesCount); // skip some GroundZones
 				continue;
 			}
 
@@ -749,43 +904,8 @@ void __cdecl LoadDemoExternal(LPCTSTR levelName) {
 	}
 }
 
-BOOL __cdecl LoadSamples(HANDLE hFile) {
-	int i, j;
-	DWORD bytesRead;
-	HANDLE hSfxFile;
+static BOOL LoadSampleBank(int *sampleIndexes, int sampleCount) {
 	LPCTSTR sfxFileName;
-	DWORD dataSize;
-	LPVOID waveData;
-	int sampleCount;
-	WAVEPCM_HEADER waveHeader;
-	LPWAVEFORMATEX waveFormat;
-	int sampleIndexes[500];
-
-	SoundIsActive = FALSE;
-	if( !WinSndIsSoundEnabled() ) {
-		return TRUE;
-	}
-	WinSndFreeAllSamples();
-
-	// Load Sample Lut
-	ReadFileSync(hFile, SampleLut, sizeof(SampleLut), &bytesRead, NULL);
-
-	// Load Sample Infos
-	ReadFileSync(hFile, &SampleInfoCount, sizeof(DWORD), &bytesRead, NULL);
-	if( SampleInfoCount == 0 ) {
-		return FALSE;
-	}
-	SampleInfos = (SAMPLE_INFO *)game_malloc(sizeof(SAMPLE_INFO)*SampleInfoCount, GBUF_SampleInfos);
-	ReadFileSync(hFile, SampleInfos, sizeof(SAMPLE_INFO)*SampleInfoCount, &bytesRead, NULL);
-
-	// Load Samples Count
-	ReadFileSync(hFile, &sampleCount, sizeof(int), &bytesRead, NULL);
-	if( sampleCount == 0 ) {
-		return FALSE;
-	}
-
-	// Load Samples Indexes
-	ReadFileSync(hFile, sampleIndexes, sizeof(DWORD)*sampleCount, &bytesRead, NULL);
 
 	// Open SFX file
 	sfxFileName = "data\\main.sfx";
@@ -796,6 +916,39 @@ BOOL __cdecl LoadSamples(HANDLE hFile) {
 	}
 #endif // FEATURE_GOLD
 	sfxFileName = GetFullPath(sfxFileName);
+
+#ifdef FEATURE_LOADING_IMPROVED
+	DWORD dataSize;
+	LPCVOID waveData;
+	WAVEFORMATEX waveFormat;
+
+	if( !SfxBankOpen(&MainSfxBank, sfxFileName) ) {
+		wsprintf(StringToShow, "Could not open MAIN.SFX file");
+		return FALSE;
+	}
+
+	// the index gives us the sample location, so only required samples are touched
+	double loadStart = UT_Microseconds();
+	for( int i = 0; i < sampleCount; ++i ) {
+		waveData = SfxBankGetSample(&MainSfxBank, sampleIndexes[i], &waveFormat, &dataSize);
+		if( waveData == NULL || !WinSndMakeSample(i, &waveFormat, (LPVOID)waveData, dataSize) ) {
+			SfxBankClose(&MainSfxBank);
+			return FALSE;
+		}
+	}
+	SfxBankClose(&MainSfxBank);
+	LoadReportPrint("LoadSamples(): %d of %d samples, index %s %.3f ms, samples %.3f ms",
+		sampleCount, MainSfxBank.count, MainSfxBank.isCached ? "cached" : "scanned",
+		MainSfxBank.indexTime * 1000.0, (UT_Microseconds() - loadStart) * 1000.0);
+#else // FEATURE_LOADING_IMPROVED
+	int i, j;
+	DWORD bytesRead;
+	HANDLE hSfxFile;
+	DWORD dataSize;
+	LPVOID waveData;
+	WAVEPCM_HEADER waveHeader;
+	LPWAVEFORMATEX waveFormat;
+
 	hSfxFile = CreateFile(sfxFileName, GENERIC_READ, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
 	if( hSfxFile == INVALID_HANDLE_VALUE ) {
 		wsprintf(StringToShow, "Could not open MAIN.SFX file");
@@ -831,6 +984,7 @@ BOOL __cdecl LoadSamples(HANDLE hFile) {
 		}
 	}
 	CloseHandle(hSfxFile);
+#endif // FEATURE_LOADING_IMPROVED
 	SoundIsActive = TRUE;
 #if defined(FEATURE_MOD_CONFIG)
 	LoadBareFootSFX(sampleIndexes, sampleCount);
@@ -838,6 +992,39 @@ BOOL __cdecl LoadSamples(HANDLE hFile) {
 	return TRUE;
 }
 
+BOOL __cdecl LoadSamples(HANDLE hFile) {
+	DWORD bytesRead;
+	int sampleCount;
+	int sampleIndexes[500];
+
+	SoundIsActive = FALSE;
+	if( !WinSndIsSoundEnabled() ) {
+		return TRUE;
+	}
+	WinSndFreeAllSamples();
+
+	// Load Sample Lut
+	ReadFileSync(hFile, SampleLut, sizeof(SampleLut), &bytesRead, NULL);
+
+	// Load Sample Infos
+	ReadFileSync(hFile, &SampleInfoCount, sizeof(DWORD), &bytesRead, NULL);
+	if( SampleInfoCount == 0 ) {
+		return FALSE;
+	}
+	SampleInfos = (SAMPLE_INFO *)game_malloc(sizeof(SAMPLE_INFO)*SampleInfoCount, GBUF_SampleInfos);
+	ReadFileSync(hFile, SampleInfos, sizeof(SAMPLE_INFO)*SampleInfoCount, &bytesRead, NULL);
+
+	// Load Samples Count
+	ReadFileSync(hFile, &sampleCount, sizeof(int), &bytesRead, NULL);
+	if( sampleCount <= 0 || sampleCount > (int)ARRAY_SIZE(sampleIndexes) ) {
+		return FALSE;
+	}
+
+	// Load Samples Indexes
+	ReadFileSync(hFile, sampleIndexes, sizeof(DWORD)*sampleCount, &bytesRead, NULL);
+	return LoadSampleBank(sampleIndexes, sampleCount);
+}
+
 void __cdecl ChangeFileNameExtension(char *fileName, const char *fileExt) {
 	char *fileNamePtr = fileName;
 
@@ -887,6 +1074,94 @@ BOOL __cdecl SelectDrive() {
 	return FALSE;
 }
 
+#ifdef FEATURE_LOADING_IMPROVED
+static LPCTSTR LoadSectionNames[] = {
+	"Palettes",
+	"Texture Pages",
+	"Rooms",
+	"Objects",
+	"Sprites",
+	"Cameras",
+	"Sound FX",
+	"Boxes",
+	"Animating Textures",
+	"Items",
+	"DepthQ",
+	"Cinematic",
+	"Demo",
+	"Samples",
+};
+
+static double LoadSectionTimes[ARRAY_SIZE(LoadSectionNames)];
+
+#define LOAD_SECTION(idx, func, hFile) { \
+	double sectionStart = UT_Microseconds(); \
+	BOOL sectionResult = func(hFile); \
+	LoadSectionTimes[idx] = UT_Microseconds() - sectionStart; \
+	if( !sectionResult || IsLevelViewTruncated ) goto EXIT; \
+}
+#else // FEATURE_LOADING_IMPROVED
+#define LOAD_SECTION(idx, func, hFile) { \
+	if( !func(hFile) ) goto EXIT; \
+}
+#endif // FEATURE_LOADING_IMPROVED
+
+static HANDLE OpenLevelFile(LPCTSTR fullPath) {
+#ifdef FEATURE_LOADING_IMPROVED
+	if( LevelFileViewEnabled ) {
+		IsLevelViewPrefetched = LevelPrefetchTake(fullPath, &LevelView);
+		if( IsLevelViewPrefetched || FileViewOpen(&LevelView, fullPath) ) {
+			IsLevelViewOpen = true;
+			return LEVEL_VIEW_HANDLE;
+		}
+		// if the file cannot be mapped, fall through to the regular file reading
+	}
+#endif // FEATURE_LOADING_IMPROVED
+	return CreateFile(fullPath, GENERIC_READ, 0, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN|FILE_ATTRIBUTE_NORMAL, NULL);
+}
+
+static void CloseLevelFile(HANDLE hFile) {
+#ifdef FEATURE_LOADING_IMPROVED
+	if( IsLevelViewOpen && hFile == LEVEL_VIEW_HANDLE ) {
+		FileViewClose(&LevelView);
+		IsLevelViewOpen = false;
+		if( IsLevelViewPrefetched ) {
+			LevelPrefetchRelease();
+			IsLevelViewPrefetched = false;
+		}
+		return;
+	}
+#endif // FEATURE_LOADING_IMPROVED
+	CloseHandle(hFile);
+}
+
+static void SetupSemitransMarks() {
+#ifdef FEATURE_LOADING_IMPROVED
+	double startTime = UT_Microseconds();
+	// the warm cache has got the draw types with texture infos already
+	if( LevelCacheApplyPaletteFlags() ) {
+		DerivedDataTime += UT_Microseconds() - startTime;
+		return;
+	}
+#endif // FEATURE_LOADING_IMPROVED
+#ifdef FEATURE_VIDEOFX_IMPROVED
+	MarkSemitransObjects();
+	MarkSemitransTextureRanges();
+#endif // FEATURE_VIDEOFX_IMPROVED
+#ifdef FEATURE_LOADING_IMPROVED
+	DerivedDataTime += UT_Microseconds() - startTime;
+#endif // FEATURE_LOADING_IMPROVED
+}
+
+#ifdef FEATURE_LOADING_IMPROVED
+void PrefetchLevelFile(LPCTSTR fileName) {
+	// the prefetched level is parsed from memory, so it requires the file view loader
+	if( LevelFileViewEnabled && LevelPrefetchEnabled && fileName != NULL && *fileName ) {
+		LevelPrefetchStart(GetFullPath(fileName));
+	}
+}
+#endif // FEATURE_LOADING_IMPROVED
+
 BOOL __cdecl LoadLevel(LPCTSTR fileName, int levelID) {
 	BOOL result = FALSE;
 	LPCTSTR fullPath;
@@ -899,13 +1174,24 @@ BOOL __cdecl LoadLevel(LPCTSTR fileName, int levelID) {
 	strcpy(LevelFileName, fullPath);
 	init_game_malloc();
 
-	hFile = CreateFile(fullPath, GENERIC_READ, 0, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN|FILE_ATTRIBUTE_NORMAL, NULL);
+	hFile = OpenLevelFile(fullPath);
 	if( hFile == INVALID_HANDLE_VALUE ) {
 		wsprintf(StringToShow, "LoadLevel(): Could not open %s (level %d)", fullPath, levelID);
 		return FALSE;
 	}
 
-	ReadFileSync(hFile, &levelVersion, sizeof(levelVersion), &bytesRead, NULL);
+#ifdef FEATURE_LOADING_IMPROVED
+	memset(LoadSectionTimes, 0, sizeof(LoadSectionTimes));
+	IsLevelViewTruncated = false;
+	DerivedDataTime = 0.0;
+	if( IsLevelViewOpen ) {
+		LevelCacheBegin(fullPath, LevelView.data, LevelView.size);
+	}
+#endif // FEATURE_LOADING_IMPROVED
+
+	if( !ReadFileSync(hFile, &levelVersion, sizeof(levelVersion), &bytesRead, NULL) ) {
+		goto EXIT;
+	}
 	if( levelVersion != REQ_LEVEL_VERSION ) {
 		if( levelVersion < REQ_LEVEL_VERSION )
 			wsprintf(StringToShow, "FATAL: Level %d (%s) is OUT OF DATE (version %d). COPY NEW EDITOR", levelID, fullPath, fileName);
@@ -914,47 +1200,43 @@ BOOL __cdecl LoadLevel(LPCTSTR fileName, int levelID) {
 		goto EXIT;
 	}
 
-	LevelFilePalettesOffset = SetFilePointer(hFile, 0, NULL, FILE_CURRENT);
-	if( !LoadPalettes(hFile) ) {
-		goto EXIT;
-	}
+	LevelFilePalettesOffset = TellFileSync(hFile);
+	LOAD_SECTION(0, LoadPalettes, hFile);
 
-	LevelFileTexPagesOffset = SetFilePointer(hFile, 0, NULL, FILE_CURRENT);
-	if( !LoadTexturePages(hFile) ) {
-		goto EXIT;
-	}
+	LevelFileTexPagesOffset = TellFileSync(hFile);
+	LOAD_SECTION(1, LoadTexturePages, hFile);
 
 	ReadFileSync(hFile, &reserved, sizeof(reserved), &bytesRead, NULL);
-	if( !LoadRooms(hFile) ||
-		!LoadObjects(hFile) ||
-		!LoadSprites(hFile) ||
-		!LoadCameras(hFile) ||
-		!LoadSoundEffects(hFile) ||
-		!LoadBoxes(hFile) ||
-		!LoadAnimatedTextures(hFile) ||
-		!LoadItems(hFile) )
-	{
-		goto EXIT;
-	}
-
-	LevelFileDepthQOffset = SetFilePointer(hFile, 0, NULL, FILE_CURRENT);
-	if( !LoadDepthQ(hFile) ||
-		!LoadCinematic(hFile) ||
-		!LoadDemo(hFile) ||
-		!LoadSamples(hFile) )
-	{
-		goto EXIT;
-	}
+	LOAD_SECTION(2, LoadRooms, hFile);
+	LOAD_SECTION(3, LoadObjects, hFile);
+	LOAD_SECTION(4, LoadSprites, hFile);
+	LOAD_SECTION(5, LoadCameras, hFile);
+	LOAD_SECTION(6, LoadSoundEffects, hFile);
+	LOAD_SECTION(7, LoadBoxes, hFile);
+	LOAD_SECTION(8, LoadAnimatedTextures, hFile);
+	LOAD_SECTION(9, LoadItems, hFile);
+
+	LevelFileDepthQOffset = TellFileSync(hFile);
+	LOAD_SECTION(10, LoadDepthQ, hFile);
+	LOAD_SECTION(11, LoadCinematic, hFile);
+	LOAD_SECTION(12, LoadDemo, hFile);
+	LOAD_SECTION(13, LoadSamples, hFile);
 
 	LoadDemoExternal(fullPath);
-#ifdef FEATURE_VIDEOFX_IMPROVED
-	MarkSemitransObjects();
-	MarkSemitransTextureRanges();
-#endif // FEATURE_VIDEOFX_IMPROVED
+	SetupSemitransMarks();
+#ifdef FEATURE_EXTENDED_LIMITS
+	GameMemoryReport(fileName);
+#endif // FEATURE_EXTENDED_LIMITS
 	result = TRUE;
 
 EXIT :
-	CloseHandle(hFile);
+	CloseLevelFile(hFile);
+#ifdef FEATURE_LOADING_IMPROVED
+	LevelCacheEnd(result, DerivedDataTime);
+	for( DWORD i = 0; i < ARRAY_SIZE(LoadSectionNames); ++i ) {
+		LoadReportPrint("LoadLevel(%s): %-20s %8.3f ms", fileName, LoadSectionNames[i], LoadSectionTimes[i] * 1000.0);
+	}
+#endif // FEATURE_LOADING_IMPROVED
 	return result;
 }
 
@@ -988,6 +1270,19 @@ void __cdecl S_UnloadLevelFile() {
 	memset(TexturePageBuffer8, 0, sizeof(TexturePageBuffer8));
 	*LevelFileName = 0;
 	TextureInfoCount = 0;
+#ifdef FEATURE_RENDER_IMPROVED
+	// the decoded frames point to the animations of this level
+	AnimCacheReset();
+	// the stored portal walk points to the rooms of this level
+	RoomVisibilityReset();
+	// the room light grids point to the rooms of this level
+	S_ResetRoomLightGrids();
+#endif // FEATURE_RENDER_IMPROVED
+#ifdef FEATURE_LOADING_IMPROVED
+	// the decoded doors point to the rooms of this level
+	FloorTableFree();
+	LevelCacheReset();
+#endif // FEATURE_LOADING_IMPROVED
 #ifdef FEATURE_MOD_CONFIG
 	UnloadModConfiguration();
 #endif // FEATURE_MOD_CONFIG
@@ -1012,6 +1307,10 @@ BOOL __cdecl S_ReloadLevelGraphics(BOOL reloadPalettes, BOOL reloadTexPages) {
 			LoadPalettes(hFile);
 			SetFilePointer(hFile, LevelFileDepthQOffset, NULL, FILE_BEGIN);
 			LoadDepthQ(hFile);
+#ifdef FEATURE_LOADING_IMPROVED
+			// the palette is read again, so its semitransparency flags are restored
+			LevelCacheApplyPaletteFlags();
+#endif // FEATURE_LOADING_IMPROVED
 		}
 
 		if( reloadTexPages ) {
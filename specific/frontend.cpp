@@ -29,6 +29,10 @@
 #include "specific/utils.h"
 #include "global/vars.h"
 
+#ifdef FEATURE_RENDER_IMPROVED
+#include "modding/frame_pacing.h"
+#endif // FEATURE_RENDER_IMPROVED
+
 #ifdef FEATURE_HUD_IMPROVED
 #include "3dsystem/3dinsert.h"
 
@@ -206,7 +210,11 @@ void __cdecl S_Wait(int timeout, BOOL inputCheck) {
 			break;
 		S_UpdateInput();
 		if( IsGameToExit ) return; // NOTE: this line is not in the original game
+#ifdef FEATURE_RENDER_IMPROVED
+		ticks = PacingWaitTick();
+#else // FEATURE_RENDER_IMPROVED
 		while( 0 == (ticks = Sync()) ) /* just wait a tick */;
+#endif // FEATURE_RENDER_IMPROVED
 	}
 
 	// Wait for key event to set or timeout
@@ -215,7 +223,11 @@ void __cdecl S_Wait(int timeout, BOOL inputCheck) {
 		if( IsGameToExit ) return; // NOTE: this line is not in the original game
 		if( inputCheck && InputStatus != 0 )
 			break;
+#ifdef FEATURE_RENDER_IMPROVED
+		ticks = PacingWaitTick();
+#else // FEATURE_RENDER_IMPROVED
 		while( 0 == (ticks = Sync()) ) /* just wait a tick */;
+#endif // FEATURE_RENDER_IMPROVED
 	}
 }
 
@@ -39,12 +39,22 @@
 #include "specific/sndpc.h"
 #include "specific/winvid.h"
 #include "specific/texture.h"
+#include "modding/profiler.h"
 #include "global/vars.h"
 
 #ifdef FEATURE_BACKGROUND_IMPROVED
 #include "modding/background_new.h"
 #endif // FEATURE_BACKGROUND_IMPROVED
 
+#ifdef FEATURE_RENDER_IMPROVED
+#include "modding/frame_interp.h"
+#include "specific/utils.h"
+
+bool RenderInterpolationEnabled = false;
+extern bool IsFrameSyncSkipped;
+extern bool IsTextureAnimSkipped;
+#endif // FEATURE_RENDER_IMPROVED
+
 #ifdef FEATURE_GOLD
 extern bool IsGold();
 #endif // FEATURE_GOLD
@@ -135,9 +145,53 @@ int __cdecl GameLoop(BOOL demoMode) {
 	NoInputCounter = 0;
 
 	result = ControlPhase(1, demoMode);
+#ifdef FEATURE_RENDER_IMPROVED
+	// The control phase keeps its fixed tick, but the frames are drawn at display rate.
+	// Every frame shows the items and the camera between the last two control ticks.
+	bool isInterpolated = RenderInterpolationEnabled;
+	int pendingTicks = 0;
+	double tickTime = UT_Microseconds();
+	FrameInterpReset();
+	FrameInterpRecordTick();
+#endif // FEATURE_RENDER_IMPROVED
 	while( result == 0 ) {
+		PROFILE_FRAME();
+		PROFILE_ENTER(PROF_Draw);
+#ifdef FEATURE_RENDER_IMPROVED
+		bool isApplied = isInterpolated && FrameInterpApply((UT_Microseconds() - tickTime) * FRAMES_PER_SECOND);
+		IsFrameSyncSkipped = isInterpolated;
+		IsTextureAnimSkipped = isInterpolated;
+		nFrames = DrawPhaseGame();
+		IsFrameSyncSkipped = false;
+		IsTextureAnimSkipped = false;
+		if( isApplied ) {
+			FrameInterpRestore();
+		}
+#else // FEATURE_RENDER_IMPROVED
 		nFrames = DrawPhaseGame();
+#endif // FEATURE_RENDER_IMPROVED
+		PROFILE_LEAVE(PROF_Draw);
+#ifdef FEATURE_RENDER_IMPROVED
+		if( isInterpolated ) {
+			pendingTicks += nFrames;
+			if( pendingTicks < TICKS_PER_FRAME && !IsGameToExit ) {
+				continue;
+			}
+			nFrames = pendingTicks;
+			pendingTicks = 0;
+			// the wibble and the light flicker step once per control tick, as without interpolation
+			S_AnimateTextures(nFrames);
+		}
+#endif // FEATURE_RENDER_IMPROVED
+		PROFILE_ENTER(PROF_Control);
 		result = IsGameToExit ? GF_EXIT_GAME : ControlPhase(nFrames, demoMode);
+		PROFILE_LEAVE(PROF_Control);
+#ifdef FEATURE_RENDER_IMPROVED
+		if( isInterpolated ) {
+			FrameInterpRecordTick();
+			tickTime = UT_Microseconds();
+		}
+#endif // FEATURE_RENDER_IMPROVED
 	}
 
 	S_SoundStopAllSamples();
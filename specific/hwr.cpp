@@ -23,12 +23,17 @@
 #include "specific/hwr.h"
 #include "specific/init_display.h"
 #include "specific/texture.h"
+#include "modding/profiler.h"
 #include "global/vars.h"
 
 #ifdef FEATURE_HUD_IMPROVED
 #include "modding/psx_bar.h"
 #endif // FEATURE_HUD_IMPROVED
 
+#ifdef FEATURE_RENDER_IMPROVED
+#include "modding/texture_atlas.h"
+#endif // FEATURE_RENDER_IMPROVED
+
 #ifdef FEATURE_VIDEOFX_IMPROVED
 extern HWR_TEXHANDLE GetEnvmapTextureHandle();
 
@@ -92,6 +97,9 @@ static void DrawAlphaBlended(D3DTLVERTEX *vtxPtr, DWORD vtxCount, DWORD mode) {
 	if( AlphaBlendMode == 2 ) {
 		SetBlendMode(vtxPtr, vtxCount, mode, 1);
 		D3DDev->DrawPrimitive(D3DPT_TRIANGLEFAN, D3D_TLVERTEX, vtxPtr, vtxCount, D3DDP_DONOTUPDATEEXTENTS|D3DDP_DONOTCLIP);
+#ifdef FEATURE_RENDER_IMPROVED
+		PROFILE_COUNT(PROF_HwrDrawCalls, 1);
+#endif // FEATURE_RENDER_IMPROVED
 	}
 	// return render states to default values
 	D3DDev->SetRenderState(D3DRENDERSTATE_SRCBLEND, D3DBLEND_SRCALPHA);
@@ -112,6 +120,140 @@ static void DrawAlphaBlended(D3DTLVERTEX *vtxPtr, DWORD vtxCount, DWORD mode) {
 }
 #endif // FEATURE_VIDEOFX_IMPROVED
 
+#ifdef FEATURE_RENDER_IMPROVED
+// The indices are WORD, and a DrawIndexedPrimitive call takes up to 0xFFFF
+// vertices, so a batch is flushed before it would pass these limits
+#define BATCH_VERTICES	(0x8000)
+#define BATCH_INDICES	(0xFFFF)
+#define BATCH_POLYS		(0x2000)
+#define BATCH_KEYS		(64)
+
+typedef struct BatchPoly_t {
+	DWORD key;
+	DWORD vtxIndex;
+	DWORD vtxCount;
+} BATCH_POLY;
+
+typedef struct BatchKey_t {
+	HWR_TEXHANDLE texSource;
+	bool colorKey;
+	DWORD polyCount;
+} BATCH_KEY;
+
+bool PrimitiveBatchingEnabled = true;
+
+static D3DTLVERTEX BatchVertices[BATCH_VERTICES];
+static D3DTLVERTEX BatchDrawVertices[BATCH_VERTICES];
+static WORD BatchIndices[BATCH_INDICES];
+static BATCH_POLY BatchPolys[BATCH_POLYS];
+static WORD BatchOrder[BATCH_POLYS];
+static BATCH_KEY BatchKeys[BATCH_KEYS];
+static DWORD BatchVertexCount = 0;
+static DWORD BatchIndexCount = 0;
+static DWORD BatchPolyCount = 0;
+static DWORD BatchKeyCount = 0;
+
+static void DrawBatchKey(BATCH_KEY *key, WORD *order) {
+	DWORD vtxCount = 0;
+	DWORD idxCount = 0;
+
+	for( DWORD i = 0; i < key->polyCount; ++i ) {
+		BATCH_POLY *poly = &BatchPolys[order[i]];
+		memcpy(&BatchDrawVertices[vtxCount], &BatchVertices[poly->vtxIndex], sizeof(D3DTLVERTEX) * poly->vtxCount);
+		// triangle fan to triangle list
+		for( DWORD j = 1; j < poly->vtxCount - 1; ++j ) {
+			BatchIndices[idxCount++] = vtxCount;
+			BatchIndices[idxCount++] = vtxCount + j;
+			BatchIndices[idxCount++] = vtxCount + j + 1;
+		}
+		vtxCount += poly->vtxCount;
+	}
+	HWR_TexSource(key->texSource);
+	HWR_EnableColorKey(key->colorKey);
+	D3DDev->DrawIndexedPrimitive(D3DPT_TRIANGLELIST, D3D_TLVERTEX, BatchDrawVertices, vtxCount, BatchIndices, idxCount, D3DDP_DONOTUPDATEEXTENTS|D3DDP_DONOTCLIP);
+	PROFILE_COUNT(PROF_HwrDrawCalls, 1);
+}
+
+void HWR_FlushBatches() {
+	DWORD offsets[BATCH_KEYS];
+	DWORD offset = 0;
+
+	if( BatchPolyCount == 0 ) {
+		return;
+	}
+
+	// group polys by their key keeping the insertion order inside of the group
+	for( DWORD i = 0; i < BatchKeyCount; ++i ) {
+		offsets[i] = offset;
+		offset += BatchKeys[i].polyCount;
+	}
+	for( DWORD i = 0; i < BatchPolyCount; ++i ) {
+		BatchOrder[offsets[BatchPolys[i].key]++] = i;
+	}
+
+	// opaque groups go first, so the colorkeyed ones are drawn over the filled Z-Buffer
+	for( int pass = 0; pass < 2; ++pass ) {
+		for( DWORD i = 0; i < BatchKeyCount; ++i ) {
+			if( BatchKeys[i].colorKey == (pass != 0) ) {
+				DrawBatchKey(&BatchKeys[i], &BatchOrder[offsets[i] - BatchKeys[i].polyCount]);
+			}
+		}
+	}
+
+	BatchVertexCount = 0;
+	BatchIndexCount = 0;
+	BatchPolyCount = 0;
+	BatchKeyCount = 0;
+}
+
+// Z-Buffered polys may be drawn in any order, so they are collected by
+// texture and colorkey state and drawn as one indexed list per state
+void HWR_DrawPolyFan(HWR_TEXHANDLE texSource, bool colorKey, D3DTLVERTEX *vtxPtr, DWORD vtxCount) {
+	DWORD key;
+	DWORD idxCount = (vtxCount - 2) * 3;
+
+	// a fan that does not fit even an empty batch is drawn as is
+	if( !PrimitiveBatchingEnabled || !SavedAppSettings.ZBuffer || vtxCount < 3 ||
+		vtxCount > BATCH_VERTICES || idxCount > BATCH_INDICES )
+	{
+		HWR_TexSource(texSource);
+		HWR_EnableColorKey(colorKey);
+		D3DDev->DrawPrimitive(D3DPT_TRIANGLEFAN, D3D_TLVERTEX, vtxPtr, vtxCount, D3DDP_DONOTUPDATEEXTENTS|D3DDP_DONOTCLIP);
+		PROFILE_COUNT(PROF_HwrDrawCalls, 1);
+		return;
+	}
+
+	if( BatchPolyCount >= BATCH_POLYS ||
+		BatchVertexCount + vtxCount > BATCH_VERTICES ||
+		BatchIndexCount + idxCount > BATCH_INDICES )
+	{
+		HWR_FlushBatches();
+	}
+	for( key = 0; key < BatchKeyCount; ++key ) {
+		if( BatchKeys[key].texSource == texSource && BatchKeys[key].colorKey == colorKey ) break;
+	}
+	if( key == BatchKeyCount ) {
+		if( BatchKeyCount >= BATCH_KEYS ) {
+			HWR_FlushBatches();
+			key = 0;
+		}
+		BatchKeys[key].texSource = texSource;
+		BatchKeys[key].colorKey = colorKey;
+		BatchKeys[key].polyCount = 0;
+		BatchKeyCount = key + 1;
+	}
+
+	BATCH_POLY *poly = &BatchPolys[BatchPolyCount++];
+	poly->key = key;
+	poly->vtxIndex = BatchVertexCount;
+	poly->vtxCount = vtxCount;
+	memcpy(&BatchVertices[BatchVertexCount], vtxPtr, sizeof(D3DTLVERTEX) * vtxCount);
+	BatchVertexCount += vtxCount;
+	BatchIndexCount += idxCount;
+	++BatchKeys[key].polyCount;
+}
+#endif // FEATURE_RENDER_IMPROVED
+
 void __cdecl HWR_InitState() {
 	D3DDev->SetRenderState(D3DRENDERSTATE_FILLMODE, D3DFILL_SOLID);
 	D3DDev->SetRenderState(D3DRENDERSTATE_SHADEMODE, D3DSHADE_GOURAUD);
@@ -185,6 +327,10 @@ void __cdecl HWR_TexSource(HWR_TEXHANDLE texSource) {
 		D3DDev->SetRenderState(D3DRENDERSTATE_TEXTUREHANDLE, texSource);
 #endif // (DIRECT3D_VERSION >= 0x700)
 		CurrentTexSource = texSource;
+#ifdef FEATURE_RENDER_IMPROVED
+		PROFILE_COUNT(PROF_HwrStateChanges, 1);
+		PROFILE_COUNT(PROF_HwrTexBinds, 1);
+#endif // FEATURE_RENDER_IMPROVED
 	}
 }
 
@@ -195,6 +341,9 @@ void __cdecl HWR_EnableColorKey(bool state) {
 		else
 			D3DDev->SetRenderState(D3DRENDERSTATE_COLORKEYENABLE, state ? TRUE : FALSE);
 		ColorKeyState = state;
+#ifdef FEATURE_RENDER_IMPROVED
+		PROFILE_COUNT(PROF_HwrStateChanges, 1);
+#endif // FEATURE_RENDER_IMPROVED
 	}
 }
 
@@ -202,6 +351,14 @@ void __cdecl HWR_EnableZBuffer(bool ZWriteEnable, bool ZEnable) {
 	if( !SavedAppSettings.ZBuffer )
 		return;
 
+#ifdef FEATURE_RENDER_IMPROVED
+	// the batched polys must be drawn with the Z-Buffer state they were inserted with
+	if( ZWriteEnableState != ZWriteEnable || ZEnableState != ZEnable ) {
+		HWR_FlushBatches();
+		PROFILE_COUNT(PROF_HwrStateChanges, 1);
+	}
+#endif // FEATURE_RENDER_IMPROVED
+
 	if( ZWriteEnableState != ZWriteEnable ) {
 		D3DDev->SetRenderState(D3DRENDERSTATE_ZWRITEENABLE, ZWriteEnable ? TRUE : FALSE);
 		ZWriteEnableState = ZWriteEnable;
@@ -228,6 +385,10 @@ void __cdecl HWR_DrawPolyList() {
 	UINT16 polyType, texPage, vtxCount;
 	D3DTLVERTEX *vtxPtr;
 
+	PROFILE_ENTER(PROF_DrawPolyList);
+#ifdef FEATURE_RENDER_IMPROVED
+	HWR_FlushBatches();
+#endif // FEATURE_RENDER_IMPROVED
 	HWR_EnableZBuffer(false, true);
 	for( DWORD i=0; i<SurfaceCount; ++i ) {
 		bufPtr = (UINT16 *)SortBuffer[i]._0;
@@ -325,7 +486,11 @@ void __cdecl HWR_DrawPolyList() {
 				D3DDev->SetRenderState(AlphaBlendEnabler, alphaState);
 				break;
 		}
+#ifdef FEATURE_RENDER_IMPROVED
+		PROFILE_COUNT(PROF_HwrDrawCalls, 1);
+#endif // FEATURE_RENDER_IMPROVED
 	}
+	PROFILE_LEAVE(PROF_DrawPolyList);
 }
 
 void __cdecl HWR_LoadTexturePages(int pagesCount, LPVOID pagesBuffer, RGB888 *palette) {
@@ -337,6 +502,13 @@ void __cdecl HWR_LoadTexturePages(int pagesCount, LPVOID pagesBuffer, RGB888 *pa
 	if( palette != NULL )
 		PaletteIndex = CreateTexturePalette(palette);
 
+#ifdef FEATURE_RENDER_IMPROVED
+	if( AtlasLoadTexturePages(pagesCount, bufferPtr, palette != NULL, PaletteIndex, HWR_TexturePageIndexes) ) {
+		HWR_GetPageHandles();
+		return;
+	}
+#endif // FEATURE_RENDER_IMPROVED
+
 	for( int i=0; i<pagesCount; ++i ) {
 		if( palette != NULL ) {
 			pageIndex = AddTexturePage8(256, 256, bufferPtr, PaletteIndex);
@@ -351,6 +523,9 @@ void __cdecl HWR_LoadTexturePages(int pagesCount, LPVOID pagesBuffer, RGB888 *pa
 }
 
 void __cdecl HWR_FreeTexturePages() {
+#ifdef FEATURE_RENDER_IMPROVED
+	AtlasFreeTexturePages();
+#endif // FEATURE_RENDER_IMPROVED
 
 	for( DWORD i=0; i<ARRAY_SIZE(HWR_TexturePageIndexes); ++i ) {
 		if( HWR_TexturePageIndexes[i] >= 0 ) {
@@ -24,9 +24,29 @@
 #include "3dsystem/phd_math.h"
 #include "specific/game.h"
 #include "specific/winmain.h"
+#include "modding/load_report.h"
 #include "global/vars.h"
 #include <time.h>
 
+#ifdef FEATURE_LOADING_IMPROVED
+#include "modding/level_prefetch.h"
+#endif // FEATURE_LOADING_IMPROVED
+
+#ifdef FEATURE_SCREENSHOT_IMPROVED
+#include "modding/video_capture.h"
+#endif // FEATURE_SCREENSHOT_IMPROVED
+
+#ifdef FEATURE_BACKGROUND_IMPROVED
+#include "modding/pixel_convert.h"
+#endif // FEATURE_BACKGROUND_IMPROVED
+
+#ifdef FEATURE_RENDER_IMPROVED
+#include "3dsystem/3d_gen.h"
+#include "modding/anim_cache.h"
+#include "modding/frame_pacing.h"
+#include "modding/palette_lut.h"
+#endif // FEATURE_RENDER_IMPROVED
+
 // related to GAMEALLOC_BUFFER enum
 static LPCTSTR BufferNames[] = {
 	"Temp Alloc",
@@ -78,6 +98,116 @@ static LPCTSTR BufferNames[] = {
 	"Sprite Infos",
 };
 
+#ifdef FEATURE_EXTENDED_LIMITS
+// The game memory is an arena of chained chunks. The first chunk is the main
+// game memory block, the next ones are allocated when the level does not fit.
+// Every allocation is recorded, so game_free() knows the category and chunk.
+#define GAME_CHUNK_SIZE		(0x400000) // 4 MB
+#define GAME_CHUNKS_MAX		(32)
+
+typedef struct GameChunk_t {
+	BYTE *data;
+	DWORD size;
+	DWORD used;
+} GAME_CHUNK;
+
+typedef struct GameAllocRecord_t {
+	DWORD size;
+	BYTE bufIndex;
+	BYTE chunkIndex;
+} GAME_ALLOC_RECORD;
+
+static GAME_CHUNK GameChunks[GAME_CHUNKS_MAX];
+static DWORD GameChunkCount = 0;
+static DWORD GameChunkCurrent = 0;
+
+static GAME_ALLOC_RECORD *GameAllocRecords = NULL;
+static DWORD GameAllocRecordCount = 0;
+static DWORD GameAllocRecordCapacity = 0;
+
+static DWORD GameBufferUsed[ARRAY_SIZE(BufferNames)];
+static DWORD GameBufferPeak[ARRAY_SIZE(BufferNames)];
+static DWORD GameAllocPeak = 0;
+
+static void SyncGameAllocState() {
+	// the original code sees the current chunk only
+	GAME_CHUNK *chunk = &GameChunks[GameChunkCurrent];
+	GameAllocMemPointer = chunk->data + chunk->used;
+	GameAllocMemFree = chunk->size - chunk->used;
+}
+
+static GAME_CHUNK *GetGameChunk(DWORD size) {
+	// the chunks after the current one are empty
+	for( DWORD i = GameChunkCurrent + 1; i < GameChunkCount; ++i ) {
+		if( GameChunks[i].size >= size ) {
+			GameChunkCurrent = i;
+			return &GameChunks[i];
+		}
+	}
+	if( GameChunkCount >= GAME_CHUNKS_MAX ) {
+		return NULL;
+	}
+	GAME_CHUNK *chunk = &GameChunks[GameChunkCount];
+	chunk->size = MAX(GAME_CHUNK_SIZE, size);
+	chunk->used = 0;
+	chunk->data = (BYTE *)GlobalAlloc(GMEM_FIXED, chunk->size);
+	if( chunk->data == NULL ) {
+		return NULL;
+	}
+	GameChunkCurrent = GameChunkCount++;
+	return chunk;
+}
+
+static bool AddGameAllocRecord(DWORD size, DWORD bufIndex) {
+	if( GameAllocRecordCount >= GameAllocRecordCapacity ) {
+		DWORD capacity = MAX(GameAllocRecordCapacity * 2, 1024);
+		GAME_ALLOC_RECORD *records = (GAME_ALLOC_RECORD *)realloc(GameAllocRecords, sizeof(GAME_ALLOC_RECORD) * capacity);
+		if( records == NULL ) {
+			return false;
+		}
+		GameAllocRecords = records;
+		GameAllocRecordCapacity = capacity;
+	}
+	GAME_ALLOC_RECORD *record = &GameAllocRecords[GameAllocRecordCount++];
+	record->size = size;
+	record->bufIndex = bufIndex;
+	record->chunkIndex = GameChunkCurrent;
+
+	GameAllocMemUsed += size;
+	GameBufferUsed[bufIndex] += size;
+	CLAMPL(GameBufferPeak[bufIndex], GameBufferUsed[bufIndex]);
+	CLAMPL(GameAllocPeak, GameAllocMemUsed);
+	return true;
+}
+
+static DWORD FreeGameAllocRecord(DWORD size) {
+	GAME_ALLOC_RECORD *record = &GameAllocRecords[GameAllocRecordCount - 1];
+	CLAMPG(size, record->size);
+	record->size -= size;
+	GameChunks[record->chunkIndex].used -= size;
+	GameBufferUsed[record->bufIndex] -= size;
+	GameAllocMemUsed -= size;
+	if( record->size == 0 ) {
+		--GameAllocRecordCount;
+	}
+	return size;
+}
+
+void GameMemoryReport(LPCTSTR title) {
+	DWORD reserved = 0;
+	for( DWORD i = 0; i < GameChunkCount; ++i ) {
+		reserved += GameChunks[i].size;
+	}
+	LoadReportPrint("Memory(%s): used %d, peak %d, reserved %d bytes in %d chunks",
+		title, GameAllocMemUsed, GameAllocPeak, reserved, GameChunkCount);
+	for( DWORD i = 0; i < ARRAY_SIZE(BufferNames); ++i ) {
+		if( GameBufferPeak[i] != 0 ) {
+			LoadReportPrint("Memory(%s): %-20s %8d bytes, peak %8d bytes", title, BufferNames[i], GameBufferUsed[i], GameBufferPeak[i]);
+		}
+	}
+}
+#endif // FEATURE_EXTENDED_LIMITS
+
 BOOL __cdecl S_InitialiseSystem() {
 	S_SeedRandom();
 	DumpX = 0;
@@ -94,6 +224,36 @@ BOOL __cdecl S_InitialiseSystem() {
 }
 
 void __cdecl ShutdownGame() {
+#ifdef FEATURE_LOADING_IMPROVED
+	LevelPrefetchCancel();
+#endif // FEATURE_LOADING_IMPROVED
+#ifdef FEATURE_SCREENSHOT_IMPROVED
+	VideoCaptureStop();
+#endif // FEATURE_SCREENSHOT_IMPROVED
+#ifdef FEATURE_BACKGROUND_IMPROVED
+	PixelConvertFree();
+#endif // FEATURE_BACKGROUND_IMPROVED
+#ifdef FEATURE_RENDER_IMPROVED
+	PaletteLutFree();
+	FreeRasterBands();
+	PacingShutdown();
+	AnimCacheReset();
+#endif // FEATURE_RENDER_IMPROVED
+#ifdef FEATURE_EXTENDED_LIMITS
+	// the first chunk is the main game memory block, it is released below
+	for( DWORD i = 1; i < GameChunkCount; ++i ) {
+		GlobalFree(GameChunks[i].data);
+	}
+	memset(GameChunks, 0, sizeof(GameChunks));
+	GameChunkCount = 0;
+	GameChunkCurrent = 0;
+	if( GameAllocRecords != NULL ) {
+		free(GameAllocRecords);
+		GameAllocRecords = NULL;
+	}
+	GameAllocRecordCount = 0;
+	GameAllocRecordCapacity = 0;
+#endif // FEATURE_EXTENDED_LIMITS
 	if( GameMemoryPointer != NULL ) {
 		GlobalFree(GameMemoryPointer);
 		GameMemoryPointer = NULL;
@@ -101,13 +261,45 @@ void __cdecl ShutdownGame() {
 }
 
 void __cdecl init_game_malloc() {
+#ifdef FEATURE_EXTENDED_LIMITS
+	// the extra chunks are kept for the next level, they are most likely needed again
+	GameChunks[0].data = GameMemoryPointer;
+	GameChunks[0].size = GameMemorySize;
+	CLAMPL(GameChunkCount, 1);
+	for( DWORD i = 0; i < GameChunkCount; ++i ) {
+		GameChunks[i].used = 0;
+	}
+	GameChunkCurrent = 0;
+	GameAllocRecordCount = 0;
+	GameAllocPeak = 0;
+	memset(GameBufferUsed, 0, sizeof(GameBufferUsed));
+	memset(GameBufferPeak, 0, sizeof(GameBufferPeak));
+	GameAllocMemUsed = 0;
+	SyncGameAllocState();
+#else // FEATURE_EXTENDED_LIMITS
 	GameAllocMemPointer = GameMemoryPointer;
 	GameAllocMemFree = GameMemorySize;
 	GameAllocMemUsed = 0;
+#endif // FEATURE_EXTENDED_LIMITS
 }
 
 void *__cdecl game_malloc(DWORD allocSize, DWORD bufIndex) {
 	DWORD alignedSize = (allocSize + 3) & ~3;
+#ifdef FEATURE_EXTENDED_LIMITS
+	GAME_CHUNK *chunk = &GameChunks[GameChunkCurrent];
+	if( alignedSize > chunk->size - chunk->used ) {
+		chunk = GetGameChunk(alignedSize);
+	}
+	if( chunk == NULL || !AddGameAllocRecord(alignedSize, bufIndex) ) {
+		wsprintf(StringToShow, "game_malloc(): OUT OF MEMORY %s %d", BufferNames[bufIndex], alignedSize);
+		S_ExitSystem(StringToShow);
+		return NULL; // the app is terminated here
+	}
+	void *result = chunk->data + chunk->used;
+	chunk->used += alignedSize;
+	SyncGameAllocState();
+	return result;
+#else // FEATURE_EXTENDED_LIMITS
 	if( alignedSize > GameAllocMemFree ) {
 		wsprintf(StringToShow, "game_malloc(): OUT OF MEMORY %s %d", BufferNames[bufIndex], alignedSize);
 		S_ExitSystem(StringToShow);
@@ -119,14 +311,24 @@ void *__cdecl game_malloc(DWORD allocSize, DWORD bufIndex) {
 	GameAllocMemUsed += alignedSize;
 	GameAllocMemPointer += alignedSize;
 	return result;
+#endif // FEATURE_EXTENDED_LIMITS
 }
 
 void __cdecl game_free(DWORD freeSize) {
 	DWORD alignedSize = (freeSize + 3) & ~3;
 
+#ifdef FEATURE_EXTENDED_LIMITS
+	// the freed size may cover several allocations from the top
+	while( alignedSize > 0 && GameAllocRecordCount > 0 ) {
+		alignedSize -= FreeGameAllocRecord(alignedSize);
+	}
+	GameChunkCurrent = GameAllocRecordCount ? GameAllocRecords[GameAllocRecordCount - 1].chunkIndex : 0;
+	SyncGameAllocState();
+#else // FEATURE_EXTENDED_LIMITS
 	GameAllocMemPointer -= alignedSize;
 	GameAllocMemFree += alignedSize;
 	GameAllocMemUsed -= alignedSize;
+#endif // FEATURE_EXTENDED_LIMITS
 }
 
 void __cdecl CalculateWibbleTable() {
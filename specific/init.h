@@ -35,4 +35,8 @@ void __cdecl game_free(DWORD freeSize); // 0x0044D800
 void __cdecl CalculateWibbleTable(); // 0x0044D840
 void __cdecl S_SeedRandom(); // 0x0044D930
 
+#ifdef FEATURE_EXTENDED_LIMITS
+void GameMemoryReport(LPCTSTR title);
+#endif // FEATURE_EXTENDED_LIMITS
+
 #endif // INIT_H_INCLUDED
@@ -23,6 +23,26 @@
 #include "specific/init_sound.h"
 #include "global/vars.h"
 
+#ifdef FEATURE_AUDIO_IMPROVED
+#include "modding/sound_mixer.h"
+
+extern bool SoundMixerEnabled;
+
+static bool IsSoundMixerFailed = false;
+
+// The mixer is started with the first sample, since the settings are loaded after the sound start
+static bool UseSoundMixer() {
+	if( IsMixerActive() ) {
+		return true;
+	}
+	if( !SoundMixerEnabled || IsSoundMixerFailed || DSound == NULL || !IsSoundEnabled ) {
+		return false;
+	}
+	IsSoundMixerFailed = !MixerStart(DSound);
+	return !IsSoundMixerFailed;
+}
+#endif // FEATURE_AUDIO_IMPROVED
+
 extern void __thiscall FlaggedStringCreate(STRING_FLAGGED *item, DWORD dwSize);
 extern void __thiscall FlaggedStringDelete(STRING_FLAGGED *item);
 extern bool FlaggedStringCopy(STRING_FLAGGED *dst, STRING_FLAGGED *src);
@@ -43,6 +63,9 @@ void __cdecl WinSndFreeAllSamples() {
 	if( !IsSoundEnabled )
 		return;
 
+#ifdef FEATURE_AUDIO_IMPROVED
+	MixerFreeAllSamples();
+#endif // FEATURE_AUDIO_IMPROVED
 	for( int i=0; i<256; ++i ) {
 		if( SampleBuffers[i] != NULL ) {
 			SampleBuffers[i]->Release();
@@ -59,6 +82,13 @@ bool __cdecl WinSndMakeSample(DWORD sampleIdx, LPWAVEFORMATEX format, const LPVO
 	if( DSound == NULL || !IsSoundEnabled || sampleIdx >= 256 )
 		return false;
 
+#ifdef FEATURE_AUDIO_IMPROVED
+	if( UseSoundMixer() ) {
+		SampleFreqs[sampleIdx] = format->nSamplesPerSec;
+		return MixerMakeSample(sampleIdx, format, data, dataSize);
+	}
+#endif // FEATURE_AUDIO_IMPROVED
+
 	// NOTE: this check is absent in the original game
 	if( SampleBuffers[sampleIdx] != NULL ) {
 		SampleBuffers[sampleIdx]->Release();
@@ -87,6 +117,11 @@ bool __cdecl WinSndMakeSample(DWORD sampleIdx, LPWAVEFORMATEX format, const LPVO
 }
 
 bool __cdecl WinSndIsChannelPlaying(DWORD channel) {
+#ifdef FEATURE_AUDIO_IMPROVED
+	if( IsMixerActive() ) {
+		return MixerIsVoicePlaying(channel);
+	}
+#endif // FEATURE_AUDIO_IMPROVED
 	DWORD status;
 
 	if( ChannelBuffers[channel] == NULL || FAILED(ChannelBuffers[channel]->GetStatus(&status)) )
@@ -103,6 +138,11 @@ bool __cdecl WinSndIsChannelPlaying(DWORD channel) {
 
 int __cdecl WinSndPlaySample(DWORD sampleIdx, int volume, DWORD pitch, int pan, DWORD flags) {
 	LPDIRECTSOUNDBUFFER dsBuffer = NULL;
+#ifdef FEATURE_AUDIO_IMPROVED
+	if( UseSoundMixer() ) {
+		return MixerPlaySample(sampleIdx, volume, pitch, pan, CHK_ANY(flags, DSBPLAY_LOOPING));
+	}
+#endif // FEATURE_AUDIO_IMPROVED
 	int channel = WinSndGetFreeChannelIndex();
 
 	if( channel < 0 )
@@ -139,6 +179,12 @@ int __cdecl WinSndGetFreeChannelIndex() {
 }
 
 void __cdecl WinSndAdjustVolumeAndPan(int channel, int volume, int pan) {
+#ifdef FEATURE_AUDIO_IMPROVED
+	if( IsMixerActive() ) {
+		MixerAdjustVolumeAndPan(channel, volume, pan);
+		return;
+	}
+#endif // FEATURE_AUDIO_IMPROVED
 	if( channel >= 0 && ChannelBuffers[channel] != NULL ) {
 		ChannelBuffers[channel]->SetVolume(volume);
 		ChannelBuffers[channel]->SetPan(pan);
@@ -146,12 +192,24 @@ void __cdecl WinSndAdjustVolumeAndPan(int channel, int volume, int pan) {
 }
 
 void __cdecl WinSndAdjustPitch(int channel, DWORD pitch) {
+#ifdef FEATURE_AUDIO_IMPROVED
+	if( IsMixerActive() ) {
+		MixerAdjustPitch(channel, pitch);
+		return;
+	}
+#endif // FEATURE_AUDIO_IMPROVED
 	if( channel >= 0 && ChannelBuffers[channel] != NULL ) {
 		ChannelBuffers[channel]->SetFrequency(SampleFreqs[ChannelSamples[channel]] * pitch / PHD_ONE);
 	}
 }
 
 void __cdecl WinSndStopSample(int channel) {
+#ifdef FEATURE_AUDIO_IMPROVED
+	if( IsMixerActive() ) {
+		MixerStopSample(channel);
+		return;
+	}
+#endif // FEATURE_AUDIO_IMPROVED
 	if( channel >= 0 && ChannelBuffers[channel] != NULL ) {
 		ChannelBuffers[channel]->Stop();
 		ChannelBuffers[channel]->Release();
@@ -232,6 +290,9 @@ void __cdecl WinSndStart(HWND hWnd) {
 
 	IsLaraMicEnabled = SavedAppSettings.LaraMic;
 	IsSoundEnabled = false;
+#ifdef FEATURE_AUDIO_IMPROVED
+	IsSoundMixerFailed = false;
+#endif // FEATURE_AUDIO_IMPROVED
 
 	if( !SavedAppSettings.SoundEnabled || SavedAppSettings.PreferredSoundAdapter == NULL )
 		return;
@@ -287,6 +348,9 @@ bool __cdecl DSoundBufferTest() {
 }
 
 void __cdecl WinSndFinish() {
+#ifdef FEATURE_AUDIO_IMPROVED
+	MixerStop();
+#endif // FEATURE_AUDIO_IMPROVED
 	WinSndFreeAllSamples();
 	if( DSound != NULL ) {
 		DSound->Release();
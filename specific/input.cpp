@@ -28,8 +28,25 @@
 #include "specific/init_input.h"
 #include "specific/screenshot.h"
 #include "specific/winvid.h"
+#include "modding/profiler.h"
 #include "global/vars.h"
 
+#ifdef FEATURE_PROFILER
+#include "modding/render_snapshot.h"
+#endif // FEATURE_PROFILER
+
+#ifdef FEATURE_RENDER_IMPROVED
+#include "modding/frame_pacing.h"
+#endif // FEATURE_RENDER_IMPROVED
+
+#ifdef FEATURE_SCREENSHOT_IMPROVED
+#include "modding/video_capture.h"
+#endif // FEATURE_SCREENSHOT_IMPROVED
+
+#ifdef FEATURE_AUDIO_IMPROVED
+#include "modding/sound_mixer.h"
+#endif // FEATURE_AUDIO_IMPROVED
+
 // Macros
 #define KEY_DOWN(a)		((DIKeys[(a)]&0x80)!=0)
 #define TOGGLE(a)		{(a)=!(a);}
@@ -82,6 +99,9 @@ bool __cdecl S_UpdateInput() {
 	static bool isF4KeyPressed = false;
 	static bool isF7KeyPressed = false;
 	static bool isF8KeyPressed = false;
+#ifdef FEATURE_PROFILER
+	static bool isF9KeyPressed = false; // +
+#endif // FEATURE_PROFILER
 	static bool isF11KeyPressed = false;
 	static bool isF12KeyPressed = false; // +
 	static BYTE mediPackCooldown;
@@ -228,6 +248,12 @@ bool __cdecl S_UpdateInput() {
 #endif // FEATURE_SCREENSHOT_IMPROVED
 		if( !isScreenShotKeyPressed ) {
 			isScreenShotKeyPressed = true;
+#ifdef FEATURE_SCREENSHOT_IMPROVED
+			if( KEY_DOWN(DIK_LSHIFT) || KEY_DOWN(DIK_RSHIFT) ) {
+				// Start/stop video capture (Shift + BackSpace)
+				VideoCaptureToggle();
+			} else
+#endif // FEATURE_SCREENSHOT_IMPROVED
 			ScreenShot(PrimaryBufferSurface);
 		}
 	} else {
@@ -245,6 +271,38 @@ bool __cdecl S_UpdateInput() {
 	// Shift Key check
 	isShiftKeyPressed = KEY_DOWN(DIK_LSHIFT) || KEY_DOWN(DIK_RSHIFT);
 
+#ifdef FEATURE_PROFILER
+	// Profiler F9 key
+	if( KEY_DOWN(DIK_F9) ) {
+		if( !isF9KeyPressed ) {
+			isF9KeyPressed = true;
+			if( KEY_DOWN(DIK_LCONTROL) || KEY_DOWN(DIK_RCONTROL) ) {
+				if( isShiftKeyPressed ) {
+					// Replay render snapshots (Ctrl + Shift + F9)
+					RenderBenchmarkRun();
+				} else {
+					// Capture render snapshot (Ctrl + F9)
+					RenderSnapshotRequest();
+				}
+			} else if( isShiftKeyPressed ) {
+				// Dump Chrome trace (Shift + F9)
+				ProfilerDumpTrace();
+#ifdef FEATURE_RENDER_IMPROVED
+				PacingDumpReport();
+#endif // FEATURE_RENDER_IMPROVED
+#ifdef FEATURE_AUDIO_IMPROVED
+				MixerDumpReport();
+#endif // FEATURE_AUDIO_IMPROVED
+			} else {
+				// Profiler overlay (F9)
+				ProfilerToggleOverlay();
+			}
+		}
+	} else {
+		isF9KeyPressed = false;
+	}
+#endif // FEATURE_PROFILER
+
 	// Graphics option toggles
 	if( SavedAppSettings.RenderMode == RM_Software ) {
 
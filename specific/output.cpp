@@ -33,8 +33,21 @@
 #include "specific/texture.h"
 #include "specific/utils.h"
 #include "specific/winvid.h"
+#include "modding/profiler.h"
 #include "global/vars.h"
 
+#ifdef FEATURE_PROFILER
+#include "modding/render_snapshot.h"
+#endif // FEATURE_PROFILER
+
+#ifdef FEATURE_SCREENSHOT_IMPROVED
+#include "modding/video_capture.h"
+#endif // FEATURE_SCREENSHOT_IMPROVED
+
+#ifdef FEATURE_RENDER_IMPROVED
+#include "modding/frame_pacing.h"
+#endif // FEATURE_RENDER_IMPROVED
+
 #ifdef FEATURE_HUD_IMPROVED
 #include "modding/psx_bar.h"
 
@@ -149,12 +162,31 @@ void __cdecl S_InitialisePolyList(BOOL clearBackBuffer) {
 #endif // FEATURE_VIDEOFX_IMPROVED
 }
 
+#ifdef FEATURE_RENDER_IMPROVED
+bool IsFrameSyncSkipped = false; // the game loop draws interpolated frames between the control ticks
+bool IsTextureAnimSkipped = false; // the game loop animates the textures once per control tick
+#endif // FEATURE_RENDER_IMPROVED
+
 DWORD __cdecl S_DumpScreen() {
+	PROFILE_ENTER(PROF_Sync);
 	DWORD ticks = Sync();
+#ifdef FEATURE_RENDER_IMPROVED
+	while( !IsFrameSyncSkipped && ticks < TICKS_PER_FRAME ) {
+		PacingWaitTick();
+		ticks++;
+	}
+	PacingFrameDone(ticks);
+#else // FEATURE_RENDER_IMPROVED
 	while( ticks < TICKS_PER_FRAME ) {
 		while( !Sync() ) /* just wait for new frame */;
 		ticks++;
 	}
+#endif // FEATURE_RENDER_IMPROVED
+	PROFILE_LEAVE(PROF_Sync);
+#ifdef FEATURE_SCREENSHOT_IMPROVED
+	// the frame is copied before the flip, the encoding goes in the background
+	VideoCaptureFrame(ticks);
+#endif // FEATURE_SCREENSHOT_IMPROVED
 	ScreenPartialDump();
 	return ticks;
 }
@@ -184,9 +216,13 @@ void __cdecl S_InitialiseScreen(GF_LEVEL_TYPE levelType) {
 void __cdecl S_OutputPolyList() {
 	DDSDESC desc;
 
+	PROFILE_ENTER(PROF_OutputPolyList);
 	if( SavedAppSettings.RenderMode == RM_Software ) {
 		// Software renderer
 		phd_SortPolyList();
+#ifdef FEATURE_PROFILER
+		RenderSnapshotCapture();
+#endif // FEATURE_PROFILER
 		if SUCCEEDED(WinVidBufferLock(RenderBufferSurface, &desc, DDLOCK_WRITEONLY|DDLOCK_WAIT)) {
 			phd_PrintPolyList((BYTE *)desc.lpSurface);
 			WinVidBufferUnlock(RenderBufferSurface, &desc);
@@ -199,6 +235,7 @@ void __cdecl S_OutputPolyList() {
 		HWR_DrawPolyList();
 		D3DDev->EndScene();
 	}
+	PROFILE_LEAVE(PROF_OutputPolyList);
 }
 
 int __cdecl S_GetObjectBounds(__int16 *bPtr) {
@@ -526,6 +563,115 @@ void __cdecl S_CalculateStaticMeshLight(int x, int y, int z, int shade1, int sha
 	S_CalculateStaticLight(adder);
 }
 
+#ifdef FEATURE_RENDER_IMPROVED
+// Room vertices are bucketed by 1024x1024 floor sectors (XZ plane), so a dynamic
+// light touches the vertices of the sectors its radius covers only.
+// The room geometry is static, so the grid is built once per room per level.
+typedef struct RoomLightGrid_t {
+	int cellsX;
+	int cellsZ;
+	UINT16 *cellStart; // cellsX*cellsZ+1 offsets into the vertex index list
+	UINT16 *vertices;
+} ROOM_LIGHT_GRID;
+
+bool RoomLightGridEnabled = true;
+static ROOM_LIGHT_GRID *RoomLightGrids[0x400];
+
+static int GetLightGridCell(int pos, int cells) {
+	pos >>= WALL_SHIFT;
+	CLAMP(pos, 0, cells - 1);
+	return pos;
+}
+
+static ROOM_LIGHT_GRID *GetRoomLightGrid(ROOM_INFO *room) {
+	int roomNumber = room - RoomInfo;
+	if( roomNumber < 0 || roomNumber >= (int)ARRAY_SIZE(RoomLightGrids) ) {
+		return NULL;
+	}
+	if( RoomLightGrids[roomNumber] != NULL ) {
+		return RoomLightGrids[roomNumber];
+	}
+
+	int vtxCount = *room->data;
+	ROOM_VERTEX_INFO *roomVtx = (ROOM_VERTEX_INFO *)(room->data + 1);
+	int xMax = 0, zMax = 0;
+	for( int i = 0; i < vtxCount; ++i ) {
+		CLAMPL(xMax, roomVtx[i].x);
+		CLAMPL(zMax, roomVtx[i].z);
+	}
+
+	ROOM_LIGHT_GRID *grid = new ROOM_LIGHT_GRID;
+	if( grid == NULL ) {
+		return NULL;
+	}
+	grid->cellsX = (xMax >> WALL_SHIFT) + 1;
+	grid->cellsZ = (zMax >> WALL_SHIFT) + 1;
+	int cellCount = grid->cellsX * grid->cellsZ;
+	grid->cellStart = new UINT16[cellCount + 1];
+	grid->vertices = new UINT16[MAX(vtxCount, 1)];
+	if( grid->cellStart == NULL || grid->vertices == NULL ) {
+		delete[] grid->cellStart;
+		delete[] grid->vertices;
+		delete grid;
+		return NULL;
+	}
+
+	// counting sort of the vertex indices by sector, the indices stay ascending inside a sector
+	memset(grid->cellStart, 0, sizeof(UINT16) * (cellCount + 1));
+	for( int i = 0; i < vtxCount; ++i ) {
+		int cell = GetLightGridCell(roomVtx[i].z, grid->cellsZ) * grid->cellsX + GetLightGridCell(roomVtx[i].x, grid->cellsX);
+		++grid->cellStart[cell + 1];
+	}
+	for( int i = 0; i < cellCount; ++i ) {
+		grid->cellStart[i + 1] += grid->cellStart[i];
+	}
+	for( int i = 0; i < vtxCount; ++i ) {
+		int cell = GetLightGridCell(roomVtx[i].z, grid->cellsZ) * grid->cellsX + GetLightGridCell(roomVtx[i].x, grid->cellsX);
+		grid->vertices[grid->cellStart[cell]++] = i;
+	}
+	// the start offsets were shifted by the previous loop, so restore them
+	for( int i = cellCount; i > 0; --i ) {
+		grid->cellStart[i] = grid->cellStart[i - 1];
+	}
+	grid->cellStart[0] = 0;
+
+	RoomLightGrids[roomNumber] = grid;
+	return grid;
+}
+
+void S_ResetRoomLightGrids() {
+	for( DWORD i = 0; i < ARRAY_SIZE(RoomLightGrids); ++i ) {
+		if( RoomLightGrids[i] != NULL ) {
+			delete[] RoomLightGrids[i]->cellStart;
+			delete[] RoomLightGrids[i]->vertices;
+			delete RoomLightGrids[i];
+			RoomLightGrids[i] = NULL;
+		}
+	}
+}
+
+static void LightRoomVertex(ROOM_VERTEX_INFO *vtx, int xPos, int yPos, int zPos, int radius, int falloff, int intensity) {
+	if( vtx->lightAdder == 0 ) {
+		return;
+	}
+	int xDist = vtx->x - xPos;
+	int yDist = vtx->y - yPos;
+	int zDist = vtx->z - zPos;
+	if( (xDist >= -radius && xDist <= radius) &&
+		(yDist >= -radius && yDist <= radius) &&
+		(zDist >= -radius && zDist <= radius) )
+	{
+		int distance = SQR(xDist) + SQR(yDist) + SQR(zDist);
+		if( distance <= SQR(radius) ) {
+			int shade = (1 << intensity) - (distance >> (2 * falloff - intensity));
+			vtx->lightAdder -= shade;
+			if( vtx->lightAdder < 0 )
+				vtx->lightAdder = 0;
+		}
+	}
+}
+#endif // FEATURE_RENDER_IMPROVED
+
 void __cdecl S_LightRoom(ROOM_INFO *room) {
 	int i, j;
 	int shade, falloff, intensity;
@@ -569,6 +715,25 @@ void __cdecl S_LightRoom(ROOM_INFO *room) {
 
 		if( xPos + radius >= xMin && zPos + radius >= zMin && xPos - radius <= xMax && zPos - radius <= zMax ) {
 			room->flags |= 0x10;
+#ifdef FEATURE_RENDER_IMPROVED
+			// Every vertex is in one sector only, and the lights are still applied
+			// to each vertex in the same order, so the result is exactly the same
+			ROOM_LIGHT_GRID *grid = RoomLightGridEnabled ? GetRoomLightGrid(room) : NULL;
+			if( grid != NULL ) {
+				roomVtx = (ROOM_VERTEX_INFO *)(room->data + 1);
+				int x0 = GetLightGridCell(xPos - radius, grid->cellsX);
+				int x1 = GetLightGridCell(xPos + radius, grid->cellsX);
+				int z0 = GetLightGridCell(zPos - radius, grid->cellsZ);
+				int z1 = GetLightGridCell(zPos + radius, grid->cellsZ);
+				for( int z = z0; z <= z1; ++z ) {
+					UINT16 *cellStart = &grid->cellStart[z * grid->cellsX];
+					for( j = cellStart[x0]; j < cellStart[x1 + 1]; ++j ) {
+						LightRoomVertex(&roomVtx[grid->vertices[j]], xPos, yPos, zPos, radius, falloff, intensity);
+					}
+				}
+				continue;
+			}
+#endif // FEATURE_RENDER_IMPROVED
 			roomVtxCount = *room->data;
 			roomVtx = (ROOM_VERTEX_INFO *)(room->data + 1);
 			for( j = 0; j < roomVtxCount; ++j ) {
@@ -786,6 +951,11 @@ void __cdecl S_SetupAboveWater(BOOL underwater) {
 }
 
 void __cdecl S_AnimateTextures(int nFrames) {
+#ifdef FEATURE_RENDER_IMPROVED
+	if( IsTextureAnimSkipped ) {
+		return;
+	}
+#endif // FEATURE_RENDER_IMPROVED
 	WibbleOffset = (WibbleOffset + nFrames/2) % WIBBLE_SIZE;
 	RoomLightShades[1] = GetRandomDraw() & (WIBBLE_SIZE-1);
 	RoomLightShades[2] = (WIBBLE_SIZE-1) * (phd_sin(WibbleOffset * PHD_360 / WIBBLE_SIZE) + PHD_IONE) / 2 / PHD_IONE;
@@ -60,6 +60,10 @@
 #define REG_INVTEXTBOX_MODE		"InvTextBoxMode"
 #define REG_HEALTHBAR_MODE		"HealthBarMode"
 #define REG_SCREENSHOT_FORMAT	"ScreenshotFormat"
+#define REG_VIDEO_CAPTURE_FORMAT	"VideoCaptureFormat"
+#define REG_FRAME_PACING		"FramePacing"
+#define REG_ANIM_CACHE_SIZE		"AnimCacheSize"
+#define REG_SOUND_MIXER_OUTPUT	"SoundMixerOutput"
 
 // BOOL value names
 #define REG_PERSPECTIVE			"PerspectiveCorrect"
@@ -79,6 +83,23 @@
 #define REG_PSXFOV_ENABLE		"EnablePsxFov"
 #define REG_BAREFOOT_SFX_ENABLE	"BarefootSFX"
 #define REG_REMASTER_PIX_ENABLE	"RemasteredPictures"
+#define REG_LEVEL_FILEVIEW		"LevelFileMapping"
+#define REG_LEVEL_PREFETCH		"LevelPrefetch"
+#define REG_LEVEL_CACHE			"LevelDataCache"
+#define REG_FLOOR_DOOR_TABLE	"FloorDoorTable"
+#define REG_LOADING_REPORT		"LoadingReport"
+#define REG_RADIX_SORT			"RadixSortPolyList"
+#define REG_SIMD_VERTEX			"SimdVertexTransform"
+#define REG_BATCH_PRIMITIVES	"BatchPrimitives"
+#define REG_ROOM_LIGHT_GRID		"RoomLightGrid"
+#define REG_PALETTE_LUT			"PaletteLookup"
+#define REG_BAND_RASTER			"ParallelSoftwareRenderer"
+#define REG_SIMD_SPAN			"SimdTextureMapper"
+#define REG_SIMD_PIXEL			"SimdPixelConvert"
+#define REG_RENDER_INTERP		"RenderInterpolation"
+#define REG_TEXTURE_ATLAS		"TextureAtlas"
+#define REG_ROOM_WALK_REUSE		"RoomWalkReuse"
+#define REG_SOUND_MIXER			"SoundMixer"
 
 // FLOAT value names
 #define REG_GAME_SIZER		"Sizer"
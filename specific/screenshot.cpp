@@ -22,6 +22,7 @@
 #include "global/precompiled.h"
 #include "specific/screenshot.h"
 #include "specific/winvid.h"
+#include "modding/image_codec.h"
 #include "global/vars.h"
 
 #ifdef FEATURE_SCREENSHOT_IMPROVED
@@ -308,85 +309,25 @@ void __cdecl ScreenShotPCX() {
 
 
 DWORD __cdecl CompPCX(BYTE *bitmap, DWORD width, DWORD height, RGB888 *palette, BYTE **pcxData) {
-	DWORD i;
-	PCX_HEADER *pcxHeader;
-	BYTE *picData;
+	IMAGE_FRAME frame;
 
-	*pcxData = (BYTE *)GlobalAlloc(GMEM_FIXED, width*height*2 + sizeof(PCX_HEADER) + sizeof(RGB888)*256);
+	*pcxData = (BYTE *)GlobalAlloc(GMEM_FIXED, ImageBoundPCX(width, height));
 	if( *pcxData == NULL )
 		return 0;
 
-	pcxHeader = *(PCX_HEADER **)pcxData;
-
-	pcxHeader->manufacturer = 10;
-	pcxHeader->version = 5;
-	pcxHeader->rle = 1;
-	pcxHeader->bpp = 8;
-	pcxHeader->planes = 1;
-
-	pcxHeader->xMin = 0;
-	pcxHeader->yMin = 0;
-	pcxHeader->xMax = width - 1;
-	pcxHeader->yMax = height - 1;
-	pcxHeader->h_dpi = width;
-	pcxHeader->v_dpi = height;
-	pcxHeader->bytesPerLine = width;
-
-	picData = *pcxData + sizeof(PCX_HEADER);
-	for( i=0; i<height; ++i ) {
-		picData += EncodeLinePCX(bitmap, width, picData);
-		bitmap += width;
-	}
-
-	*(picData++) = 0x0C;
-	memcpy(picData, palette, sizeof(RGB888)*256);
-
-	return (DWORD)(picData - *pcxData + sizeof(RGB888)*256); // pcx data size
+	memset(&frame, 0, sizeof(frame));
+	frame.width = width;
+	frame.height = height;
+	frame.pitch = width;
+	frame.bpp = 8;
+	frame.pixels = bitmap;
+	frame.palette = (uint8_t *)palette;
+	return ImageWritePCX(&frame, *pcxData); // pcx data size
 }
 
 
 DWORD __cdecl EncodeLinePCX(BYTE *src, DWORD width, BYTE *dst) {
-	BYTE current, add;
-	DWORD total = 0;
-	BYTE runCount = 1;
-	BYTE last = *src;
-
-	for( DWORD i=1; i<width; ++i ) {
-		current = *(++src);
-		if( current == last ) {
-			++runCount;
-			if( runCount == 63 ) {
-				add = EncodePutPCX(last, runCount, dst);
-				if( add == 0 ) {
-					return 0;
-				}
-				total += add;
-				dst += add;
-				runCount = 0;
-			}
-		} else {
-			if( runCount != 0 ) {
-				add = EncodePutPCX(last, runCount, dst);
-				if( add == 0 ) {
-					return 0;
-				}
-				total += add;
-				dst += add;
-			}
-			last = current;
-			runCount = 1;
-		}
-	}
-
-	if( runCount ) {
-		add = EncodePutPCX(last, runCount, dst);
-		if( add == 0) {
-			return 0;
-		}
-		total += add;
-		dst += add;
-	}
-	return total;
+	return ImageEncodeLinePCX(src, width, dst);
 }
 
 
@@ -60,6 +60,7 @@ extern DWORD InvBackgroundMode;
 extern DWORD PictureStretchLimit;
 extern bool LoadingScreensEnabled;
 extern bool RemasteredPixEnabled;
+extern bool SimdPixelEnabled;
 #endif // FEATURE_BACKGROUND_IMPROVED
 
 #ifdef FEATURE_VIDEOFX_IMPROVED
@@ -73,15 +74,43 @@ extern bool CustomWaterColorEnabled;
 #ifdef FEATURE_SCREENSHOT_IMPROVED
 extern DWORD ScreenshotFormat;
 extern char ScreenshotPath[MAX_PATH];
+extern DWORD VideoCaptureFormat;
 #endif // FEATURE_SCREENSHOT_IMPROVED
 
 #ifdef FEATURE_MOD_CONFIG
 extern bool BarefootSfxEnabled;
 #endif // FEATURE_MOD_CONFIG
 
+#ifdef FEATURE_LOADING_IMPROVED
+extern bool LevelFileViewEnabled;
+extern bool LevelPrefetchEnabled;
+extern bool LevelCacheEnabled;
+extern bool FloorDoorTableEnabled;
+extern bool LoadReportEnabled;
+#endif // FEATURE_LOADING_IMPROVED
+
+#ifdef FEATURE_RENDER_IMPROVED
+#include "modding/frame_pacing.h"
+
+extern bool PolySortRadixEnabled;
+extern bool SimdVertexEnabled;
+extern bool PrimitiveBatchingEnabled;
+extern bool RoomLightGridEnabled;
+extern bool PaletteLutEnabled;
+extern bool BandRasterEnabled;
+extern bool SimdSpanEnabled;
+extern bool RenderInterpolationEnabled;
+extern bool TextureAtlasEnabled;
+extern bool RoomWalkReuseEnabled;
+extern DWORD FramePacingMode;
+extern DWORD AnimCacheSize;
+#endif // FEATURE_RENDER_IMPROVED
+
 #ifdef FEATURE_AUDIO_IMPROVED
 extern double InventoryMusicMute;
 extern double UnderwaterMusicMute;
+extern bool SoundMixerEnabled;
+extern DWORD SoundMixerOutput;
 #endif // FEATURE_AUDIO_IMPROVED
 
 #ifdef FEATURE_VIEW_IMPROVED
@@ -139,7 +168,7 @@ BOOL __cdecl GameMain() {
 		HWR_InitState();
 	}
 
-	GameMemoryPointer = (BYTE *)GlobalAlloc(GMEM_FIXED, 0x380000); // 3.5 MB
+	GameMemoryPointer = (BYTE *)GlobalAlloc(GMEM_FIXED, GameMemorySize); // set in S_InitialiseSystem
 	if( GameMemoryPointer == NULL ) {
 		lstrcpy(StringToShow, "GameMain: could not allocate malloc_buffer");
 		return FALSE;
@@ -523,6 +552,7 @@ void __cdecl S_LoadSettings() {
 	GetRegistryBoolValue(REG_REMASTER_PIX_ENABLE, &RemasteredPixEnabled, true);
 	GetRegistryBoolValue(REG_LOADING_SCREENS, &LoadingScreensEnabled, false);
 	GetRegistryStringValue(REG_PICTURE_SUFFIX, PictureSuffix, sizeof(PictureSuffix), "");
+	GetRegistryBoolValue(REG_SIMD_PIXEL, &SimdPixelEnabled, true);
 #endif // FEATURE_BACKGROUND_IMPROVED
 
 #ifdef FEATURE_VIDEOFX_IMPROVED
@@ -539,6 +569,8 @@ void __cdecl S_LoadSettings() {
 #ifdef FEATURE_SCREENSHOT_IMPROVED
 	GetRegistryDwordValue(REG_SCREENSHOT_FORMAT, &ScreenshotFormat, 0);
 	GetRegistryStringValue(REG_SCREENSHOT_PATH, ScreenshotPath, sizeof(ScreenshotPath), ".\\screenshots");
+	GetRegistryDwordValue(REG_VIDEO_CAPTURE_FORMAT, &VideoCaptureFormat, 1);
+	CLAMPG(VideoCaptureFormat, 2);
 #endif // FEATURE_SCREENSHOT_IMPROVED
 
 #ifdef FEATURE_ASSAULT_SAVE
@@ -550,6 +582,9 @@ void __cdecl S_LoadSettings() {
 	GetRegistryFloatValue(REG_UW_MUSIC_MUTE, &UnderwaterMusicMute, 1.0);
 	CLAMP(InventoryMusicMute, 0.0, 1.0);
 	CLAMP(UnderwaterMusicMute, 0.0, 1.0);
+	GetRegistryBoolValue(REG_SOUND_MIXER, &SoundMixerEnabled, true);
+	GetRegistryDwordValue(REG_SOUND_MIXER_OUTPUT, &SoundMixerOutput, 0);
+	CLAMPG(SoundMixerOutput, 2);
 #endif // FEATURE_AUDIO_IMPROVED
 
 #ifdef FEATURE_VIEW_IMPROVED
@@ -560,6 +595,31 @@ void __cdecl S_LoadSettings() {
 	GetRegistryBoolValue(REG_BAREFOOT_SFX_ENABLE, &BarefootSfxEnabled, false);
 #endif // FEATURE_MOD_CONFIG
 
+#ifdef FEATURE_LOADING_IMPROVED
+	GetRegistryBoolValue(REG_LEVEL_FILEVIEW, &LevelFileViewEnabled, true);
+	GetRegistryBoolValue(REG_LEVEL_PREFETCH, &LevelPrefetchEnabled, true);
+	GetRegistryBoolValue(REG_LEVEL_CACHE, &LevelCacheEnabled, true);
+	GetRegistryBoolValue(REG_FLOOR_DOOR_TABLE, &FloorDoorTableEnabled, true);
+	GetRegistryBoolValue(REG_LOADING_REPORT, &LoadReportEnabled, false);
+#endif // FEATURE_LOADING_IMPROVED
+
+#ifdef FEATURE_RENDER_IMPROVED
+	GetRegistryBoolValue(REG_RADIX_SORT, &PolySortRadixEnabled, false);
+	GetRegistryBoolValue(REG_SIMD_VERTEX, &SimdVertexEnabled, true);
+	GetRegistryBoolValue(REG_BATCH_PRIMITIVES, &PrimitiveBatchingEnabled, true);
+	GetRegistryBoolValue(REG_ROOM_LIGHT_GRID, &RoomLightGridEnabled, true);
+	GetRegistryBoolValue(REG_PALETTE_LUT, &PaletteLutEnabled, true);
+	GetRegistryBoolValue(REG_BAND_RASTER, &BandRasterEnabled, true);
+	GetRegistryBoolValue(REG_SIMD_SPAN, &SimdSpanEnabled, true);
+	GetRegistryBoolValue(REG_RENDER_INTERP, &RenderInterpolationEnabled, false);
+	GetRegistryBoolValue(REG_TEXTURE_ATLAS, &TextureAtlasEnabled, true);
+	GetRegistryBoolValue(REG_ROOM_WALK_REUSE, &RoomWalkReuseEnabled, true);
+	GetRegistryDwordValue(REG_FRAME_PACING, &FramePacingMode, PACE_Sleep);
+	CLAMPG(FramePacingMode, PACE_VSync);
+	GetRegistryDwordValue(REG_ANIM_CACHE_SIZE, &AnimCacheSize, 8);
+	CLAMPG(AnimCacheSize, 64);
+#endif // FEATURE_RENDER_IMPROVED
+
 #ifdef FEATURE_GOLD
 	if( IsGold() ) {
 		// This RJF check is presented in "The Golden Mask" only
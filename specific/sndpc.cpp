@@ -29,6 +29,8 @@
 #include "global/vars.h"
 
 #ifdef FEATURE_AUDIO_IMPROVED
+#include "modding/sound_mixer.h"
+
 double InventoryMusicMute = 1.0;
 double UnderwaterMusicMute = 1.0;
 #endif // FEATURE_AUDIO_IMPROVED
@@ -91,9 +93,16 @@ void __cdecl S_SoundStopSample(int channel) {
 }
 
 void __cdecl S_SoundStopAllSamples() {
-	if( SoundIsActive )
-		for( DWORD i=0; i<32; ++i )
-			WinSndStopSample(i);
+	if( !SoundIsActive )
+		return;
+#ifdef FEATURE_AUDIO_IMPROVED
+	if( IsMixerActive() ) {
+		MixerStopAllSamples();
+		return;
+	}
+#endif // FEATURE_AUDIO_IMPROVED
+	for( DWORD i=0; i<32; ++i )
+		WinSndStopSample(i);
 }
 
 BOOL __cdecl S_SoundSampleIsPlaying(int channel) {
@@ -40,6 +40,12 @@ TEXPAGE_DESC TexturePages[256];
 LPDIRECTDRAWPALETTE DDrawPalettes[256];
 #endif // defined(FEATURE_EXTENDED_LIMITS) || defined(FEATURE_BACKGROUND_IMPROVED)
 
+#ifdef FEATURE_RENDER_IMPROVED
+#include "modding/palette_lut.h"
+
+bool PaletteLutEnabled = true;
+#endif // FEATURE_RENDER_IMPROVED
+
 #ifdef FEATURE_VIDEOFX_IMPROVED
 DWORD ReflectionMode = 0;
 DWORD ReflectionBlur = 2;
@@ -193,6 +199,12 @@ BYTE __cdecl FindNearestPaletteEntry(RGB888 *palette, int red, int green, int bl
 	int palSize = 256;
 	BYTE result = 0;
 
+#ifdef FEATURE_RENDER_IMPROVED
+	if( PaletteLutEnabled ) {
+		return PaletteLutFindNearest(palette, red, green, blue, ignoreSysPalette);
+	}
+#endif // FEATURE_RENDER_IMPROVED
+
 	if( ignoreSysPalette ) {
 		palStartIdx += 10;
 		palEndIdx -= 10;
@@ -217,6 +229,11 @@ void __cdecl SyncSurfacePalettes(void *srcData, int width, int height, int srcPi
 	BYTE *src, *dst;
 	BYTE bufPalette[256];
 
+#ifdef FEATURE_RENDER_IMPROVED
+	if( PaletteLutEnabled ) {
+		PaletteLutRemap(srcPalette, dstPalette, preserveSysPalette, bufPalette);
+	} else
+#endif // FEATURE_RENDER_IMPROVED
 	for( i=0; i<256; ++i ) {
 		bufPalette[i] = FindNearestPaletteEntry(dstPalette, srcPalette[i].red, srcPalette[i].green, srcPalette[i].blue, preserveSysPalette);
 	}